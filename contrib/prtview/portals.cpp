@@ -24,13 +24,25 @@
 #include <search.h>
 #endif
 #include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <thread>
 
 #include "iglrender.h"
 #include "cullable.h"
 
 #include "prtview.h"
+#include "os/mappedfile.h"
+#include "render.h"
+#include "math/aabb.h"
+#include "math/frustum.h"
 
-#define LINE_BUF 4096
+/// \brief Portal files with fewer portals than this are parsed on the calling thread.
+const std::size_t c_minParallelPortals = 8192;
+const std::size_t c_portalChunkSize = 1024;
 
 CPortals portals;
 CPortalsRender render;
@@ -42,22 +54,39 @@ CBspPortal::CBspPortal(){
 CBspPortal::~CBspPortal(){
 }
 
-bool CBspPortal::Build( char *def ){
-	char *c = def;
+/// \brief Skips blanks and reads a number, \p c is left after it. Lines of portal files are not null terminated.
+template<typename T>
+static bool Portal_parse( const char*& c, const char* end, T& value ){
+	for (; c != end && ( *c == ' ' || *c == '\t' || *c == '+' ); c++ ){};
+
+	const std::from_chars_result result = std::from_chars( c, end, value );
+	if ( result.ec != std::errc() ) {
+		return false;
+	}
+	c = result.ptr;
+	return true;
+}
+
+bool CBspPortal::Build( const char *c, const char *end, bool hint_flags ){
 	unsigned int point_count;
-	int dummy1, dummy2;
-	int res_cnt = 0;
+	int dummy1, dummy2, hint_flag;
 
-	if ( portals.hint_flags ) {
-		res_cnt = sscanf( def, "%u %d %d %d", &point_count, &dummy1, &dummy2, (int *)&hint );
+	if ( !Portal_parse( c, end, point_count ) ) {
+		return false;
+	}
+
+	if ( hint_flags ) {
+		if ( !Portal_parse( c, end, dummy1 ) || !Portal_parse( c, end, dummy2 ) || !Portal_parse( c, end, hint_flag ) ) {
+			return false;
+		}
+		hint = hint_flag != 0;
 	}
 	else
 	{
-		sscanf( def, "%u", &point_count );
 		hint = false;
 	}
 
-	if ( point_count < 3 || ( portals.hint_flags && res_cnt < 4 ) ) {
+	if ( point_count < 3 ) {
 		return false;
 	}
 
@@ -66,15 +95,17 @@ bool CBspPortal::Build( char *def ){
 
 	for ( auto& p : point )
 	{
-		for (; *c != 0 && *c != '('; c++ ){};
+		for (; c != end && *c != '('; c++ ){};
 
-		if ( *c == 0 ) {
+		if ( c == end ) {
 			return false;
 		}
 
 		c++;
 
-		sscanf( c, "%f %f %f", &p.x(), &p.y(), &p.z() );
+		if ( !Portal_parse( c, end, p.x() ) || !Portal_parse( c, end, p.y() ) || !Portal_parse( c, end, p.z() ) ) {
+			return false;
+		}
 
 		center += p;
 
@@ -99,15 +130,10 @@ bool CBspPortal::Build( char *def ){
 		inner_point.push_back( ( center * 0.01f ) + ( p * 0.99f ) );
 	}
 
-	fp_color_random[0] = ( rand() & 0xff ) / 255.0f;
-	fp_color_random[1] = ( rand() & 0xff ) / 255.0f;
-	fp_color_random[2] = ( rand() & 0xff ) / 255.0f;
-	fp_color_random[3] = 1.0f;
-
 	return true;
 }
 
-CPortals::CPortals(){
+CPortals::CPortals() : vertex_buffer( 0 ), vertex_count( 0 ), vertex_opacity( -1 ){
 }
 
 CPortals::~CPortals(){
@@ -115,6 +141,10 @@ CPortals::~CPortals(){
 
 void CPortals::Purge(){
 	portal.clear();
+	portal_visible.clear();
+	wireframe_indices.clear();
+	vertex_count = 0;
+	vertex_opacity = -1;
 
 	/*
 	   delete[] node;
@@ -124,46 +154,56 @@ void CPortals::Purge(){
 }
 
 void CPortals::Load(){
-	char buf[LINE_BUF + 1];
-	unsigned int portal_count, node_count;
-
-	memset( buf, 0, LINE_BUF + 1 );
-
 	Purge();
 
 	globalOutputStream() << MSG_PREFIX "Loading portal file " << fn << ".\n";
 
-	FILE *in;
-
-	in = fopen( fn.c_str(), "rt" );
+	MappedFile file( fn.c_str() );
 
-	if ( in == NULL ) {
+	if ( !file.valid() ) {
 		globalErrorStream() << "  ERROR - could not open file.\n";
 
 		return;
 	}
 
+	// line ranges, without the line breaks
+	const char *c = static_cast<const char*>( file.data() );
+	const char *const end = c + file.size();
+	const auto getline = [&c, end]( const char*& line, const char*& lineEnd ){
+		if ( c == end ) {
+			return false;
+		}
+		line = c;
+		lineEnd = static_cast<const char*>( std::memchr( c, '\n', end - c ) );
+		if ( lineEnd == nullptr ) {
+			lineEnd = end;
+		}
+		c = lineEnd == end ? end : lineEnd + 1;
+		return true;
+	};
+
+	const char *line, *lineEnd;
+	unsigned int portal_count = 0, node_count = 0;
+
 	#define GETLINE \
-	if ( !fgets( buf, LINE_BUF, in ) ) { \
-		fclose( in ); \
+	if ( !getline( line, lineEnd ) ) { \
 		globalErrorStream() << "  ERROR - File ended prematurely.\n"; \
 		return; \
 	}
 
 	GETLINE;
 
-	if ( strncmp( "PRT1-AM", buf, 7 ) == 0 ) {
+	const std::size_t header = lineEnd - line;
+	if ( header >= 7 && strncmp( "PRT1-AM", line, 7 ) == 0 ) {
 		format = PRT1AM;
 	}
-	else if ( strncmp( "PRT1", buf, 4 ) == 0 ) {
+	else if ( header >= 4 && strncmp( "PRT1", line, 4 ) == 0 ) {
 		format = PRT1;
 	}
-	else if ( strncmp( "PRT2", buf, 4 ) == 0 ) {
+	else if ( header >= 4 && strncmp( "PRT2", line, 4 ) == 0 ) {
 		format = PRT2;
 	}
 	else {
-		fclose( in );
-
 		globalErrorStream() << "  ERROR - File header indicates wrong file type (should be \"PRT1\" or \"PRT2\" or \"PRT1-AM\").\n";
 
 		return;
@@ -174,18 +214,18 @@ void CPortals::Load(){
 	case PRT1:
 		{
 			GETLINE; //leafs count https://github.com/kduske/TrenchBroom/issues/1157 //clusters in q3
-			sscanf( buf, "%u", &node_count );
+			Portal_parse( line, lineEnd, node_count );
 			GETLINE; //portals count
-			sscanf( buf, "%u", &portal_count );
+			Portal_parse( line, lineEnd, portal_count );
 		}
 		break;
 	case PRT2:
 		{
 			GETLINE; //leafs count
-			sscanf( buf, "%u", &node_count );
+			Portal_parse( line, lineEnd, node_count );
 			GETLINE; //clusters count
 			GETLINE; //portals count
-			sscanf( buf, "%u", &portal_count );
+			Portal_parse( line, lineEnd, portal_count );
 
 		}
 		break;
@@ -193,18 +233,18 @@ void CPortals::Load(){
 		{
 			GETLINE; //clusters count
 			GETLINE; //portals count
-			sscanf( buf, "%u", &portal_count );
+			Portal_parse( line, lineEnd, portal_count );
 			GETLINE; //leafs count
-			sscanf( buf, "%u", &node_count );
+			Portal_parse( line, lineEnd, node_count );
 		}
 		break;
 	}
 
+	#undef GETLINE
+
 /*
 	if(node_count > 0xFFFF)
 	{
-		fclose(in);
-
 		Purge();
 
 		globalErrorStream() << "  ERROR - Extreme number of nodes, aborting.\n";
@@ -213,65 +253,151 @@ void CPortals::Load(){
 	}
  */
 
-	if ( portal_count > 0xFFFF ) {
-		fclose( in );
-
-		globalErrorStream() << "  ERROR - Extreme number of portals, aborting.\n";
+	if ( portal_count == 0 ) {
+		globalErrorStream() << "  ERROR - number of portals equals 0, aborting.\n";
 
 		return;
 	}
 
-	if ( portal_count == 0 ) {
-		fclose( in );
-
-		globalErrorStream() << "  ERROR - number of portals equals 0, aborting.\n";
+	// each portal takes at least a line, don't trust a corrupt count with the allocations below
+	if ( portal_count > static_cast<std::size_t>( end - c ) ) {
+		globalErrorStream() << "  ERROR - Extreme number of portals, aborting.\n";
 
 		return;
 	}
 
-//	node = new CBspNode[node_count];
-	portal.resize( portal_count );
-
-	unsigned test_vals_1, test_vals_2;
+	std::vector<std::pair<const char*, const char*>> lines;
+	lines.reserve( portal_count );
 
 	hint_flags = false;
 
-	for ( unsigned int n = 0; n < portal_count; )
+	while ( lines.size() < portal_count )
 	{
-		if ( !fgets( buf, LINE_BUF, in ) ) {
-			fclose( in );
-
-			Purge();
-
-			globalErrorStream() << "  ERROR - Could not find information for portal number " << n + 1 << " of " << portal_count << ".\n";
+		if ( !getline( line, lineEnd ) ) {
+			globalErrorStream() << "  ERROR - Could not find information for portal number " << lines.size() + 1 << " of " << portal_count << ".\n";
 
 			return;
 		}
 
-		if ( !portal[n].Build( buf ) ) {
-			if ( 0 == n && sscanf( buf, "%d %d", &test_vals_1, &test_vals_2 ) == 1 ) { // skip additional counts of later data, not needed
+		if ( lines.empty() && !hint_flags && !CBspPortal().Build( line, lineEnd, false ) ) {
+			const char *count = line;
+			unsigned int value;
+			if ( Portal_parse( count, lineEnd, value ) && !Portal_parse( count, lineEnd, value ) ) { // skip additional counts of later data, not needed
 				// We can count on hint flags being in the file
 				hint_flags = true;
 				continue;
 			}
+		}
+
+		lines.emplace_back( line, lineEnd );
+	}
+
+	portal.resize( portal_count );
+
+	std::vector<unsigned char> built( portal_count );
+	const auto build = [this, &lines, &built]( std::size_t first, std::size_t last ){
+		for ( std::size_t n = first; n != last; ++n )
+		{
+			built[n] = portal[n].Build( lines[n].first, lines[n].second, hint_flags );
+		}
+	};
+
+	const std::size_t threads = std::min<std::size_t>( std::thread::hardware_concurrency(), portal_count / c_portalChunkSize );
+	if ( portal_count < c_minParallelPortals || threads < 2 ) {
+		build( 0, portal_count );
+	}
+	else
+	{
+		std::atomic<std::size_t> next( 0 );
+		const auto work = [&build, &next, portal_count](){
+			for ( std::size_t first; ( first = next.fetch_add( c_portalChunkSize ) ) < portal_count; )
+			{
+				build( first, std::min<std::size_t>( first + c_portalChunkSize, portal_count ) );
+			}
+		};
 
-			fclose( in );
+		std::vector<std::thread> workers;
+		workers.reserve( threads - 1 );
+		for ( std::size_t i = 1; i < threads; ++i )
+		{
+			workers.emplace_back( work );
+		}
+		work();
+		for ( std::thread& worker : workers )
+		{
+			worker.join();
+		}
+	}
 
+	for ( unsigned int n = 0; n < portal_count; ++n )
+	{
+		if ( !built[n] ) {
 			globalErrorStream() << "  ERROR - Information for portal number " << n + 1 << " of " << portal_count << " is not formatted correctly.\n";
 
 			Purge();
 
 			return;
 		}
+	}
 
-		++n;
+	// colours are picked in file order, so that a portal file always looks the same
+	for ( auto& prt : portal )
+	{
+		prt.fp_color_random[0] = ( rand() & 0xff ) / 255.0f;
+		prt.fp_color_random[1] = ( rand() & 0xff ) / 255.0f;
+		prt.fp_color_random[2] = ( rand() & 0xff ) / 255.0f;
+		prt.fp_color_random[3] = 1.0f;
 	}
 
-	fclose( in );
+	for ( auto& prt : portal )
+	{
+		prt.vertex = vertex_count;
+		vertex_count += prt.point.size();
+	}
+
+	wireframe_indices.reserve( vertex_count * 2 );
+	for ( const auto& prt : portal )
+	{
+		for ( unsigned int i = 0, count = prt.point.size(); i < count; ++i )
+		{
+			wireframe_indices.push_back( prt.vertex + i );
+			wireframe_indices.push_back( prt.vertex + ( i + 1 ) % count );
+		}
+	}
 
 	globalOutputStream() << "  " << portal_count << " portals read in.\n";
 }
 
+void CPortals::BindVertices(){
+	if ( vertex_buffer == 0 ) {
+		gl().glGenBuffers( 1, &vertex_buffer );
+	}
+	gl().glBindBuffer( GL_ARRAY_BUFFER, vertex_buffer );
+
+	// portal colours carry the 3d opacity
+	if ( vertex_opacity != opacity_3d ) {
+		vertex_opacity = opacity_3d;
+
+		std::vector<PointVertex> vertices;
+		vertices.reserve( vertex_count * 2 );
+		for ( const auto& prt : portal )
+		{
+			const Colour4b colour( prt.fp_color_random[0] * 255, prt.fp_color_random[1] * 255, prt.fp_color_random[2] * 255, opacity_3d * 255 / 100 );
+			for ( const auto& p : prt.point )
+				vertices.push_back( PointVertex( vertex3f_for_vector3( p ), colour ) );
+		}
+		for ( const auto& prt : portal )
+		{
+			for ( const auto& p : prt.inner_point )
+				vertices.push_back( PointVertex( vertex3f_for_vector3( p ) ) );
+		}
+		gl().glBufferData( GL_ARRAY_BUFFER, vertices.size() * sizeof( PointVertex ), vertices.data(), GL_STATIC_DRAW );
+	}
+
+	gl().glVertexPointer( 3, GL_FLOAT, sizeof( PointVertex ), reinterpret_cast<const GLvoid*>( offsetof( PointVertex, vertex ) ) );
+	gl().glColorPointer( 4, GL_UNSIGNED_BYTE, sizeof( PointVertex ), reinterpret_cast<const GLvoid*>( offsetof( PointVertex, colour ) ) );
+}
+
 #include "math/matrix.h"
 
 const char* g_state_solid = "$plugins/prtview/solid";
@@ -294,7 +420,7 @@ void Portals_constructShaders(){
 	GlobalOpenGLStateLibrary().insert( g_state_wireframe, state );
 
 	GlobalOpenGLStateLibrary().getDefaultState( state );
-	state.m_state = RENDER_FILL | RENDER_BLEND | RENDER_COLOURWRITE | RENDER_COLOURCHANGE | RENDER_SMOOTH;
+	state.m_state = RENDER_FILL | RENDER_BLEND | RENDER_COLOURWRITE | RENDER_COLOURARRAY | RENDER_SMOOTH;
 
 	switch ( portals.zbuffer )
 	{
@@ -409,15 +535,9 @@ void CPortalsRender::renderWireframe( Renderer& renderer, const VolumeTest& volu
 }
 
 void CPortalsDrawWireframe::render( RenderStateFlags state ) const {
-	for ( const auto& prt : portals.portal )
-	{
-		gl().glBegin( GL_LINE_LOOP );
-
-		for ( const auto& p : prt.point )
-			gl().glVertex3fv( p.data() );
-
-		gl().glEnd();
-	}
+	portals.BindVertices();
+	gl().glDrawElements( GL_LINES, GLsizei( portals.wireframe_indices.size() ), GL_UNSIGNED_INT, portals.wireframe_indices.data() );
+	gl().glBindBuffer( GL_ARRAY_BUFFER, 0 );
 }
 
 CubicClipVolume calculateCubicClipVolume( const Matrix4& viewproj ){
@@ -433,18 +553,85 @@ CubicClipVolume calculateCubicClipVolume( const Matrix4& viewproj ){
 	return clip;
 }
 
+/// \brief Sorts \p visible by ascending \p keys, least significant byte first.
+void Portals_radixSort( std::vector<unsigned int>& visible, std::vector<std::uint16_t>& keys ){
+	std::vector<unsigned int> sortedVisible( visible.size() );
+	std::vector<std::uint16_t> sortedKeys( keys.size() );
+	for ( int shift = 0; shift < 16; shift += 8 )
+	{
+		std::size_t offsets[257] = {};
+		for ( const std::uint16_t key : keys )
+			++offsets[( ( key >> shift ) & 0xff ) + 1];
+		for ( std::size_t i = 1; i < 257; ++i )
+			offsets[i] += offsets[i - 1];
+		for ( std::size_t i = 0; i < keys.size(); ++i )
+		{
+			const std::size_t j = offsets[( keys[i] >> shift ) & 0xff]++;
+			sortedVisible[j] = visible[i];
+			sortedKeys[j] = keys[i];
+		}
+		visible.swap( sortedVisible );
+		keys.swap( sortedKeys );
+	}
+}
+
+/// \brief Gathers the portals to draw in the 3d view, culled by the hint filters, the cubic clip volume and the view frustum.
+void Portals_cull( const VolumeTest& volume, const CubicClipVolume& clip ){
+	portals.portal_visible.clear();
+	for ( unsigned int i = 0; i < portals.portal.size(); ++i )
+	{
+		const CBspPortal& prt = portals.portal[i];
+		if( ( !prt.hint && portals.draw_nonhints )
+		  || ( prt.hint && portals.draw_hints ) )
+		{
+			if ( portals.clip ) {
+				if ( clip.min[0] < prt.min[0]
+				  || clip.min[1] < prt.min[1]
+				  || clip.min[2] < prt.min[2]
+				  || clip.max[0] > prt.max[0]
+				  || clip.max[1] > prt.max[1]
+				  || clip.max[2] > prt.max[2]
+				) continue;
+			}
+
+			if ( volume.TestAABB( aabb_for_minmax( prt.min, prt.max ) ) == c_volumeOutside ) {
+				continue;
+			}
+
+			portals.portal_visible.push_back( i );
+		}
+	}
+
+	if ( portals.zbuffer != 0 && !portals.portal_visible.empty() ) {
+		// quantised distance is plenty to order portals, which rarely overlap
+		static std::vector<std::uint16_t> keys;
+		double maxDistance = 0;
+		keys.resize( portals.portal_visible.size() );
+		for ( const unsigned int i : portals.portal_visible )
+			maxDistance = std::max( maxDistance, vector3_length( clip.cam - portals.portal[i].center ) );
+		const double scale = maxDistance > 0 ? 65535 / maxDistance : 0;
+		for ( std::size_t i = 0; i < keys.size(); ++i )
+			keys[i] = std::uint16_t( vector3_length( clip.cam - portals.portal[portals.portal_visible[i]].center ) * scale );
+
+		Portals_radixSort( portals.portal_visible, keys );
+	}
+}
+
 void CPortalsRender::renderSolid( Renderer& renderer, const VolumeTest& volume ) const {
 	if ( !portals.show_3d || portals.portal.empty() ) {
 		return;
 	}
 
-	CubicClipVolume clip = calculateCubicClipVolume( matrix4_multiplied_by_matrix4( volume.GetProjection(), volume.GetModelview() ) );
+	if ( !portals.polygons && !portals.lines ) {
+		return;
+	}
+
+	Portals_cull( volume, calculateCubicClipVolume( matrix4_multiplied_by_matrix4( volume.GetProjection(), volume.GetModelview() ) ) );
 
 	if ( portals.polygons ) {
 		renderer.SetState( g_shader_solid, Renderer::eWireframeOnly );
 		renderer.SetState( g_shader_solid, Renderer::eFullMaterials );
 
-		m_drawSolid.clip = clip;
 		renderer.addRenderable( m_drawSolid, g_matrix4_identity );
 	}
 
@@ -452,106 +639,50 @@ void CPortalsRender::renderSolid( Renderer& renderer, const VolumeTest& volume )
 		renderer.SetState( g_shader_solid_outline, Renderer::eWireframeOnly );
 		renderer.SetState( g_shader_solid_outline, Renderer::eFullMaterials );
 
-		m_drawSolidOutline.clip = clip;
 		renderer.addRenderable( m_drawSolidOutline, g_matrix4_identity );
 	}
 }
 
 void CPortalsDrawSolid::render( RenderStateFlags state ) const {
-	const float opacity = portals.opacity_3d / 100.0f;
-
-	if ( portals.zbuffer != 0 ) {
-		portals.portal_sort.clear();
-		portals.portal_sort.reserve( portals.portal.size() );
-		for ( auto& prt : portals.portal )
-		{
-			prt.dist = vector3_length_squared( clip.cam - prt.center );
-
-			portals.portal_sort.push_back( &prt );
-		}
-
-		std::sort( portals.portal_sort.begin(), portals.portal_sort.end(), []( const CBspPortal *a, const CBspPortal *b ){
-			return a->dist < b->dist;
-		} );
-
-		for ( const auto prt : portals.portal_sort )
-		{
-			if( ( !prt->hint && portals.draw_nonhints )
-			  || ( prt->hint && portals.draw_hints ) )
-			{
-				if ( portals.clip ) {
-					if ( clip.min[0] < prt->min[0]
-					  || clip.min[1] < prt->min[1]
-					  || clip.min[2] < prt->min[2]
-					  || clip.max[0] > prt->max[0]
-					  || clip.max[1] > prt->max[1]
-					  || clip.max[2] > prt->max[2]
-					) continue;
-				}
-
-				gl().glColor4f( prt->fp_color_random[0], prt->fp_color_random[1], prt->fp_color_random[2], opacity );
-
-				gl().glBegin( GL_POLYGON );
-
-				for ( const auto& p : prt->point )
-					gl().glVertex3fv( p.data() );
-
-				gl().glEnd();
-			}
-		}
+	if ( portals.portal_visible.empty() ) {
+		return;
 	}
-	else
+
+	indices.clear();
+	for ( const unsigned int i : portals.portal_visible )
 	{
-		for ( const auto& prt : portals.portal )
+		const CBspPortal& prt = portals.portal[i];
+		for ( unsigned int j = 2, count = prt.point.size(); j < count; ++j )
 		{
-			if( ( !prt.hint && portals.draw_nonhints )
-			  || ( prt.hint && portals.draw_hints ) )
-			{
-				if ( portals.clip ) {
-					if ( clip.min[0] < prt.min[0]
-					  || clip.min[1] < prt.min[1]
-					  || clip.min[2] < prt.min[2]
-					  || clip.max[0] > prt.max[0]
-					  || clip.max[1] > prt.max[1]
-					  || clip.max[2] > prt.max[2]
-					) continue;
-				}
-
-				gl().glColor4f( prt.fp_color_random[0], prt.fp_color_random[1], prt.fp_color_random[2], opacity );
-
-				gl().glBegin( GL_POLYGON );
-
-				for ( const auto& p : prt.point )
-					gl().glVertex3fv( p.data() );
-
-				gl().glEnd();
-			}
+			indices.push_back( prt.vertex );
+			indices.push_back( prt.vertex + j - 1 );
+			indices.push_back( prt.vertex + j );
 		}
 	}
+
+	portals.BindVertices();
+	gl().glDrawElements( GL_TRIANGLES, GLsizei( indices.size() ), GL_UNSIGNED_INT, indices.data() );
+	gl().glBindBuffer( GL_ARRAY_BUFFER, 0 );
 }
 
 void CPortalsDrawSolidOutline::render( RenderStateFlags state ) const {
-	for ( const auto& prt : portals.portal )
+	if ( portals.portal_visible.empty() ) {
+		return;
+	}
+
+	indices.clear();
+	for ( const unsigned int i : portals.portal_visible )
 	{
-		if( ( !prt.hint && portals.draw_nonhints )
-			|| ( prt.hint && portals.draw_hints ) )
+		const CBspPortal& prt = portals.portal[i];
+		const unsigned int first = portals.vertex_count + prt.vertex;
+		for ( unsigned int j = 0, count = prt.inner_point.size(); j < count; ++j )
 		{
-			if ( portals.clip ) {
-				if ( clip.min[0] < prt.min[0]
-				  || clip.min[1] < prt.min[1]
-				  || clip.min[2] < prt.min[2]
-				  || clip.max[0] > prt.max[0]
-				  || clip.max[1] > prt.max[1]
-				  || clip.max[2] > prt.max[2]
-				) continue;
-			}
-
-			gl().glBegin( GL_LINE_LOOP );
-
-			for ( const auto& p : prt.inner_point )
-				gl().glVertex3fv( p.data() );
-
-			gl().glEnd();
+			indices.push_back( first + j );
+			indices.push_back( first + ( j + 1 ) % count );
 		}
 	}
+
+	portals.BindVertices();
+	gl().glDrawElements( GL_LINES, GLsizei( indices.size() ), GL_UNSIGNED_INT, indices.data() );
+	gl().glBindBuffer( GL_ARRAY_BUFFER, 0 );
 }
@@ -40,10 +40,10 @@ public:
 	float fp_color_random[4];
 	Vector3 min;
 	Vector3 max;
-	float dist;
 	bool hint;
+	unsigned int vertex; // first vertex of the polygon in the portal vertex buffer
 
-	bool Build( char *def );
+	bool Build( const char *c, const char *end, bool hint_flags );
 };
 
 using PackedColour = std::uint32_t;
@@ -95,8 +95,16 @@ public:
 	float fp_color_2d[4];
 
 	std::vector<CBspPortal> portal;
-	std::vector<const CBspPortal*> portal_sort;
+	std::vector<unsigned int> portal_visible; // portals drawn in the 3d view, near to far if zbuffer != 0
 	bool hint_flags;
+
+	// polygon vertices of all portals followed by their inner outline vertices, uploaded after loading and when opacity_3d changes
+	unsigned int vertex_buffer;
+	unsigned int vertex_count;
+	int vertex_opacity;
+	std::vector<unsigned int> wireframe_indices;
+
+	void BindVertices();
 //	CBspNode *node;
 };
 
@@ -108,15 +116,15 @@ public:
 
 class CPortalsDrawSolid : public OpenGLRenderable
 {
+	mutable std::vector<unsigned int> indices;
 public:
-	mutable CubicClipVolume clip;
 	void render( RenderStateFlags state ) const;
 };
 
 class CPortalsDrawSolidOutline : public OpenGLRenderable
 {
+	mutable std::vector<unsigned int> indices;
 public:
-	mutable CubicClipVolume clip;
 	void render( RenderStateFlags state ) const;
 };
 
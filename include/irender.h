@@ -76,6 +76,8 @@ public:
 class LightCullable
 {
 public:
+	/// \brief Returns the world-space bounds outside of which testLight() is always false.
+	virtual const AABB& cullableAABB() const = 0;
 	virtual bool testLight( const RendererLight& light ) const = 0;
 	virtual void insertLight( const RendererLight& light ){
 	}
@@ -32,6 +32,11 @@ class UndoMemento
 {
 public:
 	virtual void release() = 0;
+/// \brief Returns the approximate number of bytes owned by this memento.
+/// Used to enforce the undo memory limit; mementos which do not report a size are not counted.
+	virtual std::size_t size() const {
+		return 0;
+	}
 	virtual ~UndoMemento() {
 	}
 };
@@ -41,6 +46,12 @@ class Undoable
 public:
 	virtual UndoMemento* exportState() const = 0;
 	virtual void importState( const UndoMemento* state ) = 0;
+/// \brief Called when the command which saved \p state is finished. Takes ownership of \p state.
+/// Returns a memento which restores only the parts of \p state that differ from the current state, or 0 if nothing changed.
+/// The default implementation keeps the complete state.
+	virtual UndoMemento* diffState( UndoMemento* state ) const {
+		return state;
+	}
 	virtual ~Undoable() {
 	}
 };
@@ -0,0 +1,31 @@
+#pragma once
+
+/// \file
+/// \brief Binary light probe dump written by the compiler next to the map and shown by the editor.
+///
+/// The file is a ProbeFileHeader followed by probeCount records of probeSize bytes, little-endian.
+/// Readers accept larger records from newer versions and ignore the trailing fields.
+
+#include <cstdint>
+
+#define PROBEFILE_MAGIC "RPRB"
+#define PROBEFILE_VERSION 1
+
+#pragma pack( push, 1 )
+struct ProbeFileHeader
+{
+	char magic[4];            ///< PROBEFILE_MAGIC, not null terminated
+	std::uint32_t version;    ///< PROBEFILE_VERSION
+	std::uint32_t probeCount;
+	std::uint32_t probeSize;  ///< sizeof( ProbeFileProbe ) of the writer
+};
+
+struct ProbeFileProbe
+{
+	float origin[3];
+	std::int16_t ambientSH[3][4]; ///< [channel][coefficient] as stored in the bsp, divide by 32767 to normalise
+};
+#pragma pack( pop )
+
+static_assert( sizeof( ProbeFileHeader ) == 16, "ProbeFileHeader must be 16 bytes" );
+static_assert( sizeof( ProbeFileProbe ) == 36, "ProbeFileProbe must be 36 bytes" );
@@ -0,0 +1,166 @@
+#pragma once
+
+/// \file
+/// \brief Versioned binary caches of parsed definitions, keyed by the state of the files they were parsed from.
+///
+/// A cache file is a header, followed by the key and the payload.
+/// The key lists the source files with their sizes and modification times; a cache is only used if its key matches the current sources exactly.
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "string/string.h"
+#include "os/file.h"
+#include "os/mappedfile.h"
+#include "stream/filestream.h"
+#include "stream/stringstream.h"
+
+/// \brief Collects plain values and strings to be saved as the key or payload of a cache file.
+class CacheWriter
+{
+	std::vector<char> m_buffer;
+public:
+	template<typename T>
+	void write( const T& value ){
+		static_assert( std::is_trivially_copyable<T>::value, "CacheWriter: only plain values can be cached" );
+		const char* bytes = reinterpret_cast<const char*>( &value );
+		m_buffer.insert( m_buffer.end(), bytes, bytes + sizeof( T ) );
+	}
+	void writeString( const char* string ){
+		const std::uint32_t length = static_cast<std::uint32_t>( string_length( string ) );
+		write( length );
+		m_buffer.insert( m_buffer.end(), string, string + length + 1 );
+	}
+	/// \brief Adds the file \p path to the key under \p name, a change of its size or modification time invalidates the cache.
+	void writeSource( const char* name, const char* path ){
+		writeString( name );
+		write( std::uint64_t( file_size( path ) ) );
+		write( std::int64_t( file_modified( path ) ) );
+	}
+	const char* data() const {
+		return m_buffer.data();
+	}
+	std::size_t size() const {
+		return m_buffer.size();
+	}
+};
+
+/// \brief Reads values back from a cache payload. A read past the end marks the reader failed and returns empty values.
+class CacheReader
+{
+	const char* m_read;
+	const char* m_end;
+	bool m_failed;
+public:
+	CacheReader( const char* data, std::size_t size ) : m_read( data ), m_end( data + size ), m_failed( false ){
+	}
+	template<typename T>
+	T read(){
+		static_assert( std::is_trivially_copyable<T>::value, "CacheReader: only plain values can be cached" );
+		T value{};
+		if ( std::size_t( m_end - m_read ) < sizeof( T ) ) {
+			m_failed = true;
+			m_read = m_end;
+			return value;
+		}
+		std::memcpy( &value, m_read, sizeof( T ) );
+		m_read += sizeof( T );
+		return value;
+	}
+	/// \brief Returns a string which points into the cache, it lives as long as the cache file.
+	const char* readString(){
+		const std::uint32_t length = read<std::uint32_t>();
+		if ( m_failed || std::size_t( m_end - m_read ) <= length || m_read[length] != '\0' ) {
+			m_failed = true;
+			m_read = m_end;
+			return "";
+		}
+		const char* string = m_read;
+		m_read += length + 1;
+		return string;
+	}
+	/// \brief Reads a count of items which take at least \p itemSize bytes each, fails if the rest of the payload is too short.
+	std::size_t readCount( std::size_t itemSize = 1 ){
+		const std::size_t count = read<std::uint32_t>();
+		if ( count > std::size_t( m_end - m_read ) / itemSize ) {
+			m_failed = true;
+			m_read = m_end;
+			return 0;
+		}
+		return count;
+	}
+	bool failed() const {
+		return m_failed;
+	}
+	bool finished() const {
+		return m_read == m_end;
+	}
+};
+
+struct CacheFileHeader
+{
+	char magic[4];
+	std::uint32_t version;
+	std::uint64_t keySize;
+	std::uint64_t payloadSize;
+};
+
+/// \brief Writes a cache file atomically, readers never see a partially written cache.
+inline bool CacheFile_save( const char* path, const char magic[4], std::uint32_t version, const CacheWriter& key, const CacheWriter& payload ){
+	const auto temporary = StringStream( path, ".tmp" );
+	bool written;
+	{
+		FileOutputStream file( temporary );
+		if ( file.failed() ) {
+			return false;
+		}
+		CacheFileHeader header;
+		std::memcpy( header.magic, magic, sizeof( header.magic ) );
+		header.version = version;
+		header.keySize = key.size();
+		header.payloadSize = payload.size();
+		written = file.write( reinterpret_cast<const FileOutputStream::byte_type*>( &header ), sizeof( header ) ) == sizeof( header )
+		       && file.write( reinterpret_cast<const FileOutputStream::byte_type*>( key.data() ), key.size() ) == key.size()
+		       && file.write( reinterpret_cast<const FileOutputStream::byte_type*>( payload.data() ), payload.size() ) == payload.size();
+	}
+	if ( !written ) {
+		file_remove( temporary );
+		return false;
+	}
+	return file_move( temporary, path );
+}
+
+/// \brief A mapped cache file, valid if its magic, version and key match the expected ones.
+class CacheFile
+{
+	MappedFile m_file;
+	const char* m_payload;
+	std::size_t m_payloadSize;
+public:
+	CacheFile( const char* path, const char magic[4], std::uint32_t version, const CacheWriter& key ) : m_file( path ), m_payload( 0 ), m_payloadSize( 0 ){
+		if ( !m_file.valid() || m_file.size() < sizeof( CacheFileHeader ) ) {
+			return;
+		}
+		CacheFileHeader header;
+		std::memcpy( &header, m_file.data(), sizeof( header ) );
+		const char* data = static_cast<const char*>( m_file.data() ) + sizeof( header );
+		if ( std::memcmp( header.magic, magic, sizeof( header.magic ) ) != 0
+		  || header.version != version
+		  || header.keySize != key.size()
+		  || m_file.size() - sizeof( header ) < key.size()
+		  || header.payloadSize != m_file.size() - sizeof( header ) - key.size()
+		  || std::memcmp( data, key.data(), key.size() ) != 0 ) {
+			return;
+		}
+		m_payload = data + key.size();
+		m_payloadSize = header.payloadSize;
+	}
+	bool valid() const {
+		return m_payload != 0;
+	}
+	CacheReader reader() const {
+		return CacheReader( m_payload, m_payloadSize );
+	}
+};
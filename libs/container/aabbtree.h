@@ -0,0 +1,151 @@
+/*
+   Copyright (C) 1999-2006 Id Software, Inc. and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+
+   This file is part of GtkRadiant.
+
+   GtkRadiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   GtkRadiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "math/aabb.h"
+
+/// \brief A static bounding-volume hierarchy over values with axis-aligned bounds.
+///
+/// - Values are added with insert() and the hierarchy is built once with build().
+/// - Nodes are split at the median centre along their longest axis.
+/// - Overlap queries visit only the subtrees whose bounds intersect the query.
+template<typename Value>
+class AABBTree
+{
+	struct Item
+	{
+		AABB m_bounds;
+		Value m_value;
+	};
+	/// \brief Leaf nodes reference a range of items; interior nodes store the index of their second child, the first child follows the node.
+	struct Node
+	{
+		AABB m_bounds;
+		std::size_t m_first;
+		std::size_t m_count;
+		std::size_t m_second;
+	};
+	typedef std::vector<Item> Items;
+	typedef std::vector<Node> Nodes;
+
+	Items m_items;
+	Nodes m_nodes;
+
+	enum { c_leafSize = 4 };
+
+	void build( std::size_t first, std::size_t count ){
+		const std::size_t index = m_nodes.size();
+		m_nodes.push_back( Node() );
+
+		AABB bounds;
+		for ( std::size_t i = first; i != first + count; ++i )
+		{
+			aabb_extend_by_aabb_safe( bounds, m_items[i].m_bounds );
+		}
+		m_nodes[index].m_bounds = bounds;
+
+		if ( count <= c_leafSize ) {
+			m_nodes[index].m_first = first;
+			m_nodes[index].m_count = count;
+			return;
+		}
+
+		std::size_t axis = 0;
+		if ( bounds.extents[1] > bounds.extents[axis] ) {
+			axis = 1;
+		}
+		if ( bounds.extents[2] > bounds.extents[axis] ) {
+			axis = 2;
+		}
+
+		const std::size_t half = count / 2;
+		std::nth_element( m_items.begin() + first, m_items.begin() + first + half, m_items.begin() + first + count,
+		                  [axis]( const Item& self, const Item& other ){
+			return self.m_bounds.origin[axis] < other.m_bounds.origin[axis];
+		} );
+
+		m_nodes[index].m_count = 0;
+		build( first, half );
+		m_nodes[index].m_second = m_nodes.size();
+		build( first + half, count - half );
+	}
+
+public:
+	bool empty() const {
+		return m_items.empty();
+	}
+	std::size_t size() const {
+		return m_items.size();
+	}
+	void clear(){
+		m_items.clear();
+		m_nodes.clear();
+	}
+	/// \brief Adds \p value with \p bounds. Invalidates the hierarchy until build() is called.
+	void insert( const AABB& bounds, const Value& value ){
+		m_items.push_back( Item{ bounds, value } );
+		m_nodes.clear();
+	}
+	void build(){
+		m_nodes.clear();
+		if ( !m_items.empty() ) {
+			m_nodes.reserve( 2 * ( m_items.size() / c_leafSize + 1 ) );
+			build( 0, m_items.size() );
+		}
+	}
+	/// \brief Returns the bounds of all values, or an invalid AABB if empty.
+	AABB bounds() const {
+		return m_nodes.empty() ? AABB() : m_nodes.front().m_bounds;
+	}
+	/// \brief Calls \p functor with each value whose bounds intersect \p bounds.
+	template<typename Functor>
+	void forEachIntersecting( const AABB& bounds, const Functor& functor ) const {
+		if ( m_nodes.empty() ) {
+			return;
+		}
+		std::size_t stack[64];
+		std::size_t depth = 0;
+		stack[depth++] = 0;
+		while ( depth != 0 )
+		{
+			const Node& node = m_nodes[stack[--depth]];
+			if ( !aabb_intersects_aabb( node.m_bounds, bounds ) ) {
+				continue;
+			}
+			if ( node.m_count != 0 ) {
+				for ( std::size_t i = node.m_first; i != node.m_first + node.m_count; ++i )
+				{
+					if ( aabb_intersects_aabb( m_items[i].m_bounds, bounds ) ) {
+						functor( m_items[i].m_value );
+					}
+				}
+			}
+			else
+			{
+				stack[depth++] = node.m_second;
+				stack[depth++] = &node - &m_nodes.front() + 1;
+			}
+		}
+	}
+};
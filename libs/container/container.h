@@ -251,6 +251,10 @@ public:
 		m_values.push_back( Values::value_type( key, Value() ) );
 		return m_values.back().second;
 	}
+
+	bool operator==( const UnsortedMap& other ) const {
+		return m_values == other.m_values;
+	}
 };
 
 /// An adaptor to assert when duplicate values are added, or non-existent values removed from a std::set.
@@ -0,0 +1,314 @@
+/*
+   Copyright (C) 1999-2006 Id Software, Inc. and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+
+   This file is part of GtkRadiant.
+
+   GtkRadiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   GtkRadiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "math/aabb.h"
+#include "debugging/debugging.h"
+
+/// \brief A bounding-volume hierarchy over values with axis-aligned bounds that supports incremental insertion, removal and update.
+///
+/// - Each value is a leaf, identified by the proxy returned from insert().
+/// - Leaves are inserted next to the sibling that least increases the total surface area, and rotations keep the tree balanced.
+/// - Nodes are stored contiguously and recycled through a free list.
+template<typename Value>
+class DynamicAABBTree
+{
+public:
+	typedef std::size_t Proxy;
+	static constexpr Proxy c_null = Proxy( -1 );
+
+private:
+	struct Node
+	{
+		AABB m_bounds;
+		Value m_value;
+		Proxy m_parent; ///< Next free node while on the free list.
+		Proxy m_child1;
+		Proxy m_child2;
+		int m_height;   ///< 0 for leaves, -1 for free nodes.
+
+		bool isLeaf() const {
+			return m_child1 == c_null;
+		}
+	};
+	typedef std::vector<Node> Nodes;
+
+	Nodes m_nodes;
+	Proxy m_root;
+	Proxy m_free;
+	std::size_t m_size;
+	mutable std::vector<Proxy> m_stack;
+
+	static float area( const AABB& aabb ){
+		return aabb.extents[0] * aabb.extents[1] + aabb.extents[1] * aabb.extents[2] + aabb.extents[2] * aabb.extents[0];
+	}
+	static AABB merged( const AABB& aabb, const AABB& other ){
+		AABB result( aabb );
+		aabb_extend_by_aabb_safe( result, other );
+		return result;
+	}
+
+	Proxy allocate(){
+		if ( m_free == c_null ) {
+			m_nodes.push_back( Node() );
+			m_nodes.back().m_parent = m_free;
+			m_nodes.back().m_height = -1;
+			m_free = m_nodes.size() - 1;
+		}
+		const Proxy index = m_free;
+		Node& node = m_nodes[index];
+		m_free = node.m_parent;
+		node.m_parent = c_null;
+		node.m_child1 = c_null;
+		node.m_child2 = c_null;
+		node.m_height = 0;
+		return index;
+	}
+	void release( Proxy index ){
+		m_nodes[index].m_parent = m_free;
+		m_nodes[index].m_height = -1;
+		m_nodes[index].m_value = Value();
+		m_free = index;
+	}
+
+	void refit( Proxy index ){
+		Node& node = m_nodes[index];
+		const Node& child1 = m_nodes[node.m_child1];
+		const Node& child2 = m_nodes[node.m_child2];
+		node.m_bounds = merged( child1.m_bounds, child2.m_bounds );
+		node.m_height = 1 + std::max( child1.m_height, child2.m_height );
+	}
+
+	/// \brief Rotates the taller grandchild of \p a up if its subtrees differ in height by more than one. Returns the new subtree root.
+	Proxy balance( Proxy a ){
+		if ( m_nodes[a].isLeaf() || m_nodes[a].m_height < 2 ) {
+			return a;
+		}
+		const Proxy b = m_nodes[a].m_child1;
+		const Proxy c = m_nodes[a].m_child2;
+		const int difference = m_nodes[c].m_height - m_nodes[b].m_height;
+
+		if ( difference > 1 ) {
+			return rotate( a, c, &Node::m_child2 );
+		}
+		if ( difference < -1 ) {
+			return rotate( a, b, &Node::m_child1 );
+		}
+		return a;
+	}
+	/// \brief Swaps \p a with its taller child \p up, \p a takes the shorter grandchild of \p up.
+	Proxy rotate( Proxy a, Proxy up, Proxy Node::* slot ){
+		const Proxy f = m_nodes[up].m_child1;
+		const Proxy g = m_nodes[up].m_child2;
+
+		m_nodes[up].m_child1 = a;
+		m_nodes[up].m_parent = m_nodes[a].m_parent;
+		m_nodes[a].m_parent = up;
+
+		const Proxy parent = m_nodes[up].m_parent;
+		if ( parent == c_null ) {
+			m_root = up;
+		}
+		else if ( m_nodes[parent].m_child1 == a ) {
+			m_nodes[parent].m_child1 = up;
+		}
+		else
+		{
+			m_nodes[parent].m_child2 = up;
+		}
+
+		const bool keepF = m_nodes[f].m_height > m_nodes[g].m_height;
+		const Proxy kept = keepF ? f : g;
+		const Proxy moved = keepF ? g : f;
+		m_nodes[up].m_child2 = kept;
+		m_nodes[a].*slot = moved;
+		m_nodes[moved].m_parent = a;
+
+		refit( a );
+		refit( up );
+		return up;
+	}
+
+	void insertLeaf( Proxy leaf ){
+		if ( m_root == c_null ) {
+			m_root = leaf;
+			m_nodes[leaf].m_parent = c_null;
+			return;
+		}
+
+		const AABB leafBounds = m_nodes[leaf].m_bounds;
+		Proxy index = m_root;
+		while ( !m_nodes[index].isLeaf() )
+		{
+			const Node& node = m_nodes[index];
+			const float nodeArea = area( node.m_bounds );
+			const float combinedArea = area( merged( node.m_bounds, leafBounds ) );
+
+			// cost of making a new parent for this node and the leaf
+			const float cost = 2.0f * combinedArea;
+			// cost of pushing the leaf further down the tree
+			const float inheritance = 2.0f * ( combinedArea - nodeArea );
+
+			const auto descendCost = [&]( Proxy child ){
+				const Node& childNode = m_nodes[child];
+				const float childArea = area( merged( childNode.m_bounds, leafBounds ) );
+				return childNode.isLeaf() ? childArea + inheritance : childArea - area( childNode.m_bounds ) + inheritance;
+			};
+			const float cost1 = descendCost( node.m_child1 );
+			const float cost2 = descendCost( node.m_child2 );
+
+			if ( cost < cost1 && cost < cost2 ) {
+				break;
+			}
+			index = cost1 < cost2 ? node.m_child1 : node.m_child2;
+		}
+
+		const Proxy sibling = index;
+		const Proxy oldParent = m_nodes[sibling].m_parent;
+		const Proxy newParent = allocate();
+		m_nodes[newParent].m_parent = oldParent;
+		m_nodes[newParent].m_child1 = sibling;
+		m_nodes[newParent].m_child2 = leaf;
+		m_nodes[sibling].m_parent = newParent;
+		m_nodes[leaf].m_parent = newParent;
+		refit( newParent );
+
+		if ( oldParent == c_null ) {
+			m_root = newParent;
+		}
+		else if ( m_nodes[oldParent].m_child1 == sibling ) {
+			m_nodes[oldParent].m_child1 = newParent;
+		}
+		else
+		{
+			m_nodes[oldParent].m_child2 = newParent;
+		}
+
+		repair( oldParent );
+	}
+	void removeLeaf( Proxy leaf ){
+		if ( leaf == m_root ) {
+			m_root = c_null;
+			return;
+		}
+
+		const Proxy parent = m_nodes[leaf].m_parent;
+		const Proxy grandParent = m_nodes[parent].m_parent;
+		const Proxy sibling = m_nodes[parent].m_child1 == leaf ? m_nodes[parent].m_child2 : m_nodes[parent].m_child1;
+
+		m_nodes[sibling].m_parent = grandParent;
+		if ( grandParent == c_null ) {
+			m_root = sibling;
+		}
+		else if ( m_nodes[grandParent].m_child1 == parent ) {
+			m_nodes[grandParent].m_child1 = sibling;
+		}
+		else
+		{
+			m_nodes[grandParent].m_child2 = sibling;
+		}
+		release( parent );
+
+		repair( grandParent );
+	}
+	/// \brief Rebalances and refits the ancestors of a changed subtree, starting at \p index.
+	void repair( Proxy index ){
+		while ( index != c_null )
+		{
+			index = balance( index );
+			refit( index );
+			index = m_nodes[index].m_parent;
+		}
+	}
+
+public:
+	DynamicAABBTree() : m_root( c_null ), m_free( c_null ), m_size( 0 ){
+	}
+
+	bool empty() const {
+		return m_size == 0;
+	}
+	std::size_t size() const {
+		return m_size;
+	}
+	void clear(){
+		m_nodes.clear();
+		m_root = c_null;
+		m_free = c_null;
+		m_size = 0;
+	}
+	/// \brief Adds \p value with \p bounds and returns its proxy. Proxies of removed values are reused.
+	Proxy insert( const AABB& bounds, const Value& value ){
+		const Proxy leaf = allocate();
+		m_nodes[leaf].m_bounds = bounds;
+		m_nodes[leaf].m_value = value;
+		insertLeaf( leaf );
+		++m_size;
+		return leaf;
+	}
+	void erase( Proxy proxy ){
+		ASSERT_MESSAGE( proxy < m_nodes.size() && m_nodes[proxy].isLeaf() && m_nodes[proxy].m_height == 0, "invalid proxy" );
+		removeLeaf( proxy );
+		release( proxy );
+		--m_size;
+	}
+	/// \brief Moves \p proxy to \p bounds, the proxy remains valid.
+	void update( Proxy proxy, const AABB& bounds ){
+		ASSERT_MESSAGE( proxy < m_nodes.size() && m_nodes[proxy].isLeaf() && m_nodes[proxy].m_height == 0, "invalid proxy" );
+		removeLeaf( proxy );
+		m_nodes[proxy].m_bounds = bounds;
+		insertLeaf( proxy );
+	}
+	const AABB& bounds( Proxy proxy ) const {
+		return m_nodes[proxy].m_bounds;
+	}
+	const Value& value( Proxy proxy ) const {
+		return m_nodes[proxy].m_value;
+	}
+	/// \brief Calls \p functor with each value whose bounds intersect \p bounds. The functor must not modify or query the tree.
+	template<typename Functor>
+	void forEachIntersecting( const AABB& bounds, const Functor& functor ) const {
+		if ( m_root == c_null ) {
+			return;
+		}
+		m_stack.clear();
+		m_stack.push_back( m_root );
+		while ( !m_stack.empty() )
+		{
+			const Node& node = m_nodes[m_stack.back()];
+			m_stack.pop_back();
+			if ( !aabb_intersects_aabb( node.m_bounds, bounds ) ) {
+				continue;
+			}
+			if ( node.isLeaf() ) {
+				functor( node.m_value );
+			}
+			else
+			{
+				m_stack.push_back( node.m_child2 );
+				m_stack.push_back( node.m_child1 );
+			}
+		}
+	}
+};
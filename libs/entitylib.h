@@ -385,6 +385,17 @@ public:
 	typedef MemberCaller1<KeyValue, const CopiedString&, &KeyValue::importState> UndoImportCaller;
 };
 
+/// \brief Counts the list entries and values of a saved key/value list, keys are pooled and not counted.
+template<typename Key>
+inline std::size_t UndoMemento_heapSize( const UnsortedMap<Key, SmartPointer<KeyValue>>& keyValues ){
+	std::size_t size = 0;
+	for ( const auto& keyValue : keyValues )
+	{
+		size += sizeof( keyValue ) + 2 * sizeof( void* ) + sizeof( KeyValue ) + string_length( keyValue.second->c_str() ) + 1;
+	}
+	return size;
+}
+
 /// \brief An unsorted list of key/value pairs.
 ///
 /// - Notifies observers when a pair is inserted or removed.
@@ -0,0 +1,100 @@
+#pragma once
+
+/// \file
+/// \brief Read-only memory mapping of whole files.
+
+#if defined( WIN32 )
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstddef>
+
+/// \brief Maps the file identified by a path into memory for reading, the mapping lives as long as the object.
+class MappedFile
+{
+	const void* m_data;
+	std::size_t m_size;
+#if defined( WIN32 )
+	HANDLE m_file;
+	HANDLE m_mapping;
+#endif
+
+	MappedFile( const MappedFile& ) = delete;
+	MappedFile& operator=( const MappedFile& ) = delete;
+
+public:
+	explicit MappedFile( const char* path ) : m_data( 0 ), m_size( 0 ){
+#if defined( WIN32 )
+		m_mapping = 0;
+		m_file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+		if ( m_file == INVALID_HANDLE_VALUE ) {
+			return;
+		}
+		LARGE_INTEGER size;
+		if ( !GetFileSizeEx( m_file, &size ) || size.QuadPart == 0 ) {
+			return;
+		}
+		m_mapping = CreateFileMappingA( m_file, 0, PAGE_READONLY, 0, 0, 0 );
+		if ( m_mapping == 0 ) {
+			return;
+		}
+		m_data = MapViewOfFile( m_mapping, FILE_MAP_READ, 0, 0, 0 );
+		if ( m_data != 0 ) {
+			m_size = static_cast<std::size_t>( size.QuadPart );
+		}
+#else
+		const int file = open( path, O_RDONLY );
+		if ( file == -1 ) {
+			return;
+		}
+		struct stat st;
+		if ( fstat( file, &st ) == 0 && st.st_size > 0 ) {
+			void* data = mmap( 0, static_cast<std::size_t>( st.st_size ), PROT_READ, MAP_PRIVATE, file, 0 );
+			if ( data != MAP_FAILED ) {
+				m_data = data;
+				m_size = static_cast<std::size_t>( st.st_size );
+			}
+		}
+		close( file ); // the mapping keeps its own reference
+#endif
+	}
+	~MappedFile(){
+#if defined( WIN32 )
+		if ( m_data != 0 ) {
+			UnmapViewOfFile( m_data );
+		}
+		if ( m_mapping != 0 ) {
+			CloseHandle( m_mapping );
+		}
+		if ( m_file != INVALID_HANDLE_VALUE ) {
+			CloseHandle( m_file );
+		}
+#else
+		if ( m_data != 0 ) {
+			munmap( const_cast<void*>( m_data ), m_size );
+		}
+#endif
+	}
+
+	/// \brief Returns true if the file was opened and mapped, empty files are never mapped.
+	bool valid() const {
+		return m_data != 0;
+	}
+	const void* data() const {
+		return m_data;
+	}
+	std::size_t size() const {
+		return m_size;
+	}
+};
@@ -223,6 +223,11 @@ public:
 	void instanceDetach( MapFile* map ){
 		m_undo.instanceDetach( map );
 	}
+
+	friend std::size_t UndoMemento_heapSize( const TraversableNodeSet& nodes ){
+		// list nodes holding a reference each, the referenced nodes are shared with the scene
+		return nodes.m_children.size() * ( sizeof( NodeSmartReference ) + 2 * sizeof( void* ) );
+	}
 };
 
 namespace std
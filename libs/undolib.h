@@ -24,6 +24,19 @@
 #include "iundo.h"
 #include "mapfile.h"
 #include "generic/callback.h"
+#include "string/string.h"
+
+/// \brief Returns the number of bytes \p data owns on the heap, for the undo memory limit.
+/// Overloads for types which own allocations are found by argument dependent lookup.
+template<typename Copyable>
+inline std::size_t UndoMemento_heapSize( const Copyable& data ){
+	return 0;
+}
+
+template<typename Buffer>
+inline std::size_t UndoMemento_heapSize( const String<Buffer>& string ){
+	return string_length( string.c_str() ) + 1;
+}
 
 template<typename Copyable>
 class BasicUndoMemento : public UndoMemento
@@ -41,6 +54,10 @@ public:
 	const Copyable& get() const {
 		return m_data;
 	}
+
+	std::size_t size() const {
+		return sizeof( *this ) + UndoMemento_heapSize( m_data );
+	}
 };
 
 
@@ -88,6 +105,14 @@ public:
 	UndoMemento* exportState() const {
 		return new BasicUndoMemento<Copyable>( m_object );
 	}
+/// \brief Discards the memento if the command left the object unchanged. \p Copyable must provide an equality operator.
+	UndoMemento* diffState( UndoMemento* state ) const {
+		if ( static_cast<const BasicUndoMemento<Copyable>*>( state )->get() == m_object ) {
+			state->release();
+			return 0;
+		}
+		return state;
+	}
 	void importState( const UndoMemento* state ){
 		save();
 		m_importCallback( ( static_cast<const BasicUndoMemento<Copyable>*>( state ) )->get() );
@@ -87,34 +87,65 @@ class PicoSurface final :
 	Array<ArbitraryMeshVertex> m_vertices;
 	Array<RenderIndex> m_indices;
 
+	/// \brief Vertex and index buffers, uploaded on first draw and shared by all instances of the model.
+	mutable GLuint m_vertexBuffer;
+	mutable GLuint m_indexBuffer;
+
+	static const GLvoid* vertexOffset( std::size_t offset ){
+		return reinterpret_cast<const GLvoid*>( offset );
+	}
+	void bindBuffers() const {
+		if ( m_vertexBuffer == 0 ) {
+			gl().glGenBuffers( 1, &m_vertexBuffer );
+			gl().glBindBuffer( GL_ARRAY_BUFFER, m_vertexBuffer );
+			gl().glBufferData( GL_ARRAY_BUFFER, m_vertices.size() * sizeof( ArbitraryMeshVertex ), m_vertices.data(), GL_STATIC_DRAW );
+
+			gl().glGenBuffers( 1, &m_indexBuffer );
+			gl().glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer );
+			gl().glBufferData( GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof( RenderIndex ), m_indices.data(), GL_STATIC_DRAW );
+		}
+		else
+		{
+			gl().glBindBuffer( GL_ARRAY_BUFFER, m_vertexBuffer );
+			gl().glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer );
+		}
+	}
+
 public:
 
-	PicoSurface(){
+	PicoSurface() : m_vertexBuffer( 0 ), m_indexBuffer( 0 ){
 		constructNull();
 		CaptureShader();
 	}
-	PicoSurface( const AssScene scene, const aiMesh* mesh ){
+	PicoSurface( const AssScene scene, const aiMesh* mesh ) : m_vertexBuffer( 0 ), m_indexBuffer( 0 ){
 		CopyPicoSurface( scene, mesh );
 		CaptureShader();
 	}
 	~PicoSurface(){
+		if ( m_vertexBuffer != 0 && GlobalOpenGL().contextValid ) {
+			gl().glDeleteBuffers( 1, &m_vertexBuffer );
+			gl().glDeleteBuffers( 1, &m_indexBuffer );
+		}
 		ReleaseShader();
 	}
 
 	void render( RenderStateFlags state ) const {
+		bindBuffers();
 		if ( ( state & RENDER_BUMP ) != 0 ) {
-			gl().glNormalPointer( GL_FLOAT, sizeof( ArbitraryMeshVertex ), &m_vertices.data()->normal );
-			gl().glVertexAttribPointer( c_attr_TexCoord0, 2, GL_FLOAT, 0, sizeof( ArbitraryMeshVertex ), &m_vertices.data()->texcoord );
-			gl().glVertexAttribPointer( c_attr_Tangent, 3, GL_FLOAT, 0, sizeof( ArbitraryMeshVertex ), &m_vertices.data()->tangent );
-			gl().glVertexAttribPointer( c_attr_Binormal, 3, GL_FLOAT, 0, sizeof( ArbitraryMeshVertex ), &m_vertices.data()->bitangent );
+			gl().glNormalPointer( GL_FLOAT, sizeof( ArbitraryMeshVertex ), vertexOffset( offsetof( ArbitraryMeshVertex, normal ) ) );
+			gl().glVertexAttribPointer( c_attr_TexCoord0, 2, GL_FLOAT, 0, sizeof( ArbitraryMeshVertex ), vertexOffset( offsetof( ArbitraryMeshVertex, texcoord ) ) );
+			gl().glVertexAttribPointer( c_attr_Tangent, 3, GL_FLOAT, 0, sizeof( ArbitraryMeshVertex ), vertexOffset( offsetof( ArbitraryMeshVertex, tangent ) ) );
+			gl().glVertexAttribPointer( c_attr_Binormal, 3, GL_FLOAT, 0, sizeof( ArbitraryMeshVertex ), vertexOffset( offsetof( ArbitraryMeshVertex, bitangent ) ) );
 		}
 		else
 		{
-			gl().glNormalPointer( GL_FLOAT, sizeof( ArbitraryMeshVertex ), &m_vertices.data()->normal );
-			gl().glTexCoordPointer( 2, GL_FLOAT, sizeof( ArbitraryMeshVertex ), &m_vertices.data()->texcoord );
+			gl().glNormalPointer( GL_FLOAT, sizeof( ArbitraryMeshVertex ), vertexOffset( offsetof( ArbitraryMeshVertex, normal ) ) );
+			gl().glTexCoordPointer( 2, GL_FLOAT, sizeof( ArbitraryMeshVertex ), vertexOffset( offsetof( ArbitraryMeshVertex, texcoord ) ) );
 		}
-		gl().glVertexPointer( 3, GL_FLOAT, sizeof( ArbitraryMeshVertex ), &m_vertices.data()->vertex );
-		gl().glDrawElements( GL_TRIANGLES, GLsizei( m_indices.size() ), RenderIndexTypeID, m_indices.data() );
+		gl().glVertexPointer( 3, GL_FLOAT, sizeof( ArbitraryMeshVertex ), vertexOffset( offsetof( ArbitraryMeshVertex, vertex ) ) );
+		gl().glDrawElements( GL_TRIANGLES, GLsizei( m_indices.size() ), RenderIndexTypeID, 0 );
+		gl().glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		gl().glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
 
 #if defined( _DEBUG ) && !defined( _DEBUG_QUICKER )
 		GLfloat modelview[16];
@@ -594,6 +625,9 @@ public:
 		m_picomodel.testSelect( selector, test, Instance::localToWorld() );
 	}
 
+	const AABB& cullableAABB() const {
+		return worldAABB();
+	}
 	bool testLight( const RendererLight& light ) const {
 		return light.testAABB( worldAABB() );
 	}
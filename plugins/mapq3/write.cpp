@@ -30,8 +30,8 @@ inline MapExporter* Node_getMapExporter( scene::Node& node ){
 }
 
 
-static std::size_t g_count_entities;
-static std::size_t g_count_brushes;
+static thread_local std::size_t g_count_entities;
+static thread_local std::size_t g_count_brushes;
 
 
 void Entity_ExportTokens( const Entity& entity, TokenWriter& writer ){
@@ -415,6 +415,9 @@ public:
 		m_model.testSelect( selector, test, Instance::localToWorld() );
 	}
 
+	const AABB& cullableAABB() const {
+		return worldAABB();
+	}
 	bool testLight( const RendererLight& light ) const {
 		return light.testAABB( worldAABB() );
 	}
@@ -545,6 +545,9 @@ public:
 		m_picomodel.testSelect( selector, test, Instance::localToWorld() );
 	}
 
+	const AABB& cullableAABB() const {
+		return worldAABB();
+	}
 	bool testLight( const RendererLight& light ) const {
 		return light.testAABB( worldAABB() );
 	}
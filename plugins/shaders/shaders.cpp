@@ -40,6 +40,11 @@
 #include <cstdlib>
 #include <map>
 #include <list>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 #include "ifilesystem.h"
 #include "ishaders.h"
@@ -60,12 +65,14 @@
 #include "os/dir.h"
 #include "os/file.h"
 #include "stringio.h"
+#include "script/scripttokeniser.h"
 #include "shaderlib.h"
 #include "texturelib.h"
 #include "commandlib.h"
 #include "moduleobservers.h"
 #include "archivelib.h"
 #include "imagelib.h"
+#include "cachelib.h"
 
 const char* g_shadersExtension = "";
 const char* g_shadersDirectory = "";
@@ -297,6 +304,9 @@ public:
 		m_refcount( 0 ){
 		m_nFlags = 0;
 		m_fTrans = 1.0f;
+		m_AlphaFunc = IShader::eAlways;
+		m_AlphaRef = 0.0f;
+		m_Cull = IShader::eCullBack;
 	}
 
 	void IncRef(){
@@ -1401,9 +1411,50 @@ public:
 
 std::list<CopiedString> g_shaderFilenames;
 
-void ParseShaderFile( Tokeniser& tokeniser, const char* filename ){
-	g_shaderFilenames.push_back( filename );
-	filename = g_shaderFilenames.back().c_str();
+/// \brief The templates of one shader script, in file order, until they are merged into the global tables.
+struct ShaderFileParse
+{
+	const char* m_filename;
+	std::string m_text;
+	std::vector<ShaderTemplatePointer> m_templates;
+	bool m_failed = false; ///< The last template failed to parse.
+	bool m_serial = false; ///< The script needs the global tables while parsing, it is parsed again by the merge.
+	/// \brief Messages written while parsing on a worker thread, with the stream each was written to.
+	std::vector<std::pair<TextOutputStream*, std::string>> m_log;
+	bool m_errors = false; ///< Errors were written while parsing on a worker thread.
+};
+
+static thread_local ShaderFileParse* g_shaderParseInParallel = 0;
+
+std::mutex g_shaderPoolMutex;
+
+/// \brief Templates are created with pooled strings, the pool is shared by the parsing workers.
+ShaderTemplate* ShaderTemplate_new(){
+	std::lock_guard<std::mutex> lock( g_shaderPoolMutex );
+	return new ShaderTemplate();
+}
+
+/// \brief Inserts the templates parsed so far from \p parse into the global tables, earlier definitions take precedence.
+void ShaderFile_merge( ShaderFileParse& parse, std::size_t& duplicates ){
+	for ( const ShaderTemplatePointer& shaderTemplate : parse.m_templates )
+	{
+		g_shaders.insert( ShaderTemplateMap::value_type( shaderTemplate->getName(), shaderTemplate ) );
+
+		if ( parse.m_failed && &shaderTemplate == &parse.m_templates.back() ) {
+			globalErrorStream() << "Error parsing shader " << shaderTemplate->getName() << '\n';
+		}
+		// do we already have this shader?
+		else if ( !g_shaderDefinitions.insert( ShaderDefinitionMap::value_type( shaderTemplate->getName(), ShaderDefinition( shaderTemplate.get(), ShaderArguments(), parse.m_filename ) ) ).second ) {
+			++duplicates;
+#ifdef _DEBUG
+			globalWarningStream() << "WARNING: shader " << shaderTemplate->getName() << " is already in memory, definition in " << parse.m_filename << " ignored.\n";
+#endif
+		}
+	}
+	parse.m_templates.clear();
+}
+
+void ParseShaderFile( Tokeniser& tokeniser, ShaderFileParse& parse, std::size_t& duplicates ){
 	tokeniser.nextLine();
 	for (;; )
 	{
@@ -1443,7 +1494,13 @@ void ParseShaderFile( Tokeniser& tokeniser, const char* filename ){
 		else
 		{
 			if ( string_equal( token, "guide" ) ) {
-				parseTemplateInstance( tokeniser, filename );
+				// instances look up templates and definitions, leave the script to the merge
+				if ( g_shaderParseInParallel != 0 ) {
+					parse.m_serial = true;
+					return;
+				}
+				ShaderFile_merge( parse, duplicates );
+				parseTemplateInstance( tokeniser, parse.m_filename );
 			}
 			else
 			{
@@ -1456,25 +1513,16 @@ void ParseShaderFile( Tokeniser& tokeniser, const char* filename ){
 				CopiedString name;
 				if ( !Tokeniser_parseShaderName( tokeniser, name ) ) {
 				}
-				ShaderTemplatePointer shaderTemplate( new ShaderTemplate() );
+				ShaderTemplatePointer shaderTemplate( ShaderTemplate_new() );
 				shaderTemplate->setName( name.c_str() );
 
-				g_shaders.insert( ShaderTemplateMap::value_type( shaderTemplate->getName(), shaderTemplate ) );
+				parse.m_templates.push_back( shaderTemplate );
 
 				bool result = ( g_shaderLanguage == SHADERLANGUAGE_QUAKE3 )
 				              ? shaderTemplate->parseQuake3( tokeniser )
 				              : shaderTemplate->parseDoom3( tokeniser );
-				if ( result ) {
-					// do we already have this shader?
-					if ( !g_shaderDefinitions.insert( ShaderDefinitionMap::value_type( shaderTemplate->getName(), ShaderDefinition( shaderTemplate.get(), ShaderArguments(), filename ) ) ).second ) {
-#ifdef _DEBUG
-						globalWarningStream() << "WARNING: shader " << shaderTemplate->getName() << " is already in memory, definition in " << filename << " ignored.\n";
-#endif
-					}
-				}
-				else
-				{
-					globalErrorStream() << "Error parsing shader " << shaderTemplate->getName() << '\n';
+				if ( !result ) {
+					parse.m_failed = true;
 					return;
 				}
 			}
@@ -1520,25 +1568,317 @@ void parseGuideFile( Tokeniser& tokeniser, const char* filename ){
 	}
 }
 
-void LoadShaderFile( const char* filename ){
+void ParseShaderFile( ShaderFileParse& parse, std::size_t& duplicates ){
+	BufferInputStream istream( parse.m_text.data(), parse.m_text.size() );
+	// the tokeniser is built into this module, so that its messages go to the streams of this module, which are captured while parsing in parallel
+	ScriptTokeniser tokeniser( istream, true );
+	ParseShaderFile( tokeniser, parse, duplicates );
+}
+
+/// \brief Reads a shader script into \p parse, the file system is only used from the main thread.
+bool ReadShaderFile( const char* filename, ShaderFileParse& parse ){
 	ArchiveTextFile* file = GlobalFileSystem().openTextFile( filename );
 
 	if ( file != 0 ) {
+		g_shaderFilenames.push_back( filename );
+		parse.m_filename = g_shaderFilenames.back().c_str();
+
+		char buffer[4096];
+		for ( std::size_t size; ( size = file->getInputStream().read( buffer, sizeof( buffer ) ) ) != 0; )
+		{
+			parse.m_text.append( buffer, size );
+		}
+		file->release();
+		return true;
+	}
+
+	globalWarningStream() << "Unable to read shaderfile " << filename << '\n';
+	return false;
+}
+
+void LoadShaderFile( const char* filename ){
+	ShaderFileParse parse;
+	if ( ReadShaderFile( filename, parse ) ) {
 		globalOutputStream() << "Parsing shaderfile " << filename << '\n';
 
-		Tokeniser& tokeniser = GlobalScriptLibrary().m_pfnNewScriptTokeniser( file->getInputStream() );
+		std::size_t duplicates = 0;
+		ParseShaderFile( parse, duplicates );
+		ShaderFile_merge( parse, duplicates );
+	}
+}
 
-		ParseShaderFile( tokeniser, filename );
+/// \brief Collects the messages written by each worker into the log of the script it is parsing, so that they are printed from the main thread in script order.
+class ShaderParseLogStream : public TextOutputStream
+{
+	TextOutputStream& m_stream;
+	bool m_error;
+	std::mutex m_mutex;
+public:
+	ShaderParseLogStream( TextOutputStream& stream, bool error ) : m_stream( stream ), m_error( error ){
+	}
+	std::size_t write( const char* buffer, std::size_t length ) override {
+		if ( g_shaderParseInParallel != 0 ) {
+			auto& log = g_shaderParseInParallel->m_log;
+			if ( log.empty() || log.back().first != &m_stream ) {
+				log.emplace_back( &m_stream, std::string() );
+			}
+			log.back().second.append( buffer, length );
+			g_shaderParseInParallel->m_errors |= m_error;
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_stream.write( buffer, length );
+		}
+		return length;
+	}
+};
 
-		tokeniser.release();
-		file->release();
+const std::size_t c_minParallelShaderFiles = 8;
+
+/// \brief Loads the shader scripts \p filenames, parsing them on all cores and merging them in list order.
+/// Returns false if a script could not be read or parsed.
+bool LoadShaderFiles( const std::vector<CopiedString>& filenames ){
+	std::vector<ShaderFileParse> parses;
+	parses.reserve( filenames.size() );
+	for ( const CopiedString& filename : filenames )
+	{
+		parses.emplace_back();
+		if ( !ReadShaderFile( filename.c_str(), parses.back() ) ) {
+			parses.pop_back();
+		}
 	}
-	else
+
+	// Doom3 shaders intern their strings in the shared string pool
+	const std::size_t threads = std::min<std::size_t>( std::thread::hardware_concurrency(), parses.size() );
+	const bool parallel = g_shaderLanguage == SHADERLANGUAGE_QUAKE3 && parses.size() >= c_minParallelShaderFiles && threads >= 2;
+
+	if ( parallel ) {
+		TextOutputStream& outputStream = globalOutputStream();
+		TextOutputStream& warningStream = globalWarningStream();
+		TextOutputStream& errorStream = globalErrorStream();
+		ShaderParseLogStream parseOutputStream( outputStream, false );
+		ShaderParseLogStream parseWarningStream( warningStream, false );
+		ShaderParseLogStream parseErrorStream( errorStream, true );
+		GlobalOutputStream::instance().setOutputStream( parseOutputStream );
+		GlobalWarningStream::instance().setOutputStream( parseWarningStream );
+		GlobalErrorStream::instance().setOutputStream( parseErrorStream );
+
+		std::atomic<std::size_t> next( 0 );
+		const auto work = [&parses, &next](){
+			for ( std::size_t i; ( i = next.fetch_add( 1 ) ) < parses.size(); )
+			{
+				g_shaderParseInParallel = &parses[i];
+				std::size_t duplicates = 0;
+				ParseShaderFile( parses[i], duplicates );
+				g_shaderParseInParallel = 0;
+			}
+		};
+
+		std::vector<std::thread> workers;
+		workers.reserve( threads - 1 );
+		for ( std::size_t i = 1; i < threads; ++i )
+		{
+			workers.emplace_back( work );
+		}
+		work();
+		for ( std::thread& worker : workers )
+		{
+			worker.join();
+		}
+
+		GlobalOutputStream::instance().setOutputStream( outputStream );
+		GlobalWarningStream::instance().setOutputStream( warningStream );
+		GlobalErrorStream::instance().setOutputStream( errorStream );
+	}
+
+	bool complete = parses.size() == filenames.size();
+	std::size_t duplicates = 0;
+	for ( ShaderFileParse& parse : parses )
+	{
+		globalOutputStream() << "Parsing shaderfile " << parse.m_filename << '\n';
+
+		if ( !parallel || parse.m_serial ) {
+			parse.m_templates.clear();
+			parse.m_failed = false;
+			parse.m_errors = false;
+			ParseShaderFile( parse, duplicates );
+		}
+		else
+		{
+			for ( const auto& message : parse.m_log )
+			{
+				message.first->write( message.second.data(), message.second.size() );
+			}
+		}
+		complete &= !parse.m_failed && !parse.m_errors;
+		ShaderFile_merge( parse, duplicates );
+	}
+
+	if ( duplicates != 0 ) {
+		globalWarningStream() << duplicates << " duplicate shader definitions ignored\n";
+	}
+	return complete;
+}
+
+const char c_shaderCacheMagic[4] = { 'R', 'S', 'H', 'C' };
+const std::uint32_t c_shaderCacheVersion = 1;
+
+const char* ShaderCache_path(){
+	static CopiedString path;
+	path = StringStream( GlobalRadiant().getLocalRcPath(), "shaders.cache" );
+	return path.c_str();
+}
+
+/// \brief Identifies the parsed shader tables by the game and by each script with the file system root it is found in.
+CacheWriter ShaderCache_key( const std::vector<CopiedString>& filenames ){
+	CacheWriter key;
+	key.writeString( GlobalRadiant().getGameName() );
+	key.write( std::uint32_t( filenames.size() ) );
+	for ( const CopiedString& filename : filenames )
+	{
+		const char* root = GlobalFileSystem().findFile( filename.c_str() );
+		key.writeString( root );
+		// scripts in archives change with their archive
+		if ( file_is_directory( root ) ) {
+			key.writeSource( filename.c_str(), StringStream( root, filename ) );
+		}
+		else
+		{
+			key.writeSource( filename.c_str(), root );
+		}
+	}
+	return key;
+}
+
+/// \brief Saves the tables parsed from Quake3 shader scripts, which only hold plain values and texture names.
+void ShaderCache_save( const CacheWriter& key ){
+	CacheWriter payload;
+
+	std::map<const char*, std::uint32_t> filenameIndices;
+	payload.write( std::uint32_t( g_shaderFilenames.size() ) );
+	for ( const CopiedString& filename : g_shaderFilenames )
+	{
+		filenameIndices.emplace( filename.c_str(), std::uint32_t( filenameIndices.size() ) );
+		payload.writeString( filename.c_str() );
+	}
+
+	std::map<const ShaderTemplate*, std::uint32_t> templateIndices;
+	std::vector<const ShaderTemplate*> templates;
+	const auto addTemplate = [&templateIndices, &templates]( const ShaderTemplate* shaderTemplate ){
+		if ( templateIndices.emplace( shaderTemplate, std::uint32_t( templates.size() ) ).second ) {
+			templates.push_back( shaderTemplate );
+		}
+	};
+	for ( const auto& [ name, shaderTemplate ] : g_shaders )
+	{
+		addTemplate( shaderTemplate.get() );
+	}
+	for ( const auto& [ name, definition ] : g_shaderDefinitions )
+	{
+		addTemplate( definition.shaderTemplate );
+	}
+
+	payload.write( std::uint32_t( templates.size() ) );
+	for ( const ShaderTemplate* shaderTemplate : templates )
+	{
+		payload.writeString( shaderTemplate->getName() );
+		payload.writeString( shaderTemplate->m_textureName.c_str() );
+		payload.writeString( shaderTemplate->m_textureName2.c_str() );
+		payload.writeString( shaderTemplate->m_skyBox.c_str() );
+		payload.write( std::int32_t( shaderTemplate->m_nFlags ) );
+		payload.write( shaderTemplate->m_fTrans );
+		payload.write( std::int32_t( shaderTemplate->m_AlphaFunc ) );
+		payload.write( shaderTemplate->m_AlphaRef );
+		payload.write( std::int32_t( shaderTemplate->m_Cull ) );
+	}
+
+	payload.write( std::uint32_t( g_shaders.size() ) );
+	for ( const auto& [ name, shaderTemplate ] : g_shaders )
 	{
-		globalWarningStream() << "Unable to read shaderfile " << filename << '\n';
+		payload.writeString( name.c_str() );
+		payload.write( templateIndices[shaderTemplate.get()] );
+	}
+
+	payload.write( std::uint32_t( g_shaderDefinitions.size() ) );
+	for ( const auto& [ name, definition ] : g_shaderDefinitions )
+	{
+		const auto filename = filenameIndices.find( definition.filename );
+		payload.writeString( name.c_str() );
+		payload.write( templateIndices[definition.shaderTemplate] );
+		payload.write( filename != filenameIndices.end() ? filename->second : std::uint32_t( -1 ) );
+	}
+
+	if ( !CacheFile_save( ShaderCache_path(), c_shaderCacheMagic, c_shaderCacheVersion, key, payload ) ) {
+		globalWarningStream() << "Unable to write shader cache " << ShaderCache_path() << '\n';
 	}
 }
 
+/// \brief Fills the shader tables from the cache if it was built from the current scripts, returns false if the scripts must be parsed.
+bool ShaderCache_load( const CacheWriter& key ){
+	const CacheFile cache( ShaderCache_path(), c_shaderCacheMagic, c_shaderCacheVersion, key );
+	if ( !cache.valid() ) {
+		return false;
+	}
+	CacheReader reader = cache.reader();
+
+	std::vector<const char*> filenames( reader.readCount() );
+	for ( const char*& filename : filenames )
+	{
+		g_shaderFilenames.emplace_back( reader.readString() );
+		filename = g_shaderFilenames.back().c_str();
+	}
+
+	std::vector<ShaderTemplatePointer> templates;
+	for ( std::size_t count = reader.readCount(); count != 0 && !reader.failed(); --count )
+	{
+		ShaderTemplatePointer shaderTemplate( new ShaderTemplate() );
+		templates.push_back( shaderTemplate );
+		shaderTemplate->setName( reader.readString() );
+		shaderTemplate->m_textureName = reader.readString();
+		shaderTemplate->m_textureName2 = reader.readString();
+		shaderTemplate->m_skyBox = reader.readString();
+		shaderTemplate->m_nFlags = reader.read<std::int32_t>();
+		shaderTemplate->m_fTrans = reader.read<float>();
+		shaderTemplate->m_AlphaFunc = static_cast<IShader::EAlphaFunc>( reader.read<std::int32_t>() );
+		shaderTemplate->m_AlphaRef = reader.read<float>();
+		shaderTemplate->m_Cull = static_cast<IShader::ECull>( reader.read<std::int32_t>() );
+	}
+
+	for ( std::size_t count = reader.readCount(); count != 0 && !reader.failed(); --count )
+	{
+		const char* name = reader.readString();
+		const std::uint32_t index = reader.read<std::uint32_t>();
+		if ( index >= templates.size() ) {
+			break;
+		}
+		g_shaders.emplace_hint( g_shaders.end(), name, templates[index] );
+	}
+
+	std::size_t definitions = reader.readCount();
+	for ( ; definitions != 0 && !reader.failed(); --definitions )
+	{
+		const char* name = reader.readString();
+		const std::uint32_t index = reader.read<std::uint32_t>();
+		const std::uint32_t filename = reader.read<std::uint32_t>();
+		if ( index >= templates.size() || ( filename >= filenames.size() && filename != std::uint32_t( -1 ) ) ) {
+			break;
+		}
+		g_shaderDefinitions.emplace_hint( g_shaderDefinitions.end(), name, ShaderDefinition( templates[index].get(), ShaderArguments(), filename != std::uint32_t( -1 ) ? filenames[filename] : "" ) );
+	}
+
+	if ( reader.failed() || definitions != 0 || !reader.finished() ) {
+		globalWarningStream() << "Shader cache " << ShaderCache_path() << " is corrupt, parsing shader scripts\n";
+		g_shaders.clear();
+		g_shaderDefinitions.clear();
+		g_shaderFilenames.clear();
+		return false;
+	}
+
+	globalOutputStream() << "Loaded " << g_shaderDefinitions.size() << " shaders from " << ShaderCache_path() << '\n';
+	return true;
+}
+
 typedef FreeCaller1<const char*, LoadShaderFile> LoadShaderFileCaller;
 
 
@@ -1762,9 +2102,23 @@ void Shaders_Load(){
 		}
 
 		StringOutputStream shadername( 256 );
+		std::vector<CopiedString> shadernames;
+		shadernames.reserve( l_shaderfiles.size() );
 		for( const CopiedString& sh : l_shaderfiles )
 		{
-			LoadShaderFile( shadername( path.c_str(), sh ) );
+			shadernames.emplace_back( shadername( path.c_str(), sh ) );
+		}
+
+		// Doom3 templates and guides are not cached
+		if ( g_shaderLanguage == SHADERLANGUAGE_QUAKE3 ) {
+			const CacheWriter key = ShaderCache_key( shadernames );
+			if ( !ShaderCache_load( key ) && LoadShaderFiles( shadernames ) ) {
+				ShaderCache_save( key );
+			}
+		}
+		else
+		{
+			LoadShaderFiles( shadernames );
 		}
 	}
 
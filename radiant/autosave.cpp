@@ -33,6 +33,11 @@
 #include "mainframe.h"
 #include "qe3.h"
 #include "preferences.h"
+#include "stream/textfilestream.h"
+#include "console.h"
+
+#include <atomic>
+#include <thread>
 
 
 #if defined( WIN32 )
@@ -40,6 +45,81 @@
 #endif
 
 
+/// \brief Writes maps to disk on a worker thread.
+/// The UI thread only copies the map; the worker serialises the copy, writes it under a temporary name
+/// and renames it over the target, so a crash never leaves a truncated file.
+class AsyncMapWriter
+{
+	std::thread m_thread;
+	std::atomic<bool> m_done{ true };
+	bool m_success = true;
+	CopiedString m_filename;
+	scene::Node* m_map = 0; ///< The copy of the map being written.
+	Sys_PrintQueue m_messages;
+
+	static bool writeFile( const char* filename, const StringOutputStream& buffer ){
+		const auto tmpName = StringStream( filename, "TMP" );
+		{
+			TextFileOutputStream file( tmpName );
+			if ( file.failed() ) {
+				return false;
+			}
+			const std::size_t size = buffer.end() - buffer.begin();
+			if ( file.write( buffer.c_str(), size ) != size ) {
+				return false;
+			}
+		}
+		return file_move( tmpName, filename );
+	}
+public:
+	~AsyncMapWriter(){
+		wait();
+	}
+	bool busy() const {
+		return m_thread.joinable() && !m_done;
+	}
+	/// \brief Reports the result of a finished write and releases the copy of the map; called periodically from the UI thread.
+	void poll(){
+		if ( m_thread.joinable() && m_done ) {
+			m_thread.join();
+			m_map->DecRef();
+			m_map = 0;
+			m_messages.flush();
+			if ( m_success ) {
+				globalOutputStream() << "Saved " << makeQuoted( m_filename ) << '\n';
+			}
+			else
+			{
+				globalErrorStream() << "failed to save map file: " << makeQuoted( m_filename ) << '\n';
+			}
+		}
+	}
+	void wait(){
+		if ( m_thread.joinable() ) {
+			m_thread.join();
+			poll();
+		}
+	}
+	void write( const char* filename ){
+		wait();
+
+		m_map = &Map_Clone();
+		m_map->IncRef();
+		m_filename = filename;
+		m_done = false;
+		m_thread = std::thread( [this, &format = MapFormat_forFile( filename )](){
+			Sys_Print_setThreadQueue( &m_messages );
+			StringOutputStream buffer( 1 << 20 );
+			Map_Serialise( *m_map, format, buffer );
+			m_success = writeFile( m_filename.c_str(), buffer );
+			Sys_Print_setThreadQueue( 0 );
+			m_done = true;
+		} );
+	}
+};
+
+AsyncMapWriter g_autosaveWriter;
+
 bool DoesFileExist( const char* name, std::size_t& size ){
 	if ( file_exists( name ) ) {
 		size += file_size( name );
@@ -74,7 +154,7 @@ void Map_Snapshot(){
 		}
 
 		// save in the next available slot
-		Map_SaveFile( snapshotFilename );
+		g_autosaveWriter.write( snapshotFilename );
 
 		if ( lSize > 50 * 1024 * 1024 ) { // total size of saves > 50 mb
 			globalOutputStream() << "The snapshot files in " << snapshotsDir << " total more than 50 megabytes. You might consider cleaning up.";
@@ -114,6 +194,8 @@ scene::Node& Map_Node(){
 }
 
 void QE_CheckAutoSave(){
+	g_autosaveWriter.poll();
+
 	if ( !Map_Valid( g_map ) || !ScreenUpdates_Enabled() ) {
 		return;
 	}
@@ -129,7 +211,10 @@ void QE_CheckAutoSave(){
 		s_start = now;
 		s_changes = Node_getMapFile( Map_Node() )->changes();
 
-		if ( g_AutoSave_Enabled ) {
+		if ( g_AutoSave_Enabled && g_autosaveWriter.busy() ) {
+			globalOutputStream() << "Autosave skipped, previous save still in progress...\n";
+		}
+		else if ( g_AutoSave_Enabled ) {
 			const char* strMsg = g_SnapShots_Enabled ? "Autosaving snapshot..." : "Autosaving...";
 			globalOutputStream() << strMsg << '\n';
 			//Sys_Status(strMsg);
@@ -144,14 +229,14 @@ void QE_CheckAutoSave(){
 					auto autosave = StringStream( g_qeglobals.m_userGamePath, "maps/" );
 					Q_mkdir( autosave );
 					autosave << "autosave.map";
-					Map_SaveFile( autosave );
+					g_autosaveWriter.write( autosave );
 				}
 				else
 				{
 					const char* name = Map_Name( g_map );
 					const char* extension = path_get_filename_base_end( name );
 					const auto autosave = StringStream( StringRange( name, extension ), ".autosave", extension );
-					Map_SaveFile( autosave );
+					g_autosaveWriter.write( autosave );
 				}
 			}
 		}
@@ -190,4 +275,5 @@ void Autosave_Construct(){
 }
 
 void Autosave_Destroy(){
+	g_autosaveWriter.wait();
 }
@@ -22,6 +22,9 @@
 #include "brush.h"
 #include "signal/signal.h"
 
+#include <atomic>
+#include <thread>
+
 Signal0 g_brushTextureChangedCallbacks;
 
 void Brush_addTextureChangedCallback( const SignalHandler& handler ){
@@ -48,50 +51,30 @@ Counter* BrushInstance::m_counter = 0;
 
 FaceInstanceSet g_SelectedFaceInstances;
 
+static thread_local bool g_brush_evaluatingInParallel = false;
+static std::atomic<std::size_t> g_brush_inconsistentCount( 0 );
 
-struct SListNode
-{
-	SListNode* m_next;
-};
 
-class ProximalVertex
-{
-public:
-	const SListNode* m_vertices;
-
-	ProximalVertex( const SListNode* next )
-		: m_vertices( next ){
-	}
-
-	bool operator<( const ProximalVertex& other ) const {
-		if ( !( operator==( other ) ) ) {
-			return m_vertices < other.m_vertices;
-		}
-		return false;
-	}
-	bool operator==( const ProximalVertex& other ) const {
-		const SListNode* v = m_vertices;
-		std::size_t DEBUG_LOOP = 0;
-		do
-		{
-			if ( v == other.m_vertices ) {
-				return true;
-			}
-			v = v->m_next;
-			//ASSERT_MESSAGE(DEBUG_LOOP < c_brush_maxFaces, "infinite loop");
-			if ( !( DEBUG_LOOP < c_brush_maxFaces ) ) {
-				break;
+/// \brief Numbers the rings that \p next links the face-vertices into, in order of first appearance.
+/// Writes the ring of each face-vertex to \p rings and the first face-vertex of each ring to \p firsts.
+inline void FaceVertexRings_label( const std::vector<std::size_t>& next, IndexBuffer& rings, std::vector<std::size_t>& firsts ){
+	const RenderIndex unlabelled = RenderIndex( -1 );
+	std::vector<RenderIndex> labels( next.size(), unlabelled );
+	for ( std::size_t i = 0; i != next.size(); ++i )
+	{
+		if ( labels[i] == unlabelled ) {
+			const RenderIndex ring = RenderIndex( firsts.size() );
+			firsts.push_back( i );
+			std::size_t j = i;
+			do
+			{
+				labels[j] = ring;
+				j = next[j];
 			}
-			++DEBUG_LOOP;
+			while ( labels[j] == unlabelled ); // stops at the start of the ring, or at a broken link
 		}
-		while ( v != m_vertices );
-		return false;
+		rings.insert( labels[i] );
 	}
-};
-
-typedef Array<SListNode> ProximalVertexArray;
-std::size_t ProximalVertexArray_index( const ProximalVertexArray& array, const ProximalVertex& vertex ){
-	return vertex.m_vertices - array.data();
 }
 
 
@@ -156,38 +139,42 @@ void Brush::buildBRep(){
 				}
 			}
 
+			// absolute index of the first vertex of each face
+			std::vector<std::size_t> faceOffsets( m_faces.size() );
+			for ( std::size_t i = 0, count = 0; i != m_faces.size(); ++i )
+			{
+				faceOffsets[i] = count;
+				count += m_faces[i]->getWinding().numpoints;
+			}
+			const auto absolute = [&faceOffsets]( FaceVertexId faceVertex ){
+				return faceOffsets[faceVertex.getFace()] + faceVertex.getVertex();
+			};
+
+			// each edge is shared by the two face-vertices it starts at, each vertex by a ring of face-vertices
+			std::vector<std::size_t> nextEdges( faceVertices.size() );
+			std::vector<std::size_t> nextVertices( faceVertices.size() );
+			for ( std::size_t i = 0; i < faceVertices.size(); ++i )
+			{
+				const FaceVertexId nextEdge = next_edge( m_faces, faceVertices[i] );
+				nextEdges[i] = absolute( nextEdge );
+				nextVertices[i] = absolute( FaceVertexId( nextEdge.getFace(), Winding_next( m_faces[nextEdge.getFace()]->getWinding(), nextEdge.getVertex() ) ) );
+			}
+
 			IndexBuffer uniqueEdgeIndices;
-			typedef VertexBuffer<ProximalVertex> UniqueEdges;
-			UniqueEdges uniqueEdges;
+			std::vector<std::size_t> uniqueEdges;
 
 			uniqueEdgeIndices.reserve( faceVertices.size() );
 			uniqueEdges.reserve( faceVertices.size() );
 
 			{
-				ProximalVertexArray edgePairs;
-				edgePairs.resize( faceVertices.size() );
-
-				{
-					for ( std::size_t i = 0; i < faceVertices.size(); ++i )
-					{
-						edgePairs[i].m_next = edgePairs.data() + absoluteIndex( next_edge( m_faces, faceVertices[i] ) );
-					}
-				}
-
-				{
-					UniqueVertexBuffer<ProximalVertex> inserter( uniqueEdges );
-					for ( ProximalVertexArray::iterator i = edgePairs.begin(); i != edgePairs.end(); ++i )
-					{
-						uniqueEdgeIndices.insert( inserter.insert( ProximalVertex( &( *i ) ) ) );
-					}
-				}
+				FaceVertexRings_label( nextEdges, uniqueEdgeIndices, uniqueEdges );
 
 				{
 					edge_clear();
 					m_select_edges.reserve( uniqueEdges.size() );
-					for ( UniqueEdges::iterator i = uniqueEdges.begin(); i != uniqueEdges.end(); ++i )
+					for ( std::size_t i : uniqueEdges )
 					{
-						edge_push_back( faceVertices[ProximalVertexArray_index( edgePairs, *i )] );
+						edge_push_back( faceVertices[i] );
 					}
 				}
 
@@ -195,7 +182,7 @@ void Brush::buildBRep(){
 					m_edge_faces.resize( uniqueEdges.size() );
 					for ( std::size_t i = 0; i < uniqueEdges.size(); ++i )
 					{
-						FaceVertexId faceVertex = faceVertices[ProximalVertexArray_index( edgePairs, uniqueEdges[i] )];
+						FaceVertexId faceVertex = faceVertices[uniqueEdges[i]];
 						m_edge_faces[i] = EdgeFaces( faceVertex.getFace(), m_faces[faceVertex.getFace()]->getWinding()[faceVertex.getVertex()].adjacent );
 					}
 				}
@@ -204,7 +191,7 @@ void Brush::buildBRep(){
 					m_uniqueEdgePoints.resize( uniqueEdges.size() );
 					for ( std::size_t i = 0; i < uniqueEdges.size(); ++i )
 					{
-						FaceVertexId faceVertex = faceVertices[ProximalVertexArray_index( edgePairs, uniqueEdges[i] )];
+						FaceVertexId faceVertex = faceVertices[uniqueEdges[i]];
 
 						const Winding& w = m_faces[faceVertex.getFace()]->getWinding();
 						Vector3 edge = vector3_mid( w[faceVertex.getVertex()].vertex, w[Winding_next( w, faceVertex.getVertex() )].vertex );
@@ -216,37 +203,20 @@ void Brush::buildBRep(){
 
 
 			IndexBuffer uniqueVertexIndices;
-			typedef VertexBuffer<ProximalVertex> UniqueVertices;
-			UniqueVertices uniqueVertices;
+			std::vector<std::size_t> uniqueVertices;
 
 			uniqueVertexIndices.reserve( faceVertices.size() );
 			uniqueVertices.reserve( faceVertices.size() );
 
 			{
-				ProximalVertexArray vertexRings;
-				vertexRings.resize( faceVertices.size() );
-
-				{
-					for ( std::size_t i = 0; i < faceVertices.size(); ++i )
-					{
-						vertexRings[i].m_next = vertexRings.data() + absoluteIndex( next_vertex( m_faces, faceVertices[i] ) );
-					}
-				}
-
-				{
-					UniqueVertexBuffer<ProximalVertex> inserter( uniqueVertices );
-					for ( ProximalVertexArray::iterator i = vertexRings.begin(); i != vertexRings.end(); ++i )
-					{
-						uniqueVertexIndices.insert( inserter.insert( ProximalVertex( &( *i ) ) ) );
-					}
-				}
+				FaceVertexRings_label( nextVertices, uniqueVertexIndices, uniqueVertices );
 
 				{
 					vertex_clear();
 					m_select_vertices.reserve( uniqueVertices.size() );
-					for ( UniqueVertices::iterator i = uniqueVertices.begin(); i != uniqueVertices.end(); ++i )
+					for ( std::size_t i : uniqueVertices )
 					{
-						vertex_push_back( faceVertices[ProximalVertexArray_index( vertexRings, ( *i ) )] );
+						vertex_push_back( faceVertices[i] );
 					}
 				}
 
@@ -254,7 +224,7 @@ void Brush::buildBRep(){
 					m_uniqueVertexPoints.resize( uniqueVertices.size() );
 					for ( std::size_t i = 0; i < uniqueVertices.size(); ++i )
 					{
-						FaceVertexId faceVertex = faceVertices[ProximalVertexArray_index( vertexRings, uniqueVertices[i] )];
+						FaceVertexId faceVertex = faceVertices[uniqueVertices[i]];
 
 						const Winding& winding = m_faces[faceVertex.getFace()]->getWinding();
 						m_uniqueVertexPoints[i] = depthtested_pointvertex_for_windingpoint( winding[faceVertex.getVertex()].vertex, colour_vertex );
@@ -263,7 +233,13 @@ void Brush::buildBRep(){
 			}
 
 			if ( ( uniqueVertices.size() + faces_size ) - uniqueEdges.size() != 2 ) {
-				globalErrorStream() << "Final B-Rep: inconsistent vertex count\n";
+				if ( g_brush_evaluatingInParallel ) {
+					++g_brush_inconsistentCount; // the console is not thread safe, reported by Brush::evaluateBReps()
+				}
+				else
+				{
+					globalErrorStream() << "Final B-Rep: inconsistent vertex count\n";
+				}
 			}
 
 #if BRUSH_CONNECTIVITY_DEBUG
@@ -318,6 +294,71 @@ void Brush::buildBRep(){
 }
 
 
+void Brush::evaluateBReps( const std::vector<Brush*>& brushes ){
+	const std::size_t c_minParallelBrushes = 64;
+	const std::size_t c_chunkSize = 16;
+
+	std::vector<Brush*> pending;
+	for ( Brush* brush : brushes )
+	{
+		if ( brush->m_planeChanged ) {
+			// transforms notify texture and selection observers, evaluate them here
+			brush->m_BRep_evaluation = true;
+			brush->evaluateTransform();
+			brush->m_BRep_evaluation = false;
+			// vertex mode selects vertices after the build
+			if ( brush->m_vertexModeOn ) {
+				brush->evaluateBRep();
+			}
+			else
+			{
+				pending.push_back( brush );
+			}
+		}
+	}
+
+	const std::size_t threads = std::min<std::size_t>( std::thread::hardware_concurrency(), pending.size() / c_chunkSize );
+	if ( pending.size() < c_minParallelBrushes || threads < 2 ) {
+		for ( Brush* brush : pending )
+		{
+			brush->evaluateBRep();
+		}
+		return;
+	}
+
+	std::atomic<std::size_t> next( 0 );
+	const auto work = [&pending, &next](){
+		g_brush_evaluatingInParallel = true;
+		for ( std::size_t first; ( first = next.fetch_add( c_chunkSize ) ) < pending.size(); )
+		{
+			const std::size_t last = std::min( first + c_chunkSize, pending.size() );
+			for ( std::size_t i = first; i != last; ++i )
+			{
+				pending[i]->evaluateBRep();
+			}
+		}
+		g_brush_evaluatingInParallel = false;
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve( threads - 1 );
+	for ( std::size_t i = 1; i < threads; ++i )
+	{
+		workers.emplace_back( work );
+	}
+	work();
+	for ( std::thread& worker : workers )
+	{
+		worker.join();
+	}
+
+	for ( std::size_t i = g_brush_inconsistentCount.exchange( 0 ); i != 0; --i )
+	{
+		globalErrorStream() << "Final B-Rep: inconsistent vertex count\n";
+	}
+}
+
+
 class FaceFilterWrapper : public Filter
 {
 	FaceFilter& m_filter;
@@ -334,6 +334,14 @@ public:
 			//faceShader.setFlags( m_flags ); //detail, structural flags aren't undoable with this
 			faceShader.m_flags = m_flags;
 		}
+
+		bool equal( const FaceShader& faceShader ) const {
+			return string_equal( m_shader.c_str(), faceShader.getShader() )
+			    && m_flags.m_surfaceFlags == faceShader.m_flags.m_surfaceFlags
+			    && m_flags.m_contentFlags == faceShader.m_flags.m_contentFlags
+			    && m_flags.m_value == faceShader.m_flags.m_value
+			    && m_flags.m_specified == faceShader.m_flags.m_specified;
+		}
 	};
 
 	CopiedString m_shader;
@@ -477,6 +485,10 @@ public:
 		void exportState( FaceTexdef& faceTexdef ) const {
 			Texdef_Assign( faceTexdef.m_projection, m_projection );
 		}
+
+		bool equal( const FaceTexdef& faceTexdef ) const {
+			return Texdef_equal( m_projection, faceTexdef.m_projection );
+		}
 	};
 
 	FaceShader& m_shader;
@@ -668,6 +680,16 @@ public:
 				facePlane.MakePlane();
 			}
 		}
+
+		bool equal( const FacePlane& facePlane ) const {
+			if ( facePlane.isDoom3Plane() ) {
+				return m_plane.a == facePlane.m_plane.a
+				    && m_plane.b == facePlane.m_plane.b
+				    && m_plane.c == facePlane.m_plane.c
+				    && m_plane.d == facePlane.m_plane.d;
+			}
+			return planepts_equal( m_planepts, facePlane.planePoints() );
+		}
 	};
 
 	FacePlane() : m_funcStaticOrigin( 0, 0, 0 ){
@@ -899,7 +921,18 @@ class Face :
 {
 	std::size_t m_refcount;
 
-	class SavedState : public UndoMemento
+/// \brief Base of the face undo mementos; each restores some part of the face state.
+	class FaceUndoMemento : public UndoMemento
+	{
+	public:
+		virtual void exportState( Face& face ) const = 0;
+
+		void release(){
+			delete this;
+		}
+	};
+
+	class SavedState : public FaceUndoMemento
 	{
 	public:
 		FacePlane::SavedState m_planeState;
@@ -915,8 +948,44 @@ class Face :
 			m_texdefState.exportState( face.getTexdef() );
 		}
 
-		void release(){
-			delete this;
+		std::size_t size() const {
+			return sizeof( *this ) + string_length( m_shaderState.m_shader.c_str() ) + 1;
+		}
+	};
+
+/// \brief Delta memento for commands that only moved the plane, e.g. translating or resizing a brush.
+	class PlaneSavedState : public FaceUndoMemento
+	{
+	public:
+		FacePlane::SavedState m_planeState;
+
+		PlaneSavedState( const SavedState& state ) : m_planeState( state.m_planeState ){
+		}
+
+		void exportState( Face& face ) const {
+			m_planeState.exportState( face.getPlane() );
+		}
+
+		std::size_t size() const {
+			return sizeof( *this );
+		}
+	};
+
+/// \brief Delta memento for commands that only changed the texture projection, e.g. shifting or scaling a texture.
+	class TexdefSavedState : public FaceUndoMemento
+	{
+	public:
+		FaceTexdef::SavedState m_texdefState;
+
+		TexdefSavedState( const SavedState& state ) : m_texdefState( state.m_texdefState ){
+		}
+
+		void exportState( Face& face ) const {
+			m_texdefState.exportState( face.getTexdef() );
+		}
+
+		std::size_t size() const {
+			return sizeof( *this );
 		}
 	};
 
@@ -1049,10 +1118,30 @@ public:
 	UndoMemento* exportState() const {
 		return new SavedState( *this );
 	}
+	UndoMemento* diffState( UndoMemento* data ) const {
+		const SavedState& state = *static_cast<const SavedState*>( data );
+		const bool planeDiffers = !state.m_planeState.equal( getPlane() );
+		const bool texdefDiffers = !state.m_texdefState.equal( getTexdef() );
+		const bool shaderDiffers = !state.m_shaderState.equal( getShader() );
+
+		if ( shaderDiffers || ( planeDiffers && texdefDiffers ) ) {
+			return data;
+		}
+
+		UndoMemento* delta = 0;
+		if ( planeDiffers ) {
+			delta = new PlaneSavedState( state );
+		}
+		else if ( texdefDiffers ) {
+			delta = new TexdefSavedState( state );
+		}
+		data->release();
+		return delta;
+	}
 	void importState( const UndoMemento* data ){
 		undoSave();
 
-		static_cast<const SavedState*>( data )->exportState( *this );
+		static_cast<const FaceUndoMemento*>( data )->exportState( *this );
 
 		planeChanged();
 		m_observer->connectivityChanged();
@@ -1958,6 +2047,9 @@ public:
 		void release(){
 			delete this;
 		}
+		std::size_t size() const {
+			return sizeof( *this ) + m_faces.size() * sizeof( FaceSmartPointer );
+		}
 
 		Faces m_faces;
 	};
@@ -1975,6 +2067,15 @@ public:
 		return new BrushUndoMemento( m_faces );
 	}
 
+/// \brief Discards the memento if the command did not add, remove or reorder faces; changes to the faces themselves are saved by each face.
+	UndoMemento* diffState( UndoMemento* state ) const {
+		if ( static_cast<const BrushUndoMemento*>( state )->m_faces == m_faces ) {
+			state->release();
+			return 0;
+		}
+		return state;
+	}
+
 	void importState( const UndoMemento* state ){
 		undoSave();
 		appendFaces( static_cast<const BrushUndoMemento*>( state )->m_faces );
@@ -2551,6 +2652,9 @@ private:
 
 /// \brief Constructs the face windings and updates anything that depends on them.
 	void buildBRep();
+/// \brief Evaluates the B-Rep of each of \p brushes whose planes changed.
+/// Transforms are evaluated on the calling thread, the windings of independent brushes are then built in parallel.
+	static void evaluateBReps( const std::vector<Brush*>& brushes );
 };
 
 
@@ -4098,6 +4202,9 @@ public:
 		m_clipPlane.setPlane( m_brush, plane );
 	}
 
+	const AABB& cullableAABB() const {
+		return worldAABB();
+	}
 	bool testLight( const RendererLight& light ) const {
 		return light.testAABB( worldAABB() );
 	}
@@ -4142,6 +4249,15 @@ inline const Functor& Scene_forEachSelectedBrush( const Functor& functor ){
 	return functor;
 }
 
+/// \brief Rebuilds the selected brushes whose planes changed, in parallel when there are many of them.
+inline void Scene_evaluateSelectedBReps(){
+	std::vector<Brush*> brushes;
+	Scene_forEachSelectedBrush( [&brushes]( BrushInstance& brush ){
+		brushes.push_back( &brush.getBrush() );
+	} );
+	Brush::evaluateBReps( brushes );
+}
+
 template<typename Functor>
 class BrushVisibleSelectedVisitor : public SelectionSystem::Visitor
 {
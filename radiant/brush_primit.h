@@ -84,6 +84,22 @@ public:
 	}
 };
 
+inline bool Texdef_equal( const TextureProjection& projection, const TextureProjection& other ){
+	return projection.m_texdef.shift[0] == other.m_texdef.shift[0]
+	    && projection.m_texdef.shift[1] == other.m_texdef.shift[1]
+	    && projection.m_texdef.rotate == other.m_texdef.rotate
+	    && projection.m_texdef.scale[0] == other.m_texdef.scale[0]
+	    && projection.m_texdef.scale[1] == other.m_texdef.scale[1]
+	    && projection.m_brushprimit_texdef.coords[0][0] == other.m_brushprimit_texdef.coords[0][0]
+	    && projection.m_brushprimit_texdef.coords[0][1] == other.m_brushprimit_texdef.coords[0][1]
+	    && projection.m_brushprimit_texdef.coords[0][2] == other.m_brushprimit_texdef.coords[0][2]
+	    && projection.m_brushprimit_texdef.coords[1][0] == other.m_brushprimit_texdef.coords[1][0]
+	    && projection.m_brushprimit_texdef.coords[1][1] == other.m_brushprimit_texdef.coords[1][1]
+	    && projection.m_brushprimit_texdef.coords[1][2] == other.m_brushprimit_texdef.coords[1][2]
+	    && projection.m_basis_s == other.m_basis_s
+	    && projection.m_basis_t == other.m_basis_t;
+}
+
 float Texdef_getDefaultTextureScale();
 
 struct Winding;
@@ -134,7 +134,33 @@ public:
 
 //#pragma GCC pop_options
 
+static thread_local Sys_PrintQueue* g_printQueue = 0;
+
+void Sys_PrintQueue::append( int level, const char* buf, std::size_t length ){
+	if ( m_messages.empty() || m_messages.back().first != level ) {
+		m_messages.emplace_back( level, std::string() );
+	}
+	m_messages.back().second.append( buf, length );
+}
+
+void Sys_PrintQueue::flush(){
+	for ( const auto& message : m_messages )
+	{
+		Sys_Print( message.first, message.second.data(), message.second.size() );
+	}
+	m_messages.clear();
+}
+
+void Sys_Print_setThreadQueue( Sys_PrintQueue* queue ){
+	g_printQueue = queue;
+}
+
 std::size_t Sys_Print( int level, const char* buf, std::size_t length ){
+	if ( g_printQueue != 0 ) {
+		g_printQueue->append( level, buf, length );
+		return length;
+	}
+
 	const bool contains_newline = std::find( buf, buf + length, '\n' ) != buf + length;
 
 	if ( level == SYS_ERR ) {
@@ -22,6 +22,9 @@
 #pragma once
 
 #include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
 
 #define SYS_VRB 0 ///< verbose support (on/off)
 #define SYS_STD 1 ///< standard print level - this is the default
@@ -30,6 +33,18 @@
 #define SYS_NOCON 4 ///< no console, only print to the file (useful whenever Sys_Printf and output IS the problem)
 
 std::size_t Sys_Print( int level, const char* buf, std::size_t length );
+
+/// \brief Queues the console messages of a worker thread, which must not touch the console widget.
+class Sys_PrintQueue
+{
+	std::vector<std::pair<int, std::string>> m_messages;
+public:
+	void append( int level, const char* buf, std::size_t length );
+	/// \brief Prints the queued messages in order; called from the main thread.
+	void flush();
+};
+/// \brief Messages printed by the calling thread go to \p queue until it is reset to 0.
+void Sys_Print_setThreadQueue( Sys_PrintQueue* queue );
 class TextOutputStream;
 TextOutputStream& getSysPrintOutputStream();
 TextOutputStream& getSysPrintWarningStream();
@@ -24,6 +24,8 @@
 #include "debugging/debugging.h"
 
 #include <list>
+#include <algorithm>
+#include "container/aabbtree.h"
 
 #include "map.h"
 #include "brushmanip.h"
@@ -372,22 +374,36 @@ public:
 
 typedef std::list<Brush*> brushlist_t;
 
-class BrushGatherSelected : public scene::Graph::Walker
+/// \brief Gathers the selected brushes from the selection system, without walking the whole scene graph.
+class BrushGatherSelected : public SelectionSystem::Visitor
 {
 	brush_vector_t& m_brushlist;
 public:
 	BrushGatherSelected( brush_vector_t& brushlist )
 		: m_brushlist( brushlist ){
 	}
-	bool pre( const scene::Path& path, scene::Instance& instance ) const {
-		if ( path.top().get().visible() ) {
-			Brush* brush = Node_getBrush( path.top() );
-			if ( brush != 0
-			  && Instance_isSelected( instance ) ) {
+	void visit( scene::Instance& instance ) const {
+		if ( instance.path().top().get().visible() ) {
+			Brush* brush = Node_getBrush( instance.path().top() );
+			if ( brush != 0 ) {
 				m_brushlist.push_back( brush );
 			}
 		}
-		return true;
+	}
+};
+
+/// \brief Gathers the paths of the selected brushes, so that they can be modified after the selection has been visited.
+class BrushPathGatherSelected : public SelectionSystem::Visitor
+{
+	std::vector<scene::Path>& m_paths;
+public:
+	BrushPathGatherSelected( std::vector<scene::Path>& paths )
+		: m_paths( paths ){
+	}
+	void visit( scene::Instance& instance ) const {
+		if ( instance.path().top().get().visible() && Node_getBrush( instance.path().top() ) != 0 ) {
+			m_paths.push_back( instance.path() );
+		}
 	}
 };
 /*
@@ -606,19 +622,28 @@ bool Brush_subtract( const Brush& brush, const Brush& other, brush_vector_t& ret
 	return false;
 }
 
+/// \brief Subtracts the selected brushes from each unselected brush they overlap.
+/// Subgraphs whose bounds miss the selection are skipped, and each brush is only tested against the selected brushes found in a bounding-volume hierarchy.
 class SubtractBrushesFromUnselected : public scene::Graph::Walker
 {
 	const brush_vector_t& m_brushlist;
+	AABBTree<std::size_t> m_tree;
+	mutable std::vector<std::size_t> m_overlapping;
 	std::size_t& m_before;
 	std::size_t& m_after;
 	mutable bool m_eraseParent;
 public:
 	SubtractBrushesFromUnselected( const brush_vector_t& brushlist, std::size_t& before, std::size_t& after )
 		: m_brushlist( brushlist ), m_before( before ), m_after( after ), m_eraseParent( false ){
+		for ( std::size_t i = 0; i != m_brushlist.size(); ++i )
+		{
+			m_tree.insert( m_brushlist[i]->localAABB(), i );
+		}
+		m_tree.build();
 	}
 	bool pre( const scene::Path& path, scene::Instance& instance ) const {
 		if ( path.top().get().visible() ) {
-			return true;
+			return path.size() == 1 || aabb_intersects_aabb( instance.worldAABB(), m_tree.bounds() );
 		}
 		return false;
 	}
@@ -627,17 +652,27 @@ public:
 			Brush* brush = Node_getBrush( path.top() );
 			if ( brush != 0
 			  && !Instance_isSelected( instance ) ) {
+				// subtract in selection order, so the fragments do not depend on the hierarchy layout
+				m_overlapping.clear();
+				m_tree.forEachIntersecting( brush->localAABB(), [this]( std::size_t index ){
+					m_overlapping.push_back( index );
+				} );
+				if ( m_overlapping.empty() ) {
+					return;
+				}
+				std::sort( m_overlapping.begin(), m_overlapping.end() );
+
 				brush_vector_t buffer[2];
 				bool swap = false;
 				Brush* original = new Brush( *brush );
 				buffer[static_cast<std::size_t>( swap )].push_back( original );
 
 				{
-					for ( brush_vector_t::const_iterator i( m_brushlist.begin() ); i != m_brushlist.end(); ++i )
+					for ( std::vector<std::size_t>::const_iterator i( m_overlapping.begin() ); i != m_overlapping.end(); ++i )
 					{
 						for ( brush_vector_t::iterator j( buffer[static_cast<std::size_t>( swap )].begin() ); j != buffer[static_cast<std::size_t>( swap )].end(); ++j )
 						{
-							if ( Brush_subtract( *( *j ), *( *i ), buffer[static_cast<std::size_t>( !swap )] ) ) {
+							if ( Brush_subtract( *( *j ), *m_brushlist[*i], buffer[static_cast<std::size_t>( !swap )] ) ) {
 								delete ( *j );
 							}
 							else
@@ -693,7 +728,7 @@ public:
 
 void CSG_Subtract(){
 	brush_vector_t selected_brushes;
-	GlobalSceneGraph().traverse( BrushGatherSelected( selected_brushes ) );
+	GlobalSelectionSystem().foreachSelected( BrushGatherSelected( selected_brushes ) );
 
 	if ( selected_brushes.empty() ) {
 		globalWarningStream() << "CSG Subtract: No brushes selected.\n";
@@ -717,7 +752,7 @@ void CSG_Subtract(){
 }
 
 #include "clippertool.h"
-class BrushSplitByPlaneSelected : public scene::Graph::Walker
+class BrushSplitByPlaneSelected
 {
 	const ClipperPoints m_points;
 	const Plane3 m_plane; /* plane to insert */
@@ -731,46 +766,38 @@ public:
 		m_plane( plane3_for_points( m_points[0], m_points[1], m_points[2] ) ),
 		m_shader( shader ), m_projection( projection ), m_split( split ), m_gj( false ){
 	}
-	bool pre( const scene::Path& path, scene::Instance& instance ) const {
-		return true;
-	}
-	void post( const scene::Path& path, scene::Instance& instance ) const {
-		if ( path.top().get().visible() ) {
-			Brush* brush = Node_getBrush( path.top() );
-			if ( brush != 0
-			  && Instance_isSelected( instance ) ) {
-				const brushsplit_t split = Brush_classifyPlane( *brush, m_plane );
-				if ( split.counts[ePlaneBack] && split.counts[ePlaneFront] ) {
-					// the plane intersects this brush
-					m_gj = true;
-					if ( m_split ) {
-						NodeSmartReference node( ( new BrushNode() )->node() );
-						Brush* fragment = Node_getBrush( node );
-						fragment->copy( *brush );
-						fragment->addPlane( m_points[0], m_points[2], m_points[1], m_shader, m_projection );
-						fragment->removeEmptyFaces();
-						ASSERT_MESSAGE( !fragment->empty(), "brush left with no faces after split" );
-
-						Node_getTraversable( path.parent() )->insert( node );
-						{
-							scene::Path fragmentPath = path;
-							fragmentPath.top() = makeReference( node.get() );
-							selectPath( fragmentPath, true );
-						}
-					}
-
-					brush->addPlane( m_points[0], m_points[1], m_points[2], m_shader, m_projection );
-					brush->removeEmptyFaces();
-					ASSERT_MESSAGE( !brush->empty(), "brush left with no faces after split" );
+	void operator()( const scene::Path& path ) const {
+		Brush* brush = Node_getBrush( path.top() );
+		const brushsplit_t split = Brush_classifyPlane( *brush, m_plane );
+		if ( split.counts[ePlaneBack] && split.counts[ePlaneFront] ) {
+			// the plane intersects this brush
+			m_gj = true;
+			if ( m_split ) {
+				NodeSmartReference node( ( new BrushNode() )->node() );
+				Brush* fragment = Node_getBrush( node );
+				fragment->copy( *brush );
+				fragment->addPlane( m_points[0], m_points[2], m_points[1], m_shader, m_projection );
+				fragment->removeEmptyFaces();
+				ASSERT_MESSAGE( !fragment->empty(), "brush left with no faces after split" );
+
+				Node_getTraversable( path.parent() )->insert( node );
+				{
+					scene::Path fragmentPath = path;
+					fragmentPath.top() = makeReference( node.get() );
+					selectPath( fragmentPath, true );
 				}
-				else
-					// the plane does not intersect this brush and the brush is in front of the plane
-					if ( !m_split && split.counts[ePlaneFront] != 0 ) {
-						m_gj = true;
-						Path_deleteTop( path );
-					}
 			}
+
+			brush->addPlane( m_points[0], m_points[1], m_points[2], m_shader, m_projection );
+			brush->removeEmptyFaces();
+			ASSERT_MESSAGE( !brush->empty(), "brush left with no faces after split" );
 		}
+		else
+			// the plane does not intersect this brush and the brush is in front of the plane
+			if ( !m_split && split.counts[ePlaneFront] != 0 ) {
+				m_gj = true;
+				Path_deleteTop( path );
+			}
 	}
 };
 
@@ -781,15 +808,21 @@ void Scene_BrushSplitByPlane( scene::Graph& graph, const ClipperPoints& points,
 	TextureProjection projection;
 	TexDef_Construct_Default( projection );
 	BrushSplitByPlaneSelected dosplit( points, flip, shader, projection, split );
-	if( points._count > 1 && plane3_valid( plane3_for_points( points._points ) ) )
-		graph.traverse( dosplit );
+	if( points._count > 1 && plane3_valid( plane3_for_points( points._points ) ) ){
+		std::vector<scene::Path> paths;
+		GlobalSelectionSystem().foreachSelected( BrushPathGatherSelected( paths ) );
+		for ( const scene::Path& path : paths )
+		{
+			dosplit( path );
+		}
+	}
 	if( !dosplit.m_gj ){
 		CSG_WrapMerge( points );
 	}
 }
 
 
-class BrushInstanceSetClipPlane : public scene::Graph::Walker
+class BrushInstanceSetClipPlane : public SelectionSystem::Visitor
 {
 	const Plane3 m_plane;
 public:
@@ -800,20 +833,18 @@ public:
 		             ? plane3_for_points( points[0], points[2], points[1] )
 		             : plane3_for_points( points[0], points[1], points[2] ) ){
 	}
-	bool pre( const scene::Path& path, scene::Instance& instance ) const {
+	void visit( scene::Instance& instance ) const {
 		BrushInstance* brush = Instance_getBrush( instance );
 		if ( brush != 0
-		     && path.top().get().visible()
-		     && brush->isSelected() ) {
+		     && instance.path().top().get().visible() ) {
 			BrushInstance& brushInstance = *brush;
 			brushInstance.setClipPlane( m_plane );
 		}
-		return true;
 	}
 };
 
 void Scene_BrushSetClipPlane( scene::Graph& graph, const ClipperPoints& points, bool flip ){
-	graph.traverse( BrushInstanceSetClipPlane( points, flip ) );
+	GlobalSelectionSystem().foreachSelected( BrushInstanceSetClipPlane( points, flip ) );
 }
 
 /*
@@ -922,7 +953,7 @@ void CSG_Merge(){
 	brush_vector_t selected_brushes;
 
 	// remove selected
-	GlobalSceneGraph().traverse( BrushGatherSelected( selected_brushes ) );
+	GlobalSelectionSystem().foreachSelected( BrushGatherSelected( selected_brushes ) );
 
 	if ( selected_brushes.empty() ) {
 		globalWarningStream() << "CSG Merge: No brushes selected.\n";
@@ -1106,7 +1137,7 @@ void CSG_WrapMerge( const ClipperPoints& clipperPoints ){
 	const bool primit = ( GlobalSelectionSystem().Mode() == SelectionSystem::ePrimitive );
 	brush_vector_t selected_brushes;
 	if( primit )
-		GlobalSceneGraph().traverse( BrushGatherSelected( selected_brushes ) );
+		GlobalSelectionSystem().foreachSelected( BrushGatherSelected( selected_brushes ) );
 
 	MergeVertices mergeVertices;
 	/* gather unique vertices */
@@ -24,6 +24,7 @@
 #include "debugging/debugging.h"
 
 #include <map>
+#include <vector>
 
 #include "ifilesystem.h"
 #include "iscriplib.h"
@@ -37,6 +38,7 @@
 #include "moduleobservers.h"
 #include "stringio.h"
 #include "stream/textfilestream.h"
+#include "cachelib.h"
 
 namespace
 {
@@ -47,6 +49,7 @@ BaseClasses g_EntityClassFGD_bases;
 EntityClass   *g_EntityClassFGD_bad = 0;
 typedef std::map<CopiedString, ListAttributeType> ListAttributeTypes;
 ListAttributeTypes g_listTypesFGD;
+std::vector<CopiedString> g_EntityClassFGD_files;
 }
 
 
@@ -58,6 +61,7 @@ void EntityClassFGD_clear(){
 	}
 	g_EntityClassFGD_bases.clear();
 	g_listTypesFGD.clear();
+	g_EntityClassFGD_files.clear();
 }
 
 EntityClass* EntityClassFGD_insertUniqueBase( EntityClass* entityClass ){
@@ -592,6 +596,7 @@ void EntityClassFGD_loadFile( const char* filename ){
 	TextFileInputStream file( filename );
 	if ( !file.failed() ) {
 		globalOutputStream() << "parsing entity classes from " << makeQuoted( filename ) << '\n';
+		g_EntityClassFGD_files.emplace_back( filename );
 
 		EntityClassFGD_parse( file, filename );
 	}
@@ -664,6 +669,256 @@ void EntityClassFGD_resolveInheritance( EntityClass* derivedClass ){
 	}
 }
 
+const char c_entityClassCacheMagic[4] = { 'R', 'F', 'G', 'D' };
+const std::uint32_t c_entityClassCacheVersion = 1;
+
+const char* EntityClassFGD_cachePath(){
+	static CopiedString path;
+	path = StringStream( GlobalRadiant().getLocalRcPath(), "entities.cache" );
+	return path.c_str();
+}
+
+/// \brief Identifies the entity classes by the game and the .fgd files found in the tools directories, files included by these are checked on load.
+CacheWriter EntityClassFGD_cacheKey( const std::vector<CopiedString>& filenames ){
+	CacheWriter key;
+	key.writeString( GlobalRadiant().getGameName() );
+	key.write( std::uint32_t( filenames.size() ) );
+	for ( const CopiedString& filename : filenames )
+	{
+		key.writeSource( filename.c_str(), filename.c_str() );
+	}
+	return key;
+}
+
+void EntityClassFGD_writeString( CacheWriter& payload, const CopiedString& string ){
+	payload.writeString( string.c_str() );
+}
+
+/// \brief Saves the resolved entity classes and list types.
+void EntityClassFGD_saveCache( const CacheWriter& key ){
+	CacheWriter payload;
+
+	payload.write( std::uint32_t( g_EntityClassFGD_files.size() ) );
+	for ( const CopiedString& filename : g_EntityClassFGD_files )
+	{
+		payload.writeSource( filename.c_str(), filename.c_str() );
+	}
+
+	payload.write( std::uint32_t( g_listTypesFGD.size() ) );
+	for ( const auto& [ name, listType ] : g_listTypesFGD )
+	{
+		EntityClassFGD_writeString( payload, name );
+		payload.write( std::uint32_t( std::distance( listType.begin(), listType.end() ) ) );
+		for ( const auto& [ itemName, itemValue ] : listType )
+		{
+			EntityClassFGD_writeString( payload, itemName );
+			EntityClassFGD_writeString( payload, itemValue );
+		}
+	}
+
+	// base classes and entity classes are mostly the same objects
+	std::vector<const EntityClass*> classes;
+	std::map<const EntityClass*, std::uint8_t> membership;
+	for ( const auto& [ name, entityClass ] : g_EntityClassFGD_bases )
+	{
+		if ( membership.emplace( entityClass, 0 ).second ) {
+			classes.push_back( entityClass );
+		}
+		membership[entityClass] |= 1;
+	}
+	for ( const auto& [ name, entityClass ] : g_EntityClassFGD_classes )
+	{
+		if ( membership.emplace( entityClass, 0 ).second ) {
+			classes.push_back( entityClass );
+		}
+		membership[entityClass] |= 2;
+	}
+
+	std::map<const EntityClassAttribute*, std::pair<std::uint32_t, std::uint32_t>> attributeIndices;
+	for ( std::size_t i = 0; i != classes.size(); ++i )
+	{
+		std::uint32_t index = 0;
+		for ( const EntityClassAttributePair& attribute : classes[i]->m_attributes )
+		{
+			attributeIndices.emplace( &attribute.second, std::make_pair( std::uint32_t( i ), index++ ) );
+		}
+	}
+
+	payload.write( std::uint32_t( classes.size() ) );
+	for ( const EntityClass* entityClass : classes )
+	{
+		payload.writeString( entityClass->name() );
+		payload.write( membership[entityClass] );
+		payload.write( std::uint32_t( entityClass->m_parent.size() ) );
+		for ( const CopiedString& parent : entityClass->m_parent )
+		{
+			EntityClassFGD_writeString( payload, parent );
+		}
+		payload.write( entityClass->fixedsize );
+		payload.write( entityClass->unknown );
+		payload.write( entityClass->miscmodel_is );
+		EntityClassFGD_writeString( payload, entityClass->m_miscmodel_key );
+		payload.write( entityClass->has_angles );
+		payload.write( entityClass->has_angles_key );
+		payload.write( entityClass->has_direction_key );
+		payload.write( entityClass->mins );
+		payload.write( entityClass->maxs );
+		payload.write( entityClass->color );
+		EntityClassFGD_writeString( payload, entityClass->m_comments );
+		EntityClassFGD_writeString( payload, entityClass->m_modelpath );
+		EntityClassFGD_writeString( payload, entityClass->m_skin );
+		payload.write( entityClass->inheritanceResolved );
+		payload.write( entityClass->sizeSpecified );
+		payload.write( entityClass->colorSpecified );
+
+		payload.write( std::uint32_t( entityClass->m_attributes.size() ) );
+		for ( const auto& [ key, attribute ] : entityClass->m_attributes )
+		{
+			EntityClassFGD_writeString( payload, key );
+			EntityClassFGD_writeString( payload, attribute.m_type );
+			EntityClassFGD_writeString( payload, attribute.m_name );
+			EntityClassFGD_writeString( payload, attribute.m_value );
+			EntityClassFGD_writeString( payload, attribute.m_description );
+		}
+
+		for ( std::size_t flag = 0; flag != MAX_FLAGS; ++flag )
+		{
+			payload.writeString( entityClass->flagnames[flag] );
+			const auto attribute = attributeIndices.find( entityClass->flagAttributes[flag] );
+			payload.write( attribute != attributeIndices.end() ? attribute->second.first : std::uint32_t( -1 ) );
+			payload.write( attribute != attributeIndices.end() ? attribute->second.second : std::uint32_t( -1 ) );
+		}
+	}
+
+	if ( !CacheFile_save( EntityClassFGD_cachePath(), c_entityClassCacheMagic, c_entityClassCacheVersion, key, payload ) ) {
+		globalWarningStream() << "Unable to write entity class cache " << EntityClassFGD_cachePath() << '\n';
+	}
+}
+
+/// \brief Fills the entity class tables from the cache if it was built from the current .fgd files, returns false if they must be parsed.
+bool EntityClassFGD_loadCache( const CacheWriter& key ){
+	const CacheFile cache( EntityClassFGD_cachePath(), c_entityClassCacheMagic, c_entityClassCacheVersion, key );
+	if ( !cache.valid() ) {
+		return false;
+	}
+	CacheReader reader = cache.reader();
+
+	// included files are not part of the key
+	for ( std::size_t count = reader.readCount(); count != 0 && !reader.failed(); --count )
+	{
+		const char* filename = reader.readString();
+		const std::uint64_t size = reader.read<std::uint64_t>();
+		const std::int64_t modified = reader.read<std::int64_t>();
+		if ( size != file_size( filename ) || modified != file_modified( filename ) ) {
+			g_EntityClassFGD_files.clear();
+			return false;
+		}
+		g_EntityClassFGD_files.emplace_back( filename );
+	}
+
+	for ( std::size_t count = reader.readCount(); count != 0 && !reader.failed(); --count )
+	{
+		ListAttributeType& listType = g_listTypesFGD[reader.readString()];
+		for ( std::size_t items = reader.readCount(); items != 0 && !reader.failed(); --items )
+		{
+			const char* name = reader.readString();
+			listType.push_back( name, reader.readString() );
+		}
+	}
+
+	std::vector<EntityClass*> classes;
+	std::vector<std::vector<const EntityClassAttribute*>> attributes;
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> flagAttributes;
+	for ( std::size_t count = reader.readCount(); count != 0 && !reader.failed(); --count )
+	{
+		EntityClass* entityClass = Eclass_Alloc();
+		entityClass->free = &Eclass_Free;
+		classes.push_back( entityClass );
+
+		entityClass->name_set( reader.readString() );
+		const std::uint8_t membership = reader.read<std::uint8_t>();
+		for ( std::size_t parents = reader.readCount(); parents != 0 && !reader.failed(); --parents )
+		{
+			entityClass->m_parent.emplace_back( reader.readString() );
+		}
+		entityClass->fixedsize = reader.read<bool>();
+		entityClass->unknown = reader.read<bool>();
+		entityClass->miscmodel_is = reader.read<bool>();
+		entityClass->m_miscmodel_key = reader.readString();
+		entityClass->has_angles = reader.read<bool>();
+		entityClass->has_angles_key = reader.read<bool>();
+		entityClass->has_direction_key = reader.read<bool>();
+		entityClass->mins = reader.read<Vector3>();
+		entityClass->maxs = reader.read<Vector3>();
+		entityClass->color = reader.read<Colour3>();
+		entityClass->m_comments = reader.readString();
+		entityClass->m_modelpath = reader.readString();
+		entityClass->m_skin = reader.readString();
+		entityClass->inheritanceResolved = reader.read<bool>();
+		entityClass->sizeSpecified = reader.read<bool>();
+		entityClass->colorSpecified = reader.read<bool>();
+
+		attributes.emplace_back();
+		for ( std::size_t attributeCount = reader.readCount(); attributeCount != 0 && !reader.failed(); --attributeCount )
+		{
+			const char* key = reader.readString();
+			const char* type = reader.readString();
+			const char* name = reader.readString();
+			const char* value = reader.readString();
+			const char* description = reader.readString();
+			attributes.back().push_back( &EntityClass_insertAttribute( *entityClass, key, EntityClassAttribute( type, name, value, description ) ).second );
+		}
+
+		for ( std::size_t flag = 0; flag != MAX_FLAGS; ++flag )
+		{
+			strncpy( entityClass->flagnames[flag], reader.readString(), std::size( entityClass->flagnames[flag] ) - 1 );
+			const std::uint32_t owner = reader.read<std::uint32_t>();
+			flagAttributes.emplace_back( owner, reader.read<std::uint32_t>() );
+		}
+
+		if ( membership & 1 ) {
+			g_EntityClassFGD_bases.emplace( entityClass->name(), entityClass );
+		}
+		if ( membership & 2 ) {
+			g_EntityClassFGD_classes.emplace( entityClass->name(), entityClass );
+		}
+	}
+
+	bool valid = !reader.failed() && reader.finished();
+	for ( std::size_t i = 0; valid && i != classes.size(); ++i )
+	{
+		for ( std::size_t flag = 0; flag != MAX_FLAGS; ++flag )
+		{
+			const auto [ owner, index ] = flagAttributes[i * MAX_FLAGS + flag];
+			if ( owner == std::uint32_t( -1 ) ) {
+				continue;
+			}
+			if ( owner >= attributes.size() || index >= attributes[owner].size() ) {
+				valid = false;
+				break;
+			}
+			classes[i]->flagAttributes[flag] = attributes[owner][index];
+		}
+	}
+
+	if ( !valid ) {
+		globalWarningStream() << "Entity class cache " << EntityClassFGD_cachePath() << " is corrupt, parsing entity classes\n";
+		g_EntityClassFGD_classes.clear();
+		g_EntityClassFGD_bases.clear();
+		// not entityClass->free(): no shader state is captured before realise() finishes, releasing it would unbalance the colour states
+		for ( EntityClass* entityClass : classes )
+		{
+			delete entityClass;
+		}
+		g_listTypesFGD.clear();
+		g_EntityClassFGD_files.clear();
+		return false;
+	}
+
+	globalOutputStream() << "Loaded " << g_EntityClassFGD_classes.size() << " entity classes from " << EntityClassFGD_cachePath() << '\n';
+	return true;
+}
+
 class EntityClassFGD : public ModuleObserver
 {
 	std::size_t m_unrealised;
@@ -673,6 +928,9 @@ public:
 	}
 	void realise(){
 		if ( --m_unrealised == 0 ) {
+			s_fgd_warned = false;
+			CacheWriter key;
+			bool cached;
 
 			{
 				const auto baseDirectory = StringStream( GlobalRadiant().getGameToolsPath(), GlobalRadiant().getRequiredGameDescriptionKeyValue( "basegame" ), '/' );
@@ -695,8 +953,18 @@ public:
 					constructDirectory( gameDirectory, "fgd" );
 				}
 
+				std::vector<CopiedString> filenames;
 				for( const auto& [ name, path ] : name_path ){
-					EntityClassFGD_loadFile( StringStream()( path, name ) );
+					filenames.emplace_back( StringStream()( path, name ) );
+				}
+
+				key = EntityClassFGD_cacheKey( filenames );
+				cached = EntityClassFGD_loadCache( key );
+				if ( !cached ) {
+					for ( const CopiedString& filename : filenames )
+					{
+						EntityClassFGD_loadFile( filename.c_str() );
+					}
 				}
 			}
 
@@ -714,6 +982,10 @@ public:
 					}
 				}
 			}
+			// classes with parse errors are parsed again, to show the errors
+			if ( !cached && !s_fgd_warned ) {
+				EntityClassFGD_saveCache( key );
+			}
 			{
 				for ( BaseClasses::iterator i = g_EntityClassFGD_bases.begin(); i != g_EntityClassFGD_bases.end(); ++i )
 				{
@@ -38,6 +38,12 @@
 #include <QFrame>
 #include <QTimer>
 
+#include <vector>
+#include <string>
+#include <numeric>
+#include <thread>
+#include <atomic>
+
 #include "string/string.h"
 #include "scenelib.h"
 #include "nameable.h"
@@ -248,27 +254,160 @@ void searchEntrySetModeIcon( QAction *action, bool search_from_start ){
 }
 
 /* search */
-void tree_view_filter( const char *string, bool from_start ){
-	const auto traverse = [=]( const auto& self, QAbstractItemModel* model, QTreeView *tree, QModelIndex parent = QModelIndex() ) -> bool {
-		if ( !parent.isValid() )
-			parent = model->index( 0, 0, QModelIndex() );
-
-		const int numRows = model->rowCount( parent );
+/// \brief Flat index of the entity tree for filtering, rebuilt only after the model changes.
+///
+/// - Names are lower-cased once, so matching is a plain substring search.
+/// - When the query extends the previous one, only the previous matches are searched again.
+/// - Only rows whose visibility changes are passed to setRowHidden().
+class EntityListFilter
+{
+	struct Entry
+	{
+		QModelIndex m_index; ///< valid until the model changes, which invalidates the filter
+		std::string m_name;
+		int m_parent;
+		bool m_hidden;
+	};
+	std::vector<Entry> m_entries;
+	bool m_valid = false;
+
+	std::string m_query;
+	bool m_fromStart = false;
+	std::vector<int> m_matches; ///< entries matching m_query, in tree order
+
+	std::vector<QMetaObject::Connection> m_connections;
+
+	enum { c_minParallelEntries = 16384, c_chunkSize = 1024 };
+
+	void build( QAbstractItemModel* model, QTreeView* tree ){
+		m_entries.clear();
+		const auto traverse = [&]( const auto& self, const QModelIndex& index, int parent ) -> void {
+			const int entry = static_cast<int>( m_entries.size() );
+			std::string name = index.data( Qt::ItemDataRole::DisplayRole ).toString().toLatin1().constData();
+			string_to_lowercase( name.data() );
+			m_entries.push_back( Entry{ index, std::move( name ), parent, tree->isRowHidden( index.row(), index.parent() ) } );
+
+			const int numRows = model->rowCount( index );
+			for ( int i = 0; i < numRows; ++i )
+				self( self, model->index( i, 0, index ), entry );
+		};
+		const QModelIndex root = model->index( 0, 0, QModelIndex() );
+		if ( root.isValid() )
+			traverse( traverse, root, -1 );
+
+		m_query.clear();
+		m_matches.resize( m_entries.size() );
+		std::iota( m_matches.begin(), m_matches.end(), 0 );
+		m_valid = true;
+	}
 
-		bool childVisible = false;
+	bool matches( const Entry& entry, const std::string& query, bool fromStart ) const {
+		return fromStart
+		       ? entry.m_name.compare( 0, query.size(), query ) == 0
+		       : entry.m_name.find( query ) != std::string::npos;
+	}
+	/// \brief Narrows \p candidates to the entries matching \p query, searching large sets on worker threads.
+	std::vector<int> match( const std::vector<int>& candidates, const std::string& query, bool fromStart ) const {
+		const std::size_t chunks = ( candidates.size() + c_chunkSize - 1 ) / c_chunkSize;
+		std::vector<std::vector<int>> results( chunks );
+		const auto work = [&]( std::size_t chunk ){
+			const std::size_t last = std::min( ( chunk + 1 ) * c_chunkSize, candidates.size() );
+			for ( std::size_t i = chunk * c_chunkSize; i != last; ++i )
+				if ( matches( m_entries[candidates[i]], query, fromStart ) )
+					results[chunk].push_back( candidates[i] );
+		};
+
+		const std::size_t threads = std::min<std::size_t>( std::thread::hardware_concurrency(), chunks );
+		if ( candidates.size() < c_minParallelEntries || threads < 2 ) {
+			for ( std::size_t chunk = 0; chunk != chunks; ++chunk )
+				work( chunk );
+		}
+		else{
+			std::atomic<std::size_t> next( 0 );
+			const auto worker = [&](){
+				for ( std::size_t chunk; ( chunk = next.fetch_add( 1 ) ) < chunks; )
+					work( chunk );
+			};
+			std::vector<std::thread> workers;
+			workers.reserve( threads - 1 );
+			for ( std::size_t i = 1; i < threads; ++i )
+				workers.emplace_back( worker );
+			worker();
+			for ( std::thread& thread : workers )
+				thread.join();
+		}
 
-		for ( int i = 0; i < numRows; ++i )
-			childVisible |= self( self, model, tree, model->index( i, 0, parent ) );
+		std::vector<int> result;
+		for ( const std::vector<int>& chunk : results )
+			result.insert( result.end(), chunk.begin(), chunk.end() );
+		return result;
+	}
 
-		const bool visible = childVisible || string_empty( string )
-			|| ( from_start && string_equal_prefix_nocase( parent.data( Qt::ItemDataRole::DisplayRole ).toString().toLatin1().constData(), string ) )
-			|| ( !from_start && string_in_string_nocase( parent.data( Qt::ItemDataRole::DisplayRole ).toString().toLatin1().constData(), string ) );
-		tree->setRowHidden( parent.row(), parent.parent(), !visible );
+public:
+	void invalidate(){
+		m_valid = false;
+		m_entries.clear();
+		m_matches.clear();
+	}
+	void attach( QAbstractItemModel* model ){
+		invalidate();
+		const auto changed = [this](){ invalidate(); };
+		m_connections.push_back( QObject::connect( model, &QAbstractItemModel::rowsInserted, changed ) );
+		m_connections.push_back( QObject::connect( model, &QAbstractItemModel::rowsRemoved, changed ) );
+		m_connections.push_back( QObject::connect( model, &QAbstractItemModel::rowsMoved, changed ) );
+		m_connections.push_back( QObject::connect( model, &QAbstractItemModel::modelReset, changed ) );
+		m_connections.push_back( QObject::connect( model, &QAbstractItemModel::dataChanged,
+			[this]( const QModelIndex&, const QModelIndex&, const QVector<int>& roles ){
+				if ( roles.isEmpty() || roles.contains( Qt::ItemDataRole::DisplayRole ) )
+					invalidate();
+			} ) );
+	}
+	void detach(){
+		for ( const QMetaObject::Connection& connection : m_connections )
+			QObject::disconnect( connection );
+		m_connections.clear();
+		invalidate();
+	}
+	void filter( QAbstractItemModel* model, QTreeView* tree, const char* string, bool fromStart ){
+		if ( !m_valid )
+			build( model, tree );
+
+		std::string query( string );
+		string_to_lowercase( query.data() );
+
+		// a longer query only ever matches a subset of what the previous one matched
+		const bool narrows = fromStart == m_fromStart
+		                     && ( fromStart ? query.compare( 0, m_query.size(), m_query ) == 0 : query.find( m_query ) != std::string::npos );
+		if ( !narrows ) {
+			m_matches.resize( m_entries.size() );
+			std::iota( m_matches.begin(), m_matches.end(), 0 );
+		}
+		if ( !query.empty() )
+			m_matches = match( m_matches, query, fromStart );
+		m_query = std::move( query );
+		m_fromStart = fromStart;
+
+		// rows stay visible while they or any of their children match
+		std::vector<bool> visible( m_entries.size(), false );
+		for ( int entry : m_matches )
+			for ( ; entry != -1 && !visible[entry]; entry = m_entries[entry].m_parent )
+				visible[entry] = true;
+
+		for ( std::size_t i = 0; i != m_entries.size(); ++i )
+		{
+			Entry& entry = m_entries[i];
+			if ( entry.m_hidden == visible[i] ) {
+				entry.m_hidden = !visible[i];
+				tree->setRowHidden( entry.m_index.row(), entry.m_index.parent(), entry.m_hidden );
+			}
+		}
+	}
+};
 
-		return childVisible || visible;
-	};
+EntityListFilter g_entityListFilter;
 
-	traverse( traverse, getEntityList().m_tree_model, getEntityList().m_tree_view );
+void tree_view_filter( const char *string, bool from_start ){
+	g_entityListFilter.filter( getEntityList().m_tree_model, getEntityList().m_tree_view, string, from_start );
 }
 
 
@@ -276,6 +415,8 @@ void AttachEntityTreeModel(){
 	getEntityList().m_tree_model = (QAbstractItemModel*)scene_graph_get_tree_model();
 	getEntityList().m_tree_view->setModel( getEntityList().m_tree_model );
 
+	g_entityListFilter.attach( getEntityList().m_tree_model );
+
 	QObject::connect( getEntityList().m_tree_view->selectionModel(), &QItemSelectionModel::selectionChanged,
 		[]( const QItemSelection &selected, const QItemSelection &deselected ){
 			for( const auto& index : deselected.indexes() ){
@@ -294,6 +435,7 @@ void AttachEntityTreeModel(){
 }
 
 void DetachEntityTreeModel(){
+	g_entityListFilter.detach();
 	getEntityList().m_tree_model = 0;
 	getEntityList().m_tree_view->setModel( nullptr );
 }
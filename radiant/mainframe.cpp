@@ -899,6 +899,7 @@ void create_file_menu( QMenuBar *menubar ){
 //	menu->addSeparator();
 	create_menu_item_with_mnemonic( menu, "&Pointfile", "TogglePointfile" );
 	create_menu_item_with_mnemonic( menu, "&Light Probes", "ToggleLightProbes" );
+	create_menu_item_with_mnemonic( menu, "Light Probe &Colours", "CycleLightProbeColour" );
 	menu->addSeparator();
 	MRU_constructMenu( menu );
 	menu->addSeparator();
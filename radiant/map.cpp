@@ -347,7 +347,7 @@ bool Map_Unnamed( const Map& map ){
 	return string_equal( Map_Name( map ), "unnamed.map" );
 }
 
-inline const MapFormat& MapFormat_forFile( const char* filename ){
+const MapFormat& MapFormat_forFile( const char* filename ){
 	const char* moduleName = findModuleName( GetFileTypeRegistry(), MapFormat::Name, path_get_extension( filename ) );
 	MapFormat* format = Radiant_getMapModules().findModule( moduleName );
 	ASSERT_MESSAGE( format != 0, "map format not found for file " << makeQuoted( filename ) );
@@ -1595,6 +1595,20 @@ bool Map_SaveFile( const char* filename ){
 	return MapResource_saveFile( MapFormat_forFile( filename ), GlobalSceneGraph().root(), Map_Traverse, filename );
 }
 
+/// \brief Returns a copy of the whole map which is not part of the scene graph.
+/// The copy may be serialised by another thread while the map is edited, but must be released on the main thread.
+scene::Node& Map_Clone(){
+	scene::Node& clone = ( new MapRoot( "" ) )->node();
+	Node_getTraversable( GlobalSceneGraph().root() )->traverse( CloneAll( clone ) );
+	return clone;
+}
+
+/// \brief Serialises \p root, a copy returned by Map_Clone(), into \p outputStream.
+/// Uses no scene graph state, so it may run on another thread.
+void Map_Serialise( scene::Node& root, const MapFormat& format, TextOutputStream& outputStream ){
+	format.writeGraph( root, Map_Traverse, outputStream );
+}
+
 //
 //===========
 //Map_SaveSelected
@@ -102,6 +102,11 @@ const float g_MinWorldCoord = -64 * 1024;
 
 void Map_LoadFile( const char* filename );
 bool Map_SaveFile( const char* filename );
+class TextOutputStream;
+class MapFormat;
+const MapFormat& MapFormat_forFile( const char* filename );
+scene::Node& Map_Clone();
+void Map_Serialise( scene::Node& root, const MapFormat& format, TextOutputStream& outputStream );
 
 void Map_New();
 void Map_Free();
@@ -51,6 +51,7 @@ std::size_t MAX_PATCH_WIDTH = 0;
 std::size_t MAX_PATCH_HEIGHT = 0;
 
 int g_PatchSubdivideThreshold = 4;
+bool g_PatchLod = true;
 
 void BezierCurveTree_Delete( BezierCurveTree *pCurve ){
 	if ( pCurve ) {
@@ -213,10 +214,11 @@ bool Patch::isValid() const {
 }
 
 void Patch::UpdateCachedData(){
-	m_ctrl_vertices.clear();
-	m_lattice_indices.clear();
-
 	if ( !isValid() ) {
+		m_ctrl_vertices.clear();
+		m_lattice_indices.clear();
+		m_ctrlCached.resize( 0 );
+		m_cachedWidth = 0;
 		m_tess.m_numStrips = 0;
 		m_tess.m_lenStrips = 0;
 		m_tess.m_nArrayHeight = 0;
@@ -227,16 +229,32 @@ void Patch::UpdateCachedData(){
 		m_tess.m_vertices.resize( 0 );
 		m_tess.m_arrayHeight.resize( 0 );
 		m_tess.m_arrayWidth.resize( 0 );
+		m_tess.m_levels.clear();
 		m_aabb_local = AABB();
 		return;
 	}
 
+	// a single edit reaches here from both transform() and controlPointsChanged(), only rebuild if the control points differ from the cached ones
+	if ( m_cachedWidth == m_width
+	  && m_ctrlCached.size() == m_ctrlTransformed.size()
+	  && std::equal( m_ctrlTransformed.begin(), m_ctrlTransformed.end(), m_ctrlCached.begin(), ctrl_equal ) ) {
+		AccumulateBBox();
+		if( !m_transformChanged ) //experimental! fixing extra sceneChangeNotify call during scene rendering
+			SceneChangeNotify();
+		return;
+	}
+
 	//BuildTesselationCurves( ROW );
 	//BuildTesselationCurves( COL );
 	
 	BuildVertexArray();
 	AccumulateBBox();
-	
+
+	m_ctrlCached = m_ctrlTransformed;
+	m_cachedWidth = m_width;
+
+	m_ctrl_vertices.clear();
+	m_lattice_indices.clear();
 
 	IndexBuffer ctrl_indices;
 
@@ -2575,7 +2593,62 @@ void Patch::accumulateVertexTangentSpace( std::size_t index, Vector3 tangentX[6]
 
 const std::size_t PATCH_MAX_VERTEX_ARRAY = 1048576;
 
+/// \brief Appends to \p samples every \p step-th index below \p count, always ending with count - 1.
+inline void PatchLod_samples( std::vector<std::size_t>& samples, std::size_t count, std::size_t step ){
+	samples.clear();
+	for ( std::size_t i = 0; i < count - 1; i += step )
+	{
+		samples.push_back( i );
+	}
+	samples.push_back( count - 1 );
+}
+
+const std::size_t PATCH_MAX_LOD_LEVELS = 4;
+
+void PatchTesselation_buildLevels( PatchTesselation& tess, std::size_t width, std::size_t height ){
+	tess.m_levels.clear();
+
+	std::vector<std::size_t> columns, rows;
+	std::size_t prevColumns = width, prevRows = height;
+	for ( std::size_t step = 2; tess.m_levels.size() != PATCH_MAX_LOD_LEVELS; step <<= 1 )
+	{
+		PatchLod_samples( columns, width, step );
+		PatchLod_samples( rows, height, step );
+		if ( columns.size() == prevColumns && rows.size() == prevRows ) {
+			break;
+		}
+		prevColumns = columns.size();
+		prevRows = rows.size();
+
+		tess.m_levels.emplace_back();
+		PatchTesselation::Level& level = tess.m_levels.back();
+		level.m_numStrips = rows.size() - 1;
+		level.m_lenStrips = columns.size() * 2;
+		level.m_indices.resize( level.m_numStrips * level.m_lenStrips );
+
+		Array<RenderIndex>::iterator index = level.m_indices.begin();
+		for ( std::size_t y = 0; y < level.m_numStrips; y++ )
+		{
+			for ( std::size_t x : columns )
+			{
+				*index++ = RenderIndex( x + rows[y] * width );
+				*index++ = RenderIndex( x + rows[y + 1] * width );
+			}
+		}
+	}
+}
+
 void Patch::BuildVertexArray(){
+	if ( m_tess.m_nArrayWidth == m_width && m_tess.m_nArrayHeight == m_height && m_ctrlCached.size() == m_ctrlTransformed.size() ) {
+		// same grid, the strips still apply and only moved control points need their vertices updated
+		for( std::size_t i = 0; i < m_ctrlTransformed.size(); i++ ) {
+			if ( !ctrl_equal( m_ctrlTransformed[i], m_ctrlCached[i] ) ) {
+				vertex_assign_ctrl( m_tess.m_vertices[i], m_ctrlTransformed[i] );
+			}
+		}
+		return;
+	}
+
 	m_tess.m_vertices.resize(m_ctrlTransformed.size());
 	m_tess.m_indices.resize(m_width*(m_height-1)*2);
 
@@ -2600,6 +2673,31 @@ void Patch::BuildVertexArray(){
 
 	m_tess.m_nArrayWidth = m_width;
 	m_tess.m_nArrayHeight = m_height;
+
+	PatchTesselation_buildLevels( m_tess, m_width, m_height );
+}
+
+// coarsest angle a grid cell may subtend from the viewer before a finer level is drawn
+const float PATCH_LOD_ANGLE = 0.004f;
+
+std::size_t Patch::lodLevel( const VolumeTest& volume, const Matrix4& localToWorld ) const {
+	if ( !g_PatchLod || !volume.fill() || m_tess.m_levels.empty() ) {
+		return 0;
+	}
+	const float radius = static_cast<float>( vector3_length( m_aabb_local.extents ) );
+	const float distance = static_cast<float>( vector3_length( matrix4_transformed_point( localToWorld, m_aabb_local.origin ) - volume.getViewer() ) ) - radius;
+	if ( distance <= 0 ) {
+		return 0;
+	}
+	// each level doubles the size of a cell of the full grid
+	float cell = 2 * radius / static_cast<float>( std::max( m_width, m_height ) - 1 );
+	std::size_t level = 0;
+	while ( level != m_tess.m_levels.size() && cell * 2 < distance * PATCH_LOD_ANGLE )
+	{
+		cell *= 2;
+		++level;
+	}
+	return level;
 }
 
 
@@ -42,6 +42,7 @@
 #include "debugging/debugging.h"
 
 #include <set>
+#include <vector>
 #include <limits>
 
 #include "math/frustum.h"
@@ -72,6 +73,7 @@ enum EPatchType
 };
 
 extern int g_PatchSubdivideThreshold;
+extern bool g_PatchLod;
 
 
 #define MIN_PATCH_WIDTH 2
@@ -143,6 +145,10 @@ inline VertexPointer vertexpointer_arbitrarymeshvertex( const ArbitraryMeshVerte
 typedef PatchControl* PatchControlIter;
 typedef const PatchControl* PatchControlConstIter;
 
+inline bool ctrl_equal( const PatchControl& self, const PatchControl& other ){
+	return self.m_vertex == other.m_vertex && self.m_texcoord == other.m_texcoord;
+}
+
 inline void copy_ctrl( PatchControlIter ctrl, PatchControlConstIter begin, PatchControlConstIter end ){
 	std::copy( begin, end, ctrl );
 }
@@ -195,6 +201,16 @@ public:
 	std::size_t m_numStrips;
 	std::size_t m_lenStrips;
 
+/// \brief A coarser set of strips over m_vertices; level N keeps every 2^N-th row and column plus the last ones.
+	class Level
+	{
+	public:
+		Array<RenderIndex> m_indices;
+		std::size_t m_numStrips;
+		std::size_t m_lenStrips;
+	};
+	std::vector<Level> m_levels;
+
 	Array<std::size_t> m_arrayWidth;
 	std::size_t m_nArrayWidth;
 	Array<std::size_t> m_arrayHeight;
@@ -240,7 +256,10 @@ class RenderablePatchSolid : public OpenGLRenderable
 {
 	PatchTesselation& m_tess;
 public:
-	RenderablePatchSolid( PatchTesselation& tess ) : m_tess( tess ){
+	/// \brief Detail level to draw, 0 is the full grid and N selects m_tess.m_levels[N - 1].
+	mutable std::size_t m_level;
+
+	RenderablePatchSolid( PatchTesselation& tess ) : m_tess( tess ), m_level( 0 ){
 	}
 	void RenderNormals() const;
 	void render( RenderStateFlags state ) const {
@@ -263,10 +282,13 @@ public:
 				gl().glTexCoordPointer( 2, GL_FLOAT, sizeof( ArbitraryMeshVertex ), &m_tess.m_vertices.data()->texcoord );
 			}
 			gl().glVertexPointer( 3, GL_FLOAT, sizeof( ArbitraryMeshVertex ), &m_tess.m_vertices.data()->vertex );
-			const RenderIndex* strip_indices = m_tess.m_indices.data();
-			for ( std::size_t i = 0; i < m_tess.m_numStrips; i++, strip_indices += m_tess.m_lenStrips )
+			const std::size_t level = std::min( m_level, m_tess.m_levels.size() );
+			const RenderIndex* strip_indices = level == 0 ? m_tess.m_indices.data() : m_tess.m_levels[level - 1].m_indices.data();
+			const std::size_t numStrips = level == 0 ? m_tess.m_numStrips : m_tess.m_levels[level - 1].m_numStrips;
+			const std::size_t lenStrips = level == 0 ? m_tess.m_lenStrips : m_tess.m_levels[level - 1].m_lenStrips;
+			for ( std::size_t i = 0; i < numStrips; i++, strip_indices += lenStrips )
 			{
-				gl().glDrawElements( GL_QUAD_STRIP, GLsizei( m_tess.m_lenStrips ), RenderIndexTypeID, strip_indices );
+				gl().glDrawElements( GL_QUAD_STRIP, GLsizei( lenStrips ), RenderIndexTypeID, strip_indices );
 			}
 		}
 
@@ -319,7 +341,18 @@ class Patch :
 
 	typedef Array<PatchControl> PatchControlArray;
 
-	class SavedState : public UndoMemento
+/// \brief Base of the patch undo mementos; each restores some part of the patch state.
+	class PatchUndoMemento : public UndoMemento
+	{
+	public:
+		virtual void exportState( Patch& patch ) const = 0;
+
+		void release(){
+			delete this;
+		}
+	};
+
+	class SavedState : public PatchUndoMemento
 	{
 	public:
 		SavedState(
@@ -340,8 +373,19 @@ class Patch :
 			m_subdivisions_y( subdivisions_y ){
 		}
 
-		void release(){
-			delete this;
+		void exportState( Patch& patch ) const {
+			patch.m_width = m_width;
+			patch.m_height = m_height;
+			patch.SetShader( m_shader.c_str() );
+			patch.m_ctrl = m_ctrl;
+			patch.onAllocate( patch.m_ctrl.size() );
+			patch.m_patchDef3 = m_patchDef3;
+			patch.m_subdivisions_x = m_subdivisions_x;
+			patch.m_subdivisions_y = m_subdivisions_y;
+		}
+
+		std::size_t size() const {
+			return sizeof( *this ) + m_ctrl.size() * sizeof( PatchControl ) + string_length( m_shader.c_str() ) + 1;
 		}
 
 		std::size_t m_width, m_height;
@@ -352,6 +396,25 @@ class Patch :
 		std::size_t m_subdivisions_y;
 	};
 
+/// \brief Delta memento for commands that kept the patch dimensions and shader, storing only the modified control points.
+	class ControlsSavedState : public PatchUndoMemento
+	{
+	public:
+		typedef std::pair<std::size_t, PatchControl> IndexedControl;
+		std::vector<IndexedControl> m_ctrl;
+
+		void exportState( Patch& patch ) const {
+			for ( std::vector<IndexedControl>::const_iterator i = m_ctrl.begin(); i != m_ctrl.end(); ++i )
+			{
+				patch.m_ctrl[( *i ).first] = ( *i ).second;
+			}
+		}
+
+		std::size_t size() const {
+			return sizeof( *this ) + m_ctrl.capacity() * sizeof( IndexedControl );
+		}
+	};
+
 public:
 	class Observer
 	{
@@ -384,6 +447,8 @@ private:
 // dynamically allocated array of control points, size is m_width*m_height
 	PatchControlArray m_ctrl;
 	PatchControlArray m_ctrlTransformed;
+	/// \brief m_ctrlTransformed as of the last UpdateCachedData, cached data is only rebuilt for changed control points.
+	PatchControlArray m_ctrlCached;
 
 	PatchTesselation m_tess;
 	RenderablePatchSolid m_render_solid;
@@ -399,6 +464,7 @@ private:
 
 	bool m_bOverlay;
 
+	std::size_t m_cachedWidth;
 	bool m_transformChanged;
 	Callback m_evaluateTransform;
 	Callback m_boundsChanged;
@@ -435,6 +501,7 @@ public:
 		m_render_wireframe_fixed( m_tess ),
 		m_render_ctrl( GL_POINTS, m_ctrl_vertices ),
 		m_render_lattice( GL_LINES, m_lattice_indices, m_ctrl_vertices ),
+		m_cachedWidth( 0 ),
 		m_transformChanged( false ),
 		m_evaluateTransform( evaluateTransform ),
 		m_boundsChanged( boundsChanged ){
@@ -451,6 +518,7 @@ public:
 		m_render_wireframe_fixed( m_tess ),
 		m_render_ctrl( GL_POINTS, m_ctrl_vertices ),
 		m_render_lattice( GL_LINES, m_lattice_indices, m_ctrl_vertices ),
+		m_cachedWidth( 0 ),
 		m_transformChanged( false ),
 		m_evaluateTransform( evaluateTransform ),
 		m_boundsChanged( boundsChanged ){
@@ -483,6 +551,7 @@ public:
 		m_render_wireframe_fixed( m_tess ),
 		m_render_ctrl( GL_POINTS, m_ctrl_vertices ),
 		m_render_lattice( GL_LINES, m_lattice_indices, m_ctrl_vertices ),
+		m_cachedWidth( 0 ),
 		m_transformChanged( false ),
 		m_evaluateTransform( other.m_evaluateTransform ),
 		m_boundsChanged( other.m_boundsChanged ){
@@ -577,6 +646,7 @@ public:
 	}
 	void render_solid( Renderer& renderer, const VolumeTest& volume, const Matrix4& localToWorld ) const {
 		renderer.SetState( m_state, Renderer::eFullMaterials );
+		m_render_solid.m_level = lodLevel( volume, localToWorld );
 		renderer.addRenderable( m_render_solid, localToWorld );
 	}
 	void render_wireframe( Renderer& renderer, const VolumeTest& volume, const Matrix4& localToWorld ) const {
@@ -783,6 +853,7 @@ public:
 	}
 
 	void UpdateCachedData();
+	std::size_t lodLevel( const VolumeTest& volume, const Matrix4& localToWorld ) const;
 
 	const char *GetShader() const {
 		return m_shader.c_str();
@@ -899,26 +970,41 @@ public:
 	UndoMemento* exportState() const {
 		return new SavedState( m_width, m_height, m_ctrl, m_shader.c_str(), m_patchDef3, m_subdivisions_x, m_subdivisions_y );
 	}
-	void importState( const UndoMemento* state ){
-		undoSave();
-
+	UndoMemento* diffState( UndoMemento* state ) const {
 		const SavedState& other = *( static_cast<const SavedState*>( state ) );
+		if ( other.m_width != m_width
+		  || other.m_height != m_height
+		  || other.m_patchDef3 != m_patchDef3
+		  || other.m_subdivisions_x != m_subdivisions_x
+		  || other.m_subdivisions_y != m_subdivisions_y
+		  || !string_equal( other.m_shader.c_str(), m_shader.c_str() ) ) {
+			return state;
+		}
 
-		// begin duplicate of SavedState copy constructor, needs refactoring
-
-		// copy construct
+		ControlsSavedState* delta = new ControlsSavedState;
+		for ( std::size_t i = 0; i < m_ctrl.size(); ++i )
 		{
-			m_width = other.m_width;
-			m_height = other.m_height;
-			SetShader( other.m_shader.c_str() );
-			m_ctrl = other.m_ctrl;
-			onAllocate( m_ctrl.size() );
-			m_patchDef3 = other.m_patchDef3;
-			m_subdivisions_x = other.m_subdivisions_x;
-			m_subdivisions_y = other.m_subdivisions_y;
+			if ( other.m_ctrl[i].m_vertex != m_ctrl[i].m_vertex || other.m_ctrl[i].m_texcoord != m_ctrl[i].m_texcoord ) {
+				delta->m_ctrl.push_back( ControlsSavedState::IndexedControl( i, other.m_ctrl[i] ) );
+			}
+		}
+
+		if ( delta->m_ctrl.empty() ) {
+			delta->release();
+			state->release();
+			return 0;
 		}
+		if ( delta->size() >= other.size() ) {
+			delta->release();
+			return state;
+		}
+		state->release();
+		return delta;
+	}
+	void importState( const UndoMemento* state ){
+		undoSave();
 
-		// end duplicate code
+		static_cast<const PatchUndoMemento*>( state )->exportState( *this );
 
 		Patch_textureChanged();
 
@@ -1645,6 +1731,9 @@ public:
 	typedef MemberCaller<PatchInstance, &PatchInstance::applyTransform> ApplyTransformCaller;
 
 
+	const AABB& cullableAABB() const {
+		return worldAABB();
+	}
 	bool testLight( const RendererLight& light ) const {
 		return light.testAABB( worldAABB() );
 	}
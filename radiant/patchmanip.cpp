@@ -662,6 +662,7 @@ void PatchFilters_construct(){
 
 void Patch_constructPreferences( PreferencesPage& page ){
 	page.appendSpinner( "Patch Subdivide Threshold", g_PatchSubdivideThreshold, 0, 128 );
+	page.appendCheckBox( "", "Coarser grids for distant patches in camera", g_PatchLod );
 }
 void Patch_constructPage( PreferenceGroup& group ){
 	PreferencesPage page( group.createPage( "Patches", "Patch Display Preferences" ) );
@@ -676,6 +677,7 @@ void Patch_registerPreferencesPage(){
 
 void PatchPreferences_construct(){
 	GlobalPreferenceSystem().registerPreference( "Subdivisions", IntImportStringCaller( g_PatchSubdivideThreshold ), IntExportStringCaller( g_PatchSubdivideThreshold ) );
+	GlobalPreferenceSystem().registerPreference( "PatchLod", BoolImportStringCaller( g_PatchLod ), BoolExportStringCaller( g_PatchLod ) );
 }
 
 
@@ -29,15 +29,29 @@
 
 #include "probes.h"
 
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <tuple>
+
 #include "debugging/debugging.h"
 
 #include "irender.h"
 #include "igl.h"
 #include "renderable.h"
+#include "render.h"
+#include "cullable.h"
+#include "math/aabb.h"
+
+#include "probefile.h"
 
 #include "stream/stringstream.h"
 #include "os/path.h"
 #include "os/file.h"
+#include "os/mappedfile.h"
 #include "commandlib.h"
 
 #include "map.h"
@@ -47,110 +61,205 @@
 #include "mainframe.h"
 #include "commands.h"
 
-// Maximum number of probes to visualize
-#define MAX_PROBES 16384
+// Probes are grouped into chunks of nearby probes, each culled against the view as a whole
+#define PROBE_CHUNK_CELL 1024.0f
+#define PROBE_CHUNK_MAX 4096
+
+// Cross arms drawn around each probe point
+#define PROBE_CROSS_SIZE 24.0f
 
 // Probe data structure
 struct LightProbeVis {
     Vector3 position;
     Vector3 color;  // RGB ambient color from probe
+    float sh[3][4]; // ambient SH [channel][coefficient], normalised to [-1, 1]
+};
+
+// What the probe colour shows
+enum EProbeColour {
+    eProbeColourAmbient,
+    eProbeColourSH0,
+    eProbeColourSH1,
+    eProbeColourSH2,
+    eProbeColourSH3,
+    eProbeColourCount
 };
 
 class CProbeFile : public Renderable, public OpenGLRenderable
 {
-    LightProbeVis m_probes[MAX_PROBES];
-    std::size_t m_num_probes;
-    int m_displaylist;
+    struct Chunk {
+        AABB bounds;
+        std::size_t first;
+        std::size_t count;
+    };
+
+    std::vector<LightProbeVis> m_probes;
+    std::vector<Chunk> m_chunks;
+    bool m_hasSH;
+    bool m_shown;
+    int m_colour;
+
+    // vertex buffer holding one point per probe followed by six cross vertices per probe
+    mutable GLuint m_buffer;
+    mutable bool m_upload;
+    // ranges of probes in view, gathered while culling and drawn in render()
+    mutable std::vector<std::pair<std::size_t, std::size_t>> m_visible;
+
     static Shader* m_renderstate;
     
+    Colour4b probeColour(const LightProbeVis& probe) const {
+        Vector3 colour;
+        if (m_colour == eProbeColourAmbient || !m_hasSH) {
+            // Use probe's ambient color, brightened for visibility
+            colour = probe.color * 2.0f + Vector3(0.2f, 0.2f, 0.2f);
+        }
+        else {
+            const int coefficient = m_colour - eProbeColourSH0;
+            colour = Vector3(probe.sh[0][coefficient], probe.sh[1][coefficient], probe.sh[2][coefficient]) + Vector3(0.5f, 0.5f, 0.5f);
+        }
+        return Colour4b(static_cast<unsigned char>(std::clamp(colour[0], 0.0f, 1.0f) * 255.0f),
+                        static_cast<unsigned char>(std::clamp(colour[1], 0.0f, 1.0f) * 255.0f),
+                        static_cast<unsigned char>(std::clamp(colour[2], 0.0f, 1.0f) * 255.0f),
+                        255);
+    }
+    
+    void upload() const {
+        const std::size_t count = m_probes.size();
+        std::vector<PointVertex> vertices(count * 7);
+        for (std::size_t i = 0; i < count; i++) {
+            const Colour4b colour = probeColour(m_probes[i]);
+            const Vector3& p = m_probes[i].position;
+            vertices[i] = PointVertex(vertex3f_for_vector3(p), colour);
+            
+            PointVertex* cross = &vertices[count + i * 6];
+            for (std::size_t axis = 0; axis < 3; axis++) {
+                Vector3 offset(0, 0, 0);
+                offset[axis] = PROBE_CROSS_SIZE;
+                cross[axis * 2] = PointVertex(vertex3f_for_vector3(p - offset), colour);
+                cross[axis * 2 + 1] = PointVertex(vertex3f_for_vector3(p + offset), colour);
+            }
+        }
+        
+        if (m_buffer == 0) {
+            gl().glGenBuffers(1, &m_buffer);
+        }
+        gl().glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+        gl().glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(PointVertex), vertices.data(), GL_STATIC_DRAW);
+        m_upload = false;
+    }
+    
 public:
-    CProbeFile() : m_num_probes(0), m_displaylist(0) {
+    CProbeFile() : m_hasSH(false), m_shown(false), m_colour(eProbeColourAmbient), m_buffer(0), m_upload(false) {
     }
     
     ~CProbeFile() {
     }
     
     void Init() {
-        m_num_probes = 0;
-        m_displaylist = 0;
+        m_probes.clear();
+        m_chunks.clear();
+        m_hasSH = true;
     }
     
-    void PushProbe(const Vector3& pos, const Vector3& color) {
-        if (m_num_probes < MAX_PROBES) {
-            m_probes[m_num_probes].position = pos;
-            m_probes[m_num_probes].color = color;
-            ++m_num_probes;
-        }
+    void PushProbe(const LightProbeVis& probe, bool hasSH) {
+        m_probes.push_back(probe);
+        m_hasSH &= hasSH;
     }
     
-    void GenerateDisplayList() {
-        if (m_num_probes == 0) return;
+    // Sort probes by spatial cell and split them into chunks for culling
+    void BuildChunks() {
+        const auto cell = [](const Vector3& position) {
+            return BasicVector3<int>(static_cast<int>(std::floor(position[0] / PROBE_CHUNK_CELL)),
+                                     static_cast<int>(std::floor(position[1] / PROBE_CHUNK_CELL)),
+                                     static_cast<int>(std::floor(position[2] / PROBE_CHUNK_CELL)));
+        };
+        const auto less = [](const BasicVector3<int>& a, const BasicVector3<int>& b) {
+            return std::make_tuple(a.x(), a.y(), a.z()) < std::make_tuple(b.x(), b.y(), b.z());
+        };
+        std::stable_sort(m_probes.begin(), m_probes.end(), [&](const LightProbeVis& a, const LightProbeVis& b) {
+            return less(cell(a.position), cell(b.position));
+        });
         
-        m_displaylist = gl().glGenLists(1);
-        gl().glNewList(m_displaylist, GL_COMPILE);
-        
-        // Draw probes as colored points with size
-        gl().glPointSize(8.0f);
-        gl().glBegin(GL_POINTS);
-        for (std::size_t i = 0; i < m_num_probes; i++) {
-            // Use probe's ambient color, brightened for visibility
-            float r = std::min(1.0f, m_probes[i].color[0] * 2.0f + 0.2f);
-            float g = std::min(1.0f, m_probes[i].color[1] * 2.0f + 0.2f);
-            float b = std::min(1.0f, m_probes[i].color[2] * 2.0f + 0.2f);
-            gl().glColor3f(r, g, b);
-            gl().glVertex3fv(vector3_to_array(m_probes[i].position));
+        m_chunks.clear();
+        for (std::size_t i = 0; i < m_probes.size(); i++) {
+            if (m_chunks.empty()
+             || m_chunks.back().count == PROBE_CHUNK_MAX
+             || cell(m_probes[i].position) != cell(m_probes[i - 1].position)) {
+                m_chunks.push_back(Chunk{AABB(), i, 0});
+            }
+            aabb_extend_by_point_safe(m_chunks.back().bounds, m_probes[i].position);
+            ++m_chunks.back().count;
         }
-        gl().glEnd();
-        
-        // Also draw small crosses at each probe for better visibility
-        gl().glLineWidth(2.0f);
-        gl().glBegin(GL_LINES);
-        const float crossSize = 24.0f;
-        for (std::size_t i = 0; i < m_num_probes; i++) {
-            float r = std::min(1.0f, m_probes[i].color[0] * 2.0f + 0.2f);
-            float g = std::min(1.0f, m_probes[i].color[1] * 2.0f + 0.2f);
-            float b = std::min(1.0f, m_probes[i].color[2] * 2.0f + 0.2f);
-            gl().glColor3f(r, g, b);
-            
-            const Vector3& p = m_probes[i].position;
-            // X axis
-            gl().glVertex3f(p[0] - crossSize, p[1], p[2]);
-            gl().glVertex3f(p[0] + crossSize, p[1], p[2]);
-            // Y axis
-            gl().glVertex3f(p[0], p[1] - crossSize, p[2]);
-            gl().glVertex3f(p[0], p[1] + crossSize, p[2]);
-            // Z axis
-            gl().glVertex3f(p[0], p[1], p[2] - crossSize);
-            gl().glVertex3f(p[0], p[1], p[2] + crossSize);
+        // crosses reach past the probe points
+        for (Chunk& chunk : m_chunks) {
+            chunk.bounds.extents += Vector3(PROBE_CROSS_SIZE, PROBE_CROSS_SIZE, PROBE_CROSS_SIZE);
         }
-        gl().glEnd();
-        gl().glLineWidth(1.0f);
-        gl().glPointSize(1.0f);
-        
-        gl().glEndList();
     }
     
     bool shown() const {
-        return m_displaylist != 0;
+        return m_shown;
     }
     
     std::size_t count() const {
-        return m_num_probes;
+        return m_probes.size();
+    }
+    
+    bool hasSH() const {
+        return m_hasSH;
+    }
+    
+    int colour() const {
+        return m_colour;
+    }
+    
+    void setColour(int colour) {
+        m_colour = colour;
+        m_upload = true;
+        if (shown()) {
+            SceneChangeNotify();
+        }
     }
     
     void show(bool show);
     
     void render(RenderStateFlags state) const {
-        if (m_displaylist != 0) {
-            gl().glCallList(m_displaylist);
+        if (m_probes.empty()) {
+            return;
         }
+        if (m_upload) {
+            upload();
+        }
+        else {
+            gl().glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+        }
+        
+        gl().glVertexPointer(3, GL_FLOAT, sizeof(PointVertex), reinterpret_cast<const GLvoid*>(offsetof(PointVertex, vertex)));
+        gl().glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(PointVertex), reinterpret_cast<const GLvoid*>(offsetof(PointVertex, colour)));
+        for (const auto& [first, count] : m_visible) {
+            gl().glDrawArrays(GL_POINTS, GLint(first), GLsizei(count));
+            gl().glDrawArrays(GL_LINES, GLint(m_probes.size() + first * 6), GLsizei(count * 6));
+        }
+        gl().glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
     
     void renderSolid(Renderer& renderer, const VolumeTest& volume) const {
         if (shown()) {
-            renderer.SetState(m_renderstate, Renderer::eWireframeOnly);
-            renderer.SetState(m_renderstate, Renderer::eFullMaterials);
-            renderer.addRenderable(*this, g_matrix4_identity);
+            m_visible.clear();
+            for (const Chunk& chunk : m_chunks) {
+                if (volume.TestAABB(chunk.bounds) != c_volumeOutside) {
+                    if (!m_visible.empty() && m_visible.back().first + m_visible.back().second == chunk.first) {
+                        m_visible.back().second += chunk.count;
+                    }
+                    else {
+                        m_visible.emplace_back(chunk.first, chunk.count);
+                    }
+                }
+            }
+            if (!m_visible.empty()) {
+                renderer.SetState(m_renderstate, Renderer::eWireframeOnly);
+                renderer.SetState(m_renderstate, Renderer::eFullMaterials);
+                renderer.addRenderable(*this, g_matrix4_identity);
+            }
         }
     }
     
@@ -159,12 +268,11 @@ public:
     }
     
     static void constructStatic() {
-        // Reuse the pointfile shader - it's already registered and works for our needs
-        m_renderstate = GlobalShaderCache().capture("$POINTFILE");
+        m_renderstate = GlobalShaderCache().capture("$PROBES");
     }
     
     static void destroyStatic() {
-        GlobalShaderCache().release("$POINTFILE");
+        GlobalShaderCache().release("$PROBES");
     }
 };
 
@@ -175,26 +283,57 @@ namespace {
 }
 
 
-static bool LoadProbeFile(CProbeFile& probefile) {
-    const char* mapname = Map_Name(g_map);
-    StringOutputStream filename(256);
+// Binary probe dump written by remap, see include/probefile.h
+static bool LoadProbeFileBinary(CProbeFile& probefile, const MappedFile& file, std::size_t& probeCount) {
+    ProbeFileHeader header;
+    if (file.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, PROBEFILE_MAGIC, sizeof(header.magic)) != 0) {
+        return false;
+    }
     
-    // Try to load .probes file
-    filename(PathExtensionless(mapname), ".probes");
+    const std::size_t available = (file.size() - sizeof(header)) / std::max<std::size_t>(header.probeSize, 1);
+    if (header.version < PROBEFILE_VERSION || header.probeSize < sizeof(ProbeFileProbe) || header.probeCount > available) {
+        globalErrorStream() << "Unsupported or truncated binary probe file, version " << header.version << '\n';
+        probeCount = 0;
+        return true;
+    }
     
-    FILE* f = fopen(filename.c_str(), "r");
+    probefile.Init();
+    const char* record = static_cast<const char*>(file.data()) + sizeof(header);
+    for (std::size_t i = 0; i < header.probeCount; i++, record += header.probeSize) {
+        ProbeFileProbe stored;
+        memcpy(&stored, record, sizeof(stored));
+        
+        LightProbeVis probe;
+        probe.position = Vector3(stored.origin[0], stored.origin[1], stored.origin[2]);
+        for (int channel = 0; channel < 3; channel++) {
+            for (int coefficient = 0; coefficient < 4; coefficient++) {
+                probe.sh[channel][coefficient] = stored.ambientSH[channel][coefficient] / 32767.0f;
+            }
+            // The DC coefficient (index 0) represents average irradiance
+            probe.color[channel] = std::clamp(probe.sh[channel][0], 0.0f, 1.0f);
+        }
+        probefile.PushProbe(probe, true);
+    }
+    probeCount = header.probeCount;
+    return true;
+}
+
+// Text probe dump, one "X Y Z [R G B [12 SH coefficients]]" line per probe
+static std::size_t LoadProbeFileText(CProbeFile& probefile, const char* filename) {
+    FILE* f = fopen(filename, "r");
     if (!f) {
-        globalErrorStream() << "Probe file " << filename << " not found\n";
-        return false;
+        return 0;
     }
     
-    globalOutputStream() << "Loading probe file " << filename << '\n';
-    
     probefile.Init();
     
-    char line[256];
+    char line[512];
     int lineNum = 0;
-    int probeCount = 0;
+    std::size_t probeCount = 0;
     
     while (fgets(line, sizeof(line), f)) {
         lineNum++;
@@ -204,23 +343,60 @@ static bool LoadProbeFile(CProbeFile& probefile) {
             continue;
         }
         
-        float x, y, z, r = 0.5f, g = 0.5f, b = 0.5f;
-        
-        // Try to parse with color first
-        int parsed = sscanf(line, "%f %f %f %f %f %f", &x, &y, &z, &r, &g, &b);
+        float values[18];
+        int parsed = 0;
+        for (const char* p = line; parsed < 18; ) {
+            char* end;
+            const float value = strtof(p, &end);
+            if (end == p) {
+                break;
+            }
+            values[parsed++] = value;
+            p = end;
+        }
         if (parsed < 3) {
             globalWarningStream() << "Corrupt probe file, line " << lineNum << '\n';
             continue;
         }
         
-        probefile.PushProbe(Vector3(x, y, z), Vector3(r, g, b));
+        LightProbeVis probe;
+        probe.position = Vector3(values[0], values[1], values[2]);
+        probe.color = parsed >= 6 ? Vector3(values[3], values[4], values[5]) : Vector3(0.5f, 0.5f, 0.5f);
+        for (int i = 0; i < 12; i++) {
+            probe.sh[i / 4][i % 4] = parsed == 18 ? values[6 + i] : 0.0f;
+        }
+        probefile.PushProbe(probe, parsed == 18);
         probeCount++;
     }
     
     fclose(f);
+    return probeCount;
+}
+
+static bool LoadProbeFile(CProbeFile& probefile) {
+    const char* mapname = Map_Name(g_map);
+    StringOutputStream filename(256);
+    
+    // Try to load .probes file, binary from current compiles or text from older ones
+    filename(PathExtensionless(mapname), ".probes");
+    
+    std::size_t probeCount = 0;
+    {
+        const MappedFile file(filename.c_str());
+        if (!file.valid()) {
+            globalErrorStream() << "Probe file " << filename << " not found\n";
+            return false;
+        }
+        
+        globalOutputStream() << "Loading probe file " << filename << '\n';
+        
+        if (!LoadProbeFileBinary(probefile, file, probeCount)) {
+            probeCount = LoadProbeFileText(probefile, filename.c_str());
+        }
+    }
     
     if (probeCount > 0) {
-        probefile.GenerateDisplayList();
+        probefile.BuildChunks();
         globalOutputStream() << "Loaded " << probeCount << " light probes\n";
         return true;
     }
@@ -231,15 +407,21 @@ static bool LoadProbeFile(CProbeFile& probefile) {
 
 void CProbeFile::show(bool show) {
     if (show && !shown()) {
-        LoadProbeFile(*this);
-        if (m_num_probes > 0) {
-            GenerateDisplayList();
+        if (LoadProbeFile(*this)) {
+            m_shown = true;
+            m_upload = true;
             SceneChangeNotify();
         }
     }
     else if (!show && shown()) {
-        gl().glDeleteLists(m_displaylist, 1);
-        m_displaylist = 0;
+        if (m_buffer != 0) {
+            gl().glDeleteBuffers(1, &m_buffer);
+            m_buffer = 0;
+        }
+        m_probes.clear();
+        m_chunks.clear();
+        m_visible.clear();
+        m_shown = false;
         SceneChangeNotify();
     }
 }
@@ -261,6 +443,20 @@ void Probes_Toggle() {
     }
 }
 
+void Probes_CycleColour() {
+    const int colour = (s_probefile.colour() + 1) % eProbeColourCount;
+    s_probefile.setColour(colour);
+    if (colour == eProbeColourAmbient) {
+        globalOutputStream() << "Light probe colours: ambient\n";
+    }
+    else {
+        globalOutputStream() << "Light probe colours: SH coefficient " << (colour - eProbeColourSH0) << '\n';
+        if (s_probefile.shown() && !s_probefile.hasSH()) {
+            globalWarningStream() << "Probe file has no SH coefficients, showing ambient colours\n";
+        }
+    }
+}
+
 bool Probes_Shown() {
     return s_probefile.shown();
 }
@@ -269,10 +465,10 @@ void Probes_Construct() {
     CProbeFile::constructStatic();
     GlobalShaderCache().attachRenderable(s_probefile);
     GlobalCommands_insert("ToggleLightProbes", FreeCaller<Probes_Toggle>(), QKeySequence("Ctrl+Shift+P"));
+    GlobalCommands_insert("CycleLightProbeColour", FreeCaller<Probes_CycleColour>());
 }
 
 void Probes_Destroy() {
     GlobalShaderCache().detachRenderable(s_probefile);
     CProbeFile::destroyStatic();
 }
-
@@ -35,6 +35,8 @@
 #include <vector>
 #include <list>
 #include <map>
+#include <memory>
+#include <unordered_map>
 
 #include "math/matrix.h"
 #include "math/aabb.h"
@@ -43,6 +45,7 @@
 #include "string/string.h"
 #include "container/hashfunc.h"
 #include "container/cache.h"
+#include "container/dynamicaabbtree.h"
 #include "generic/reference.h"
 #include "moduleobservers.h"
 #include "stream/filestream.h"
@@ -740,70 +743,254 @@ inline bool lightEnabled( const RendererLight& light, const LightCullable& culla
 	return cullable.testLight( light );
 }
 
-typedef std::set<RendererLight*> RendererLights;
+/// \brief Returns bounds outside of which \p light cannot affect anything, or an invalid AABB if it is unbounded.
+/// The bounds of a point light are rotated when tested, so its sphere is used; projected lights are tested against their frustum.
+inline AABB light_cullingAABB( const RendererLight& light ){
+	if ( light.isProjected() || !aabb_valid( light.aabb() ) ) {
+		return AABB();
+	}
+	const float radius = static_cast<float>( vector3_length( light.aabb().extents ) );
+	return AABB( light.aabb().origin, Vector3( radius, radius, radius ) );
+}
 
 #define DEBUG_LIGHT_SYNC 0
 
+class LightCulling;
+
 class LinearLightList : public LightList
 {
+	friend class LightCulling;
+
+	LightCulling& m_culling;
 	LightCullable& m_cullable;
-	RendererLights& m_allLights;
-	Callback m_evaluateChanged;
+	mutable DynamicAABBTree<const LinearLightList*>::Proxy m_proxy;
 
-	typedef std::list<RendererLight*> Lights;
+	typedef std::vector<RendererLight*> Lights;
 	mutable Lights m_lights;
 	mutable bool m_lightsChanged;
 public:
-	LinearLightList( LightCullable& cullable, RendererLights& lights, const Callback& evaluateChanged ) :
-		m_cullable( cullable ), m_allLights( lights ), m_evaluateChanged( evaluateChanged ){
+	LinearLightList( LightCulling& culling, LightCullable& cullable ) :
+		m_culling( culling ), m_cullable( cullable ), m_proxy( DynamicAABBTree<const LinearLightList*>::c_null ){
 		m_lightsChanged = true;
 	}
-	void evaluateLights() const {
-		m_evaluateChanged();
-		if ( m_lightsChanged ) {
-			m_lightsChanged = false;
+	void evaluateLights() const;
+	void forEachLight( const RendererLightCallback& callback ) const {
+		evaluateLights();
 
-			m_lights.clear();
-			m_cullable.clearLights();
-			for ( RendererLights::const_iterator i = m_allLights.begin(); i != m_allLights.end(); ++i )
+		for ( Lights::const_iterator i = m_lights.begin(); i != m_lights.end(); ++i )
+		{
+			callback( *( *i ) );
+		}
+	}
+	void lightsChanged() const {
+		m_lightsChanged = true;
+	}
+};
+
+/// \brief Tracks which lights may affect which cullables.
+///
+/// - Lights and cullables are kept in dynamic AABB trees, unbounded lights in a separate list.
+/// - A changed light only invalidates the cullables overlapping its old or new bounds.
+/// - An invalidated cullable only tests the lights overlapping its bounds.
+class LightCulling
+{
+	typedef DynamicAABBTree<const LinearLightList*> Cullables;
+	typedef DynamicAABBTree<RendererLight*> Lights;
+
+	struct LightEntry
+	{
+		RendererLight* m_light;
+		AABB m_bounds;
+		Lights::Proxy m_proxy;
+		bool m_changed;
+	};
+
+	std::vector<LightEntry> m_lights;
+	std::vector<RendererLight*> m_unboundedLights;
+	Lights m_lightTree;
+	bool m_lightsChanged;
+
+	std::vector<std::unique_ptr<LinearLightList>> m_lists;
+	std::unordered_map<LightCullable*, std::size_t> m_listIndices;
+	Cullables m_cullableTree;
+
+	std::vector<LightEntry>::iterator findLight( RendererLight& light ){
+		return std::find_if( m_lights.begin(), m_lights.end(), [&light]( const LightEntry& entry ){
+			return entry.m_light == &light;
+		} );
+	}
+	/// \brief Invalidates the cullables that a light with \p bounds may affect.
+	void invalidate( const AABB& bounds ){
+		if ( !aabb_valid( bounds ) ) {
+			for ( const auto& list : m_lists )
 			{
-				if ( lightEnabled( *( *i ), m_cullable ) ) {
-					m_lights.push_back( *i );
-					m_cullable.insertLight( *( *i ) );
-				}
+				list->lightsChanged();
 			}
 		}
-#if ( DEBUG_LIGHT_SYNC )
 		else
 		{
-			Lights lights;
-			for ( RendererLights::const_iterator i = m_allLights.begin(); i != m_allLights.end(); ++i )
+			m_cullableTree.forEachIntersecting( bounds, []( const LinearLightList* list ){
+				list->lightsChanged();
+			} );
+		}
+	}
+	/// \brief Places a light entry in the tree or the unbounded list according to its current bounds.
+	void insert( LightEntry& entry ){
+		entry.m_bounds = light_cullingAABB( *entry.m_light );
+		if ( aabb_valid( entry.m_bounds ) ) {
+			entry.m_proxy = m_lightTree.insert( entry.m_bounds, entry.m_light );
+		}
+		else
+		{
+			entry.m_proxy = Lights::c_null;
+			m_unboundedLights.push_back( entry.m_light );
+		}
+	}
+	void remove( LightEntry& entry ){
+		if ( entry.m_proxy != Lights::c_null ) {
+			m_lightTree.erase( entry.m_proxy );
+		}
+		else
+		{
+			m_unboundedLights.erase( std::find( m_unboundedLights.begin(), m_unboundedLights.end(), entry.m_light ) );
+		}
+	}
+
+public:
+	LightCulling() : m_lightsChanged( false ){
+	}
+
+	const LightList& attach( LightCullable& cullable ){
+		const bool inserted = m_listIndices.insert( std::make_pair( &cullable, m_lists.size() ) ).second;
+		ASSERT_MESSAGE( inserted, "cullable could not be attached" );
+		m_lists.emplace_back( new LinearLightList( *this, cullable ) );
+		return *m_lists.back();
+	}
+	void detach( LightCullable& cullable ){
+		const auto i = m_listIndices.find( &cullable );
+		ASSERT_MESSAGE( i != m_listIndices.end(), "cullable not attached" );
+		LinearLightList& list = *m_lists[i->second];
+		if ( list.m_proxy != Cullables::c_null ) {
+			m_cullableTree.erase( list.m_proxy );
+		}
+
+		// swap with the last list to keep the storage contiguous
+		const std::size_t index = i->second;
+		m_listIndices.erase( i );
+		if ( index != m_lists.size() - 1 ) {
+			m_lists[index] = std::move( m_lists.back() );
+			m_listIndices[&m_lists[index]->m_cullable] = index;
+		}
+		m_lists.pop_back();
+	}
+	void changed( LightCullable& cullable ){
+		const auto i = m_listIndices.find( &cullable );
+		ASSERT_MESSAGE( i != m_listIndices.end(), "cullable not attached" );
+		m_lists[i->second]->lightsChanged();
+	}
+
+	void attach( RendererLight& light ){
+		ASSERT_MESSAGE( findLight( light ) == m_lights.end(), "light could not be attached" );
+		m_lights.push_back( LightEntry{ &light, AABB(), Lights::c_null, false } );
+		insert( m_lights.back() );
+		invalidate( m_lights.back().m_bounds );
+	}
+	void detach( RendererLight& light ){
+		const auto i = findLight( light );
+		ASSERT_MESSAGE( i != m_lights.end(), "light could not be detached" );
+		// lists that may reference the light are invalidated now, the light is gone by the next evaluation
+		invalidate( i->m_bounds );
+		remove( *i );
+		*i = m_lights.back();
+		m_lights.pop_back();
+	}
+	void changed( RendererLight& light ){
+		const auto i = findLight( light );
+		ASSERT_MESSAGE( i != m_lights.end(), "light not attached" );
+		i->m_changed = true;
+		m_lightsChanged = true;
+	}
+	void evaluateChanged(){
+		if ( m_lightsChanged ) {
+			m_lightsChanged = false;
+			for ( LightEntry& entry : m_lights )
 			{
-				if ( lightEnabled( *( *i ), m_cullable ) ) {
-					lights.push_back( *i );
+				if ( entry.m_changed ) {
+					entry.m_changed = false;
+					invalidate( entry.m_bounds );
+					remove( entry );
+					insert( entry );
+					invalidate( entry.m_bounds );
 				}
 			}
-			ASSERT_MESSAGE(
-			    !std::lexicographical_compare( lights.begin(), lights.end(), m_lights.begin(), m_lights.end() )
-			    && !std::lexicographical_compare( m_lights.begin(), m_lights.end(), lights.begin(), lights.end() ),
-			    "lights out of sync"
-			);
 		}
-#endif
 	}
-	void forEachLight( const RendererLightCallback& callback ) const {
-		evaluateLights();
 
-		for ( Lights::const_iterator i = m_lights.begin(); i != m_lights.end(); ++i )
-		{
-			callback( *( *i ) );
+	/// \brief Updates the bounds of \p list and collects the lights that affect its cullable.
+	void evaluate( const LinearLightList& list ){
+		const AABB& bounds = list.m_cullable.cullableAABB();
+		if ( list.m_proxy != Cullables::c_null ) {
+			if ( aabb_valid( bounds ) ) {
+				m_cullableTree.update( list.m_proxy, bounds );
+			}
+			else
+			{
+				m_cullableTree.erase( list.m_proxy );
+				list.m_proxy = Cullables::c_null;
+			}
+		}
+		else if ( aabb_valid( bounds ) ) {
+			list.m_proxy = m_cullableTree.insert( bounds, &list );
+		}
+
+		const auto test = [&list]( RendererLight* light ){
+			if ( lightEnabled( *light, list.m_cullable ) ) {
+				list.m_lights.push_back( light );
+				list.m_cullable.insertLight( *light );
+			}
+		};
+		if ( aabb_valid( bounds ) ) {
+			m_lightTree.forEachIntersecting( bounds, test );
 		}
+		std::for_each( m_unboundedLights.begin(), m_unboundedLights.end(), test );
 	}
-	void lightsChanged() const {
-		m_lightsChanged = true;
+#if ( DEBUG_LIGHT_SYNC )
+	template<typename Functor>
+	void forEachLight( const Functor& functor ) const {
+		for ( const LightEntry& entry : m_lights )
+		{
+			functor( entry.m_light );
+		}
 	}
+#endif
 };
 
+void LinearLightList::evaluateLights() const {
+	m_culling.evaluateChanged();
+	if ( m_lightsChanged ) {
+		m_lightsChanged = false;
+
+		m_lights.clear();
+		m_cullable.clearLights();
+		m_culling.evaluate( *this );
+	}
+#if ( DEBUG_LIGHT_SYNC )
+	else
+	{
+		Lights lights;
+		m_culling.forEachLight( [&]( RendererLight* light ){
+			if ( lightEnabled( *light, m_cullable ) ) {
+				lights.push_back( light );
+			}
+		} );
+		Lights sorted( m_lights );
+		std::sort( lights.begin(), lights.end() );
+		std::sort( sorted.begin(), sorted.end() );
+		ASSERT_MESSAGE( lights == sorted, "lights out of sync" );
+	}
+#endif
+}
+
 inline void setFogState( const OpenGLFogState& state ){
 	gl().glFogi( GL_FOG_MODE, state.mode );
 	gl().glFogf( GL_FOG_DENSITY, state.density );
@@ -851,7 +1038,6 @@ public:
 		m_shaders( CreateOpenGLShader( this ) ),
 		m_unrealised( 3 ), // wait until shaders, gl-context and textures are realised before creating any render-states
 		m_lightingEnabled( true ),
-		m_lightsChanged( true ),
 		m_traverseRenderablesMutex( false ){
 	}
 	~OpenGLShaderCache(){
@@ -1048,45 +1234,26 @@ public:
 
 // light culling
 
-	RendererLights m_lights;
-	bool m_lightsChanged;
-	typedef std::map<LightCullable*, LinearLightList> LightLists;
-	LightLists m_lightLists;
+	LightCulling m_lightCulling;
 
 	const LightList& attach( LightCullable& cullable ){
-		return ( *m_lightLists.insert( LightLists::value_type( &cullable, LinearLightList( cullable, m_lights, EvaluateChangedCaller( *this ) ) ) ).first ).second;
+		return m_lightCulling.attach( cullable );
 	}
 	void detach( LightCullable& cullable ){
-		m_lightLists.erase( &cullable );
+		m_lightCulling.detach( cullable );
 	}
 	void changed( LightCullable& cullable ){
-		LightLists::iterator i = m_lightLists.find( &cullable );
-		ASSERT_MESSAGE( i != m_lightLists.end(), "cullable not attached" );
-		( *i ).second.lightsChanged();
+		m_lightCulling.changed( cullable );
 	}
 	void attach( RendererLight& light ){
-		const bool inserted = m_lights.insert( &light ).second;
-		ASSERT_MESSAGE( inserted, "light could not be attached" );
-		changed( light );
+		m_lightCulling.attach( light );
 	}
 	void detach( RendererLight& light ){
-		const bool erased = m_lights.erase( &light );
-		ASSERT_MESSAGE( erased, "light could not be detached" );
-		changed( light );
+		m_lightCulling.detach( light );
 	}
 	void changed( RendererLight& light ){
-		m_lightsChanged = true;
+		m_lightCulling.changed( light );
 	}
-	void evaluateChanged(){
-		if ( m_lightsChanged ) {
-			m_lightsChanged = false;
-			for ( LightLists::iterator i = m_lightLists.begin(); i != m_lightLists.end(); ++i )
-			{
-				( *i ).second.lightsChanged();
-			}
-		}
-	}
-	typedef MemberCaller<OpenGLShaderCache, &OpenGLShaderCache::evaluateChanged> EvaluateChangedCaller;
 
 	typedef std::set<const Renderable*> Renderables;
 	Renderables m_renderables;
@@ -1906,6 +2073,12 @@ void OpenGLShader::construct( const char* name ){
 			state.m_state = RENDER_COLOURARRAY | RENDER_COLOURWRITE | RENDER_DEPTHWRITE;
 			state.m_sort = OpenGLState::eSortLast;
 		}
+		else if ( string_equal( name + 1, "PROBES" ) ) {
+			state.m_state = RENDER_COLOURARRAY | RENDER_DEPTHTEST | RENDER_COLOURWRITE | RENDER_DEPTHWRITE;
+			state.m_sort = OpenGLState::eSortFullbright;
+			state.m_pointsize = 8;
+			state.m_linewidth = 2;
+		}
 		else if ( string_equal( name + 1, "POINTFILE" ) ) {
 			state.m_colour[0] = 1;
 			state.m_colour[1] = 0;
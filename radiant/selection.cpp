@@ -7350,6 +7350,7 @@ public:
 			{
 				Scene_Translate_Selected( GlobalSceneGraph(), m_translation );
 			}
+			Scene_evaluateSelectedBReps();
 
 			SceneChangeNotify();
 		}
@@ -7377,6 +7378,7 @@ public:
 
 				matrix4_assign_rotation_for_pivot( m_pivot2world, m_selection.back() );
 			}
+			Scene_evaluateSelectedBReps();
 #ifdef SELECTIONSYSTEM_AXIAL_PIVOTS
 			matrix4_assign_rotation( m_pivot2world, matrix4_rotation_for_quaternion_quantised( m_rotation ) );
 #endif
@@ -7401,6 +7403,7 @@ public:
 			{
 				Scene_Scale_Selected( GlobalSceneGraph(), m_scale, m_pivot2world.t().vec3() );
 			}
+			Scene_evaluateSelectedBReps();
 
 			if( ManipulatorMode() == eSkew ){
 				m_pivot2world[0] = scaling[0];
@@ -7429,6 +7432,7 @@ public:
 			{
 				Scene_Skew_Selected( GlobalSceneGraph(), m_skew, m_pivot2world.t().vec3() );
 			}
+			Scene_evaluateSelectedBReps();
 			m_pivot2world[skew.index] = skew.amount;
 			SceneChangeNotify();
 		}
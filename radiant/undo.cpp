@@ -56,6 +56,7 @@ public:
 class RadiantUndoSystem : public UndoSystem
 {
 	INTEGER_CONSTANT( MAX_UNDO_LEVELS, 4096 );
+	INTEGER_CONSTANT( MAX_UNDO_MEMORY, 65536 );
 
 	class Snapshot
 	{
@@ -76,6 +77,14 @@ class RadiantUndoSystem : public UndoSystem
 			void release(){
 				m_data->release();
 			}
+			/// \brief Reduces the saved state to what differs from the current state. Returns false if nothing changed.
+			bool diff(){
+				m_data = m_undoable->diffState( m_data );
+				return m_data != 0;
+			}
+			std::size_t bytes() const {
+				return sizeof( StateApplicator ) + m_data->size();
+			}
 		};
 
 		typedef std::list<StateApplicator> states_t;
@@ -91,6 +100,22 @@ class RadiantUndoSystem : public UndoSystem
 		void save( Undoable* undoable ){
 			m_states.push_front( StateApplicator( undoable, undoable->exportState() ) );
 		}
+		/// \brief Drops the unchanged parts of each saved state. Returns the number of bytes held by the remaining states.
+		std::size_t diff(){
+			std::size_t bytes = 0;
+			for ( states_t::iterator i = m_states.begin(); i != m_states.end(); )
+			{
+				if ( ( *i ).diff() ) {
+					bytes += ( *i ).bytes();
+					++i;
+				}
+				else
+				{
+					i = m_states.erase( i );
+				}
+			}
+			return bytes;
+		}
 		void restore(){
 			for ( states_t::iterator i = m_states.begin(); i != m_states.end(); ++i )
 			{
@@ -109,9 +134,10 @@ class RadiantUndoSystem : public UndoSystem
 	{
 		Snapshot m_snapshot;
 		CopiedString m_command;
+		std::size_t m_bytes;
 
 		Operation( const char* command )
-			: m_command( command ){
+			: m_command( command ), m_bytes( 0 ){
 		}
 		~Operation(){
 			m_snapshot.release();
@@ -126,9 +152,10 @@ class RadiantUndoSystem : public UndoSystem
 
 		Operations m_stack;
 		Operation* m_pending;
+		std::size_t m_bytes;
 
 	public:
-		UndoStack() : m_pending( 0 ){
+		UndoStack() : m_pending( 0 ), m_bytes( 0 ){
 		}
 		~UndoStack(){
 			clear();
@@ -139,6 +166,10 @@ class RadiantUndoSystem : public UndoSystem
 		std::size_t size() const {
 			return m_stack.size();
 		}
+		/// \brief Returns the approximate number of bytes held by all finished operations.
+		std::size_t bytes() const {
+			return m_bytes;
+		}
 		Operation* back(){
 			return m_stack.back();
 		}
@@ -152,10 +183,12 @@ class RadiantUndoSystem : public UndoSystem
 			return m_stack.front();
 		}
 		void pop_front(){
+			m_bytes -= m_stack.front()->m_bytes;
 			delete m_stack.front();
 			m_stack.pop_front();
 		}
 		void pop_back(){
+			m_bytes -= m_stack.back()->m_bytes;
 			delete m_stack.back();
 			m_stack.pop_back();
 		}
@@ -167,6 +200,7 @@ class RadiantUndoSystem : public UndoSystem
 				}
 				m_stack.clear();
 			}
+			m_bytes = 0;
 		}
 		void start( const char* command ){
 			if ( m_pending != 0 ) {
@@ -183,7 +217,10 @@ class RadiantUndoSystem : public UndoSystem
 			else
 			{
 				ASSERT_MESSAGE( !m_stack.empty(), "undo stack empty" );
-				m_stack.back()->m_command = command;
+				Operation* operation = m_stack.back();
+				operation->m_command = command;
+				operation->m_bytes = operation->m_snapshot.diff();
+				m_bytes += operation->m_bytes;
 				return true;
 			}
 		}
@@ -231,12 +268,23 @@ class RadiantUndoSystem : public UndoSystem
 	}
 
 	std::size_t m_undo_levels;
+	std::size_t m_undo_memory; // megabytes, 0 = unlimited
 
 	typedef std::set<UndoTracker*> Trackers;
 	Trackers m_trackers;
+
+	/// \brief Discards the oldest undo operations until the stack fits the memory limit, always keeping the latest one.
+	void trimMemory(){
+		if ( m_undo_memory != 0 ) {
+			while ( m_undo_stack.size() > 1 && m_undo_stack.bytes() > m_undo_memory * 1024 * 1024 )
+			{
+				m_undo_stack.pop_front();
+			}
+		}
+	}
 public:
 	RadiantUndoSystem()
-		: m_undo_levels( 512 ){
+		: m_undo_levels( 512 ), m_undo_memory( 1024 ){
 	}
 	~RadiantUndoSystem(){
 		clear();
@@ -265,6 +313,17 @@ public:
 	std::size_t getLevels() const {
 		return m_undo_levels;
 	}
+	void setMemoryLimit( std::size_t megabytes ){
+		if ( megabytes > static_cast<unsigned>( MAX_UNDO_MEMORY ) ) {
+			megabytes = MAX_UNDO_MEMORY;
+		}
+
+		m_undo_memory = megabytes;
+		trimMemory();
+	}
+	std::size_t getMemoryLimit() const {
+		return m_undo_memory;
+	}
 	std::size_t size() const {
 		return m_undo_stack.size();
 	}
@@ -297,6 +356,7 @@ public:
 	void finish( const char* command ){
 		if ( finishUndo( command ) ) {
 			globalOutputStream() << command << '\n';
+			trimMemory();
 		}
 	}
 	void undo(){
@@ -329,6 +389,7 @@ public:
 			operation->m_snapshot.restore();
 			finishUndo( operation->m_command.c_str() );
 			m_redo_stack.pop_back();
+			trimMemory();
 		}
 	}
 	void clear(){
@@ -395,9 +456,19 @@ void UndoLevelsExport( const RadiantUndoSystem& self, const IntImportCallback& i
 }
 typedef ConstReferenceCaller1<RadiantUndoSystem, const IntImportCallback&, UndoLevelsExport> UndoLevelsExportCaller;
 
+void UndoMemoryImport( RadiantUndoSystem& self, int value ){
+	self.setMemoryLimit( value );
+}
+typedef ReferenceCaller1<RadiantUndoSystem, int, UndoMemoryImport> UndoMemoryImportCaller;
+void UndoMemoryExport( const RadiantUndoSystem& self, const IntImportCallback& importCallback ){
+	importCallback( static_cast<int>( self.getMemoryLimit() ) );
+}
+typedef ConstReferenceCaller1<RadiantUndoSystem, const IntImportCallback&, UndoMemoryExport> UndoMemoryExportCaller;
+
 
 void Undo_constructPreferences( RadiantUndoSystem& undo, PreferencesPage& page ){
 	page.appendSpinner( "Undo Queue Size", 0, 4096, IntImportCallback( UndoLevelsImportCaller( undo ) ), IntExportCallback( UndoLevelsExportCaller( undo ) ) );
+	page.appendSpinner( "Undo Memory Limit (MB, 0 = unlimited)", 0, 65536, IntImportCallback( UndoMemoryImportCaller( undo ) ), IntExportCallback( UndoMemoryExportCaller( undo ) ) );
 }
 void Undo_constructPage( RadiantUndoSystem& undo, PreferenceGroup& group ){
 	PreferencesPage page( group.createPage( "Undo", "Undo Queue Settings" ) );
@@ -420,6 +491,7 @@ public:
 
 	UndoSystemAPI(){
 		GlobalPreferenceSystem().registerPreference( "UndoLevels", makeIntStringImportCallback( UndoLevelsImportCaller( m_undosystem ) ), makeIntStringExportCallback( UndoLevelsExportCaller( m_undosystem ) ) );
+		GlobalPreferenceSystem().registerPreference( "UndoMemoryLimit", makeIntStringImportCallback( UndoMemoryImportCaller( m_undosystem ) ), makeIntStringExportCallback( UndoMemoryExportCaller( m_undosystem ) ) );
 
 		Undo_registerPreferencesPage( m_undosystem );
 	}
@@ -266,6 +266,7 @@ namespace ApexLegends {
     void        EmitLightmaps();
     void        SetupSurfaceLightmaps();
     void        ComputeLightmapLighting();
+    void        CompressLightmapPages();
     
     // Light probe system - generates ambient lighting data for the map
     // Light probes store spherical harmonics for ambient + references to static lights
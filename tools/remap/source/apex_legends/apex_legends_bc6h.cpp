@@ -0,0 +1,540 @@
+/* -------------------------------------------------------------------------------
+
+   Copyright (C) 2022-2025 MRVN-Radiant and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+
+   This file is part of MRVN-Radiant.
+
+   MRVN-Radiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   MRVN-Radiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+   ------------------------------------------------------------------------------- */
+
+/*
+    Apex Legends Lightmap Compression
+
+    Encodes the uncompressed 8 byte HDR lightmap pages to BC6H (unsigned half).
+    Each page is stored as two BC6H surfaces, direct light followed by indirect
+    light, 16 bytes per 4x4 block.
+
+    Only BC6H mode 11 (single region, 10 bit endpoints, 4 bit indices) is emitted.
+    Lightmaps are smooth so the extra partitions of the other modes buy little.
+
+    -compressquality selects how endpoints are picked:
+      0: bounding box diagonal
+      1: principal axis of the block
+      2: principal axis refined with least squares iterations
+*/
+
+#include "../remap.h"
+#include "../bspfile_abstract.h"
+#include "apex_legends.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+
+namespace {
+    constexpr int BC6H_BLOCK_SIZE = 16;
+    constexpr int BC6H_MAX_HALF = 0x7BFF;
+
+    // 4 bit index interpolation weights from the BC6H spec
+    constexpr int BC6H_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // One 4x4 block, per texel and channel: the half float bit pattern held as a float for the fitting maths
+    struct Block_t {
+        float texels[16][3];
+    };
+
+    // The page currently being compressed, shared with the worker threads
+    struct PageJob_t {
+        int width;
+        int height;
+        int blocksWide;
+        const float *source;  // width * height * 3 linear floats
+        uint8_t *dest;        // blocksWide * blocksHigh * 16 bytes
+    };
+    PageJob_t g_pageJob;
+}
+
+
+/*
+    FloatToHalf
+    Converts a non-negative float to IEEE half bits, clamped to the largest finite half
+*/
+static int FloatToHalf(float value) {
+    if (!(value > 0.0f)) {
+        return 0;
+    }
+    if (value >= 65504.0f) {
+        return BC6H_MAX_HALF;
+    }
+
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent <= 0) {
+        // Denormal half
+        if (exponent < -10) {
+            return 0;
+        }
+        mantissa |= 0x800000;
+        const int shift = 14 - exponent;
+        return static_cast<int>((mantissa + (1u << (shift - 1))) >> shift);
+    }
+
+    const int half = (exponent << 10) | static_cast<int>(mantissa >> 13);
+    // Round to nearest, carrying into the exponent is correct for halves
+    return std::min(BC6H_MAX_HALF, half + static_cast<int>((mantissa >> 12) & 1));
+}
+
+
+/*
+    HalfToFloat
+    Converts IEEE half bits to a float
+*/
+static float HalfToFloat(int half) {
+    const int exponent = (half >> 10) & 0x1F;
+    const int mantissa = half & 0x3FF;
+
+    if (exponent == 0) {
+        return std::ldexp(static_cast<float>(mantissa), -24);
+    }
+    return std::ldexp(static_cast<float>(mantissa | 0x400), exponent - 25);
+}
+
+
+/*
+    QuantizeEndpoint
+    Maps a half bit pattern to the 10 bit endpoint that unquantizes closest to it
+*/
+static int QuantizeEndpoint(float half) {
+    const float unquantized = std::clamp(half, 0.0f, static_cast<float>(BC6H_MAX_HALF)) * 64.0f / 31.0f;
+    return std::clamp(static_cast<int>((unquantized - 32.0f) / 64.0f + 0.5f), 0, 1023);
+}
+
+
+/*
+    UnquantizeEndpoint
+    BC6H unsigned unquantization of a 10 bit endpoint to 16 bits
+*/
+static int UnquantizeEndpoint(int value) {
+    if (value == 0) {
+        return 0;
+    }
+    if (value == 1023) {
+        return 0xFFFF;
+    }
+    return ((value << 16) + 0x8000) >> 10;
+}
+
+
+/*
+    BuildPalette
+    Decodes the 16 half bit colors a pair of 10 bit endpoints can represent
+*/
+static void BuildPalette(const int endpoints[2][3], float palette[16][3]) {
+    for (int channel = 0; channel < 3; channel++) {
+        const int a = UnquantizeEndpoint(endpoints[0][channel]);
+        const int b = UnquantizeEndpoint(endpoints[1][channel]);
+        for (int i = 0; i < 16; i++) {
+            const int interpolated = ((64 - BC6H_WEIGHTS[i]) * a + BC6H_WEIGHTS[i] * b + 32) >> 6;
+            palette[i][channel] = static_cast<float>((interpolated * 31) >> 6);
+        }
+    }
+}
+
+
+/*
+    AssignIndices
+    Picks the nearest palette entry for each texel, returns the summed squared error
+*/
+static float AssignIndices(const Block_t &block, const int endpoints[2][3], int indices[16]) {
+    float palette[16][3];
+    BuildPalette(endpoints, palette);
+
+    float total = 0.0f;
+    for (int t = 0; t < 16; t++) {
+        float best = FLT_MAX;
+        for (int i = 0; i < 16; i++) {
+            const float dr = block.texels[t][0] - palette[i][0];
+            const float dg = block.texels[t][1] - palette[i][1];
+            const float db = block.texels[t][2] - palette[i][2];
+            const float error = dr * dr + dg * dg + db * db;
+            if (error < best) {
+                best = error;
+                indices[t] = i;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+
+/*
+    PrincipalAxis
+    Power iteration on the block covariance, returns false for flat blocks
+*/
+static bool PrincipalAxis(const Block_t &block, const float mean[3], float axis[3]) {
+    float covariance[6] = {};
+    for (int t = 0; t < 16; t++) {
+        const float d[3] = { block.texels[t][0] - mean[0], block.texels[t][1] - mean[1], block.texels[t][2] - mean[2] };
+        covariance[0] += d[0] * d[0];
+        covariance[1] += d[0] * d[1];
+        covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1];
+        covariance[4] += d[1] * d[2];
+        covariance[5] += d[2] * d[2];
+    }
+
+    float v[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; iteration++) {
+        const float x = covariance[0] * v[0] + covariance[1] * v[1] + covariance[2] * v[2];
+        const float y = covariance[1] * v[0] + covariance[3] * v[1] + covariance[4] * v[2];
+        const float z = covariance[2] * v[0] + covariance[4] * v[1] + covariance[5] * v[2];
+        const float length = std::max({ std::fabs(x), std::fabs(y), std::fabs(z) });
+        if (length <= 0.0f) {
+            return false;
+        }
+        v[0] = x / length;
+        v[1] = y / length;
+        v[2] = z / length;
+    }
+
+    const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    axis[0] = v[0] / length;
+    axis[1] = v[1] / length;
+    axis[2] = v[2] / length;
+    return true;
+}
+
+
+/*
+    RefineEndpoints
+    Least squares fit of both endpoints to the current index assignment
+*/
+static bool RefineEndpoints(const Block_t &block, const int indices[16], float line[2][3]) {
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[3] = {}, bx[3] = {};
+    for (int t = 0; t < 16; t++) {
+        const float w = BC6H_WEIGHTS[indices[t]] / 64.0f;
+        const float a = 1.0f - w;
+        aa += a * a;
+        ab += a * w;
+        bb += w * w;
+        for (int channel = 0; channel < 3; channel++) {
+            ax[channel] += a * block.texels[t][channel];
+            bx[channel] += w * block.texels[t][channel];
+        }
+    }
+
+    const float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f) {
+        return false;
+    }
+    for (int channel = 0; channel < 3; channel++) {
+        line[0][channel] = (ax[channel] * bb - bx[channel] * ab) / determinant;
+        line[1][channel] = (bx[channel] * aa - ax[channel] * ab) / determinant;
+    }
+    return true;
+}
+
+
+/*
+    WriteBits
+    Writes the low count bits of value into a 128 bit block at offset
+*/
+static void WriteBits(uint8_t *out, int &offset, int value, int count) {
+    for (int i = 0; i < count; i++, offset++) {
+        if ((value >> i) & 1) {
+            out[offset >> 3] |= static_cast<uint8_t>(1 << (offset & 7));
+        }
+    }
+}
+
+
+/*
+    ReadBits
+    Reads count bits from a 128 bit block at offset
+*/
+static int ReadBits(const uint8_t *in, int &offset, int count) {
+    int value = 0;
+    for (int i = 0; i < count; i++, offset++) {
+        value |= ((in[offset >> 3] >> (offset & 7)) & 1) << i;
+    }
+    return value;
+}
+
+
+/*
+    EncodeBlock
+    Encodes one block as BC6H mode 11
+*/
+static void EncodeBlock(const Block_t &block, int quality, uint8_t *out) {
+    float line[2][3];
+
+    if (quality == 0) {
+        for (int channel = 0; channel < 3; channel++) {
+            line[0][channel] = FLT_MAX;
+            line[1][channel] = 0.0f;
+            for (int t = 0; t < 16; t++) {
+                line[0][channel] = std::min(line[0][channel], block.texels[t][channel]);
+                line[1][channel] = std::max(line[1][channel], block.texels[t][channel]);
+            }
+        }
+    }
+    else {
+        float mean[3] = {};
+        for (int t = 0; t < 16; t++) {
+            for (int channel = 0; channel < 3; channel++) {
+                mean[channel] += block.texels[t][channel] / 16.0f;
+            }
+        }
+
+        float axis[3];
+        if (!PrincipalAxis(block, mean, axis)) {
+            axis[0] = axis[1] = axis[2] = 0.0f;
+        }
+        float lo = FLT_MAX, hi = -FLT_MAX;
+        for (int t = 0; t < 16; t++) {
+            const float d = (block.texels[t][0] - mean[0]) * axis[0]
+                          + (block.texels[t][1] - mean[1]) * axis[1]
+                          + (block.texels[t][2] - mean[2]) * axis[2];
+            lo = std::min(lo, d);
+            hi = std::max(hi, d);
+        }
+        for (int channel = 0; channel < 3; channel++) {
+            line[0][channel] = mean[channel] + axis[channel] * lo;
+            line[1][channel] = mean[channel] + axis[channel] * hi;
+        }
+    }
+
+    int endpoints[2][3];
+    int indices[16];
+    for (int e = 0; e < 2; e++) {
+        for (int channel = 0; channel < 3; channel++) {
+            endpoints[e][channel] = QuantizeEndpoint(line[e][channel]);
+        }
+    }
+    float error = AssignIndices(block, endpoints, indices);
+
+    if (quality >= 2) {
+        for (int iteration = 0; iteration < 4 && error > 0.0f; iteration++) {
+            if (!RefineEndpoints(block, indices, line)) {
+                break;
+            }
+
+            int candidate[2][3];
+            int candidateIndices[16];
+            for (int e = 0; e < 2; e++) {
+                for (int channel = 0; channel < 3; channel++) {
+                    candidate[e][channel] = QuantizeEndpoint(line[e][channel]);
+                }
+            }
+            const float candidateError = AssignIndices(block, candidate, candidateIndices);
+            if (candidateError >= error) {
+                break;
+            }
+            error = candidateError;
+            std::memcpy(endpoints, candidate, sizeof(endpoints));
+            std::memcpy(indices, candidateIndices, sizeof(indices));
+        }
+    }
+
+    // The anchor index is stored with an implicit zero high bit
+    if (indices[0] & 8) {
+        for (int channel = 0; channel < 3; channel++) {
+            std::swap(endpoints[0][channel], endpoints[1][channel]);
+        }
+        for (int &index : indices) {
+            index = 15 - index;
+        }
+    }
+
+    std::memset(out, 0, BC6H_BLOCK_SIZE);
+    int offset = 0;
+    WriteBits(out, offset, 0x03, 5);
+    for (int e = 0; e < 2; e++) {
+        for (int channel = 0; channel < 3; channel++) {
+            WriteBits(out, offset, endpoints[e][channel], 10);
+        }
+    }
+    WriteBits(out, offset, indices[0], 3);
+    for (int t = 1; t < 16; t++) {
+        WriteBits(out, offset, indices[t], 4);
+    }
+}
+
+
+/*
+    DecodeBlock
+    Decodes a mode 11 block written by EncodeBlock back to linear floats
+*/
+static void DecodeBlock(const uint8_t *in, float texels[16][3]) {
+    int offset = 5;
+    int endpoints[2][3];
+    for (int e = 0; e < 2; e++) {
+        for (int channel = 0; channel < 3; channel++) {
+            endpoints[e][channel] = ReadBits(in, offset, 10);
+        }
+    }
+
+    float palette[16][3];
+    BuildPalette(endpoints, palette);
+    for (int t = 0; t < 16; t++) {
+        const int index = ReadBits(in, offset, t == 0 ? 3 : 4);
+        for (int channel = 0; channel < 3; channel++) {
+            texels[t][channel] = HalfToFloat(static_cast<int>(palette[index][channel]));
+        }
+    }
+}
+
+
+/*
+    CompressBlockRow
+    Worker for RunThreadsOnIndividual, encodes one row of blocks of the current page
+*/
+static void CompressBlockRow(int row) {
+    const PageJob_t &job = g_pageJob;
+    const int quality = std::clamp(g_lightmapCompressQuality, 0, 2);
+
+    for (int column = 0; column < job.blocksWide; column++) {
+        Block_t block;
+        for (int t = 0; t < 16; t++) {
+            // Replicate edge texels for pages that aren't a multiple of 4
+            const int x = std::min(column * 4 + (t & 3), job.width - 1);
+            const int y = std::min(row * 4 + (t >> 2), job.height - 1);
+            const float *texel = &job.source[(y * job.width + x) * 3];
+            for (int channel = 0; channel < 3; channel++) {
+                block.texels[t][channel] = static_cast<float>(FloatToHalf(texel[channel]));
+            }
+        }
+        EncodeBlock(block, quality, &job.dest[(row * job.blocksWide + column) * BC6H_BLOCK_SIZE]);
+    }
+}
+
+
+/*
+    DecodeHDRTexel
+    Inverse of EncodeHDRTexel for one RGBE half of a texel
+*/
+static void DecodeHDRTexel(const uint8_t *in, float *out) {
+    const float scale = std::pow(2.0f, in[3] / 8.0f);
+    for (int channel = 0; channel < 3; channel++) {
+        out[channel] = std::pow(in[channel] / 255.0f, 2.2f) * scale;
+    }
+}
+
+
+/*
+    ComputePSNR
+    Peak signal to noise ratio of the decoded surface against the source,
+    the peak being the brightest source channel of the page
+*/
+static double ComputePSNR(const std::vector<float> &source, const std::vector<uint8_t> &blocks, int width, int height) {
+    const int blocksWide = (width + 3) / 4;
+    const int blocksHigh = (height + 3) / 4;
+
+    double peak = 0.0;
+    double squaredError = 0.0;
+    for (int row = 0; row < blocksHigh; row++) {
+        for (int column = 0; column < blocksWide; column++) {
+            float texels[16][3];
+            DecodeBlock(&blocks[(row * blocksWide + column) * BC6H_BLOCK_SIZE], texels);
+            for (int t = 0; t < 16; t++) {
+                const int x = column * 4 + (t & 3);
+                const int y = row * 4 + (t >> 2);
+                if (x >= width || y >= height) {
+                    continue;
+                }
+                for (int channel = 0; channel < 3; channel++) {
+                    const double value = source[(y * width + x) * 3 + channel];
+                    const double d = value - texels[t][channel];
+                    peak = std::max(peak, value);
+                    squaredError += d * d;
+                }
+            }
+        }
+    }
+
+    const double mse = squaredError / (static_cast<double>(width) * height * 3);
+    if (mse <= 0.0 || peak <= 0.0) {
+        return 99.99;
+    }
+    return 10.0 * std::log10(peak * peak / mse);
+}
+
+
+/*
+    CompressLightmapPages
+    Encodes every lightmap page to BC6H and writes the headers and lump data,
+    printing the PSNR of each surface so compression error can be tracked
+*/
+void ApexLegends::CompressLightmapPages() {
+    Sys_Printf("     Compressing lightmaps to BC6H (quality %d)\n", std::clamp(g_lightmapCompressQuality, 0, 2));
+
+    double worstPSNR = 99.99;
+    std::size_t uncompressedSize = 0;
+
+    for (std::size_t i = 0; i < ApexLegends::Bsp::lightmapPages.size(); i++) {
+        const ApexLegends::LightmapPage_t &page = ApexLegends::Bsp::lightmapPages[i];
+        const int width = page.width;
+        const int height = page.height;
+        const int blocksWide = (width + 3) / 4;
+        const int blocksHigh = (height + 3) / 4;
+        const std::size_t texelCount = static_cast<std::size_t>(width) * height;
+
+        uncompressedSize += page.pixels.size();
+
+        // Bytes 0-3 hold direct light, 4-7 indirect light
+        std::vector<float> source[2];
+        for (int half = 0; half < 2; half++) {
+            source[half].resize(texelCount * 3);
+            for (std::size_t t = 0; t < texelCount; t++) {
+                DecodeHDRTexel(&page.pixels[t * 8 + half * 4], &source[half][t * 3]);
+            }
+        }
+
+        double psnr[2];
+        for (int half = 0; half < 2; half++) {
+            std::vector<uint8_t> blocks(static_cast<std::size_t>(blocksWide) * blocksHigh * BC6H_BLOCK_SIZE);
+
+            g_pageJob = { width, height, blocksWide, source[half].data(), blocks.data() };
+            RunThreadsOnIndividual(blocksHigh, false, CompressBlockRow);
+
+            psnr[half] = ComputePSNR(source[half], blocks, width, height);
+            worstPSNR = std::min(worstPSNR, psnr[half]);
+
+            ApexLegends::Bsp::lightmapDataSky.insert(ApexLegends::Bsp::lightmapDataSky.end(), blocks.begin(), blocks.end());
+        }
+
+        LightmapHeader_t header;
+        header.type = static_cast<uint8_t>(LightmapType::BC_4X4_A);
+        header.compressedType = 0;
+        header.tag = 0;
+        header.unknown = 0;
+        header.width = page.width;
+        header.height = page.height;
+        ApexLegends::Bsp::lightmapHeaders.push_back(header);
+
+        Sys_Printf("     page %3zu: %4dx%-4d PSNR %6.2f dB direct, %6.2f dB indirect\n", i, width, height, psnr[0], psnr[1]);
+    }
+
+    Sys_Printf("     %9.2f dB worst PSNR\n", worstPSNR);
+    Sys_Printf("     %9zu bytes uncompressed\n", uncompressedSize);
+}
@@ -821,7 +821,7 @@ namespace {
             }
 
             const std::vector<Shared::Vertex_t>& verts = mesh.vertices;
-            const std::vector<uint16_t>& indices = mesh.triangles;
+            const std::vector<uint32_t>& indices = mesh.triangles;
 
             for (size_t i = 0; i + 2 < indices.size(); i += 3) {
                 totalTris++;
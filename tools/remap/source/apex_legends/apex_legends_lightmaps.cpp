@@ -40,10 +40,17 @@
 #include "../bspfile_abstract.h"
 #include "../embree_trace.h"
 #include "apex_legends.h"
+#include "probefile.h"
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstring>
+#include <limits>
 #include <unordered_map>
 #include <unordered_set>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -745,19 +752,98 @@ static Vector3 GetPhongNormal(int meshIndex, const Vector3 &worldPos, const Vect
 }
 
 
+// =============================================================================
+// SAMPLING
+// Counter-based random numbers keyed by -seed, bake stage, object and sample
+// index, so results don't depend on evaluation order or thread count
+// =============================================================================
+
+namespace BakeSampling {
+    enum Stage : uint32_t {
+        STAGE_SUPERSAMPLE = 1,
+        STAGE_PROBE_DIRECTIONS,
+        STAGE_PROBE_SEEDING,
+    };
+
+    /*
+        Hash
+        PCG output permutation, a well mixed bijection of 32-bit values
+    */
+    inline uint32_t Hash(uint32_t value) {
+        const uint32_t state = value * 747796405u + 2891336453u;
+        const uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+
+    /*
+        Random
+        Uniform 32-bit value for one dimension of a sample of an object in a stage
+    */
+    inline uint32_t Random(Stage stage, uint32_t object, uint32_t sample, uint32_t dimension = 0) {
+        return Hash(Hash(Hash(Hash(g_bakeSeed ^ stage) ^ object) ^ sample) ^ dimension);
+    }
+
+    /*
+        Random01
+        Uniform float in [0, 1)
+    */
+    inline float Random01(Stage stage, uint32_t object, uint32_t sample, uint32_t dimension = 0) {
+        return static_cast<float>(Random(stage, object, sample, dimension) >> 8) * (1.0f / 16777216.0f);
+    }
+
+    /*
+        Sobol2D
+        Point of the first two Sobol dimensions in [0, 1)^2, XOR scrambled per
+        sample of an object, any power of two run of points stays stratified
+    */
+    inline void Sobol2D(uint32_t index, Stage stage, uint32_t object, uint32_t sample, float &x, float &y) {
+        uint32_t bitsX = Random(stage, object, sample, 0);
+        uint32_t bitsY = Random(stage, object, sample, 1);
+        for (uint32_t vx = 1u << 31, vy = 1u << 31; index != 0; index >>= 1, vx >>= 1, vy ^= vy >> 1) {
+            if (index & 1) {
+                bitsX ^= vx;
+                bitsY ^= vy;
+            }
+        }
+        x = static_cast<float>(bitsX >> 8) * (1.0f / 16777216.0f);
+        y = static_cast<float>(bitsY >> 8) * (1.0f / 16777216.0f);
+    }
+
+    /*
+        Rotation_t
+        Uniformly random rotation per sample of an object, used to decorrelate fixed direction sets
+    */
+    struct Rotation_t {
+        Vector3 rows[3];
+
+        Rotation_t(Stage stage, uint32_t object, uint32_t sample) {
+            // Shoemake's uniform random unit quaternion
+            const float u1 = Random01(stage, object, sample, 0);
+            const float u2 = Random01(stage, object, sample, 1) * 2.0f * static_cast<float>(M_PI);
+            const float u3 = Random01(stage, object, sample, 2) * 2.0f * static_cast<float>(M_PI);
+            const float a = std::sqrt(1.0f - u1);
+            const float b = std::sqrt(u1);
+            const float x = a * std::sin(u2), y = a * std::cos(u2), z = b * std::sin(u3), w = b * std::cos(u3);
+
+            rows[0] = Vector3(1 - 2 * (y * y + z * z), 2 * (x * y - z * w), 2 * (x * z + y * w));
+            rows[1] = Vector3(2 * (x * y + z * w), 1 - 2 * (x * x + z * z), 2 * (y * z - x * w));
+            rows[2] = Vector3(2 * (x * z - y * w), 2 * (y * z + x * w), 1 - 2 * (x * x + y * y));
+        }
+
+        Vector3 Apply(const Vector3 &dir) const {
+            return Vector3(static_cast<float>(vector3_dot(rows[0], dir)),
+                           static_cast<float>(vector3_dot(rows[1], dir)),
+                           static_cast<float>(vector3_dot(rows[2], dir)));
+        }
+    };
+}
+
+
 // =============================================================================
 // SUPERSAMPLING
 // Take multiple samples per texel and average for anti-aliased lighting
 // =============================================================================
 
-// Jitter offsets for 2x2 supersampling (rotated grid pattern)
-static const float supersampleOffsets[4][2] = {
-    { -0.25f, -0.125f },
-    {  0.25f, -0.375f },
-    { -0.125f, 0.375f },
-    {  0.375f, 0.125f }
-};
-
 
 // =============================================================================
 // RADIOSITY / BOUNCE LIGHTING
@@ -910,6 +996,74 @@ static void GatherRadiosityLight(int bounceNum) {
 }
 
 
+/*
+    AccumulateStaticLights
+    Adds the contribution of baked (non-sky, non-realtime) worldlights at a point
+*/
+static void AccumulateStaticLights(const Vector3 &worldPos, const Vector3 &normal, Vector3 &color) {
+    // Only bake NON-realtime static lights (point lights, spotlights)
+    // Skip emit_skyambient and emit_skylight - they're dynamic!
+    for (const WorldLight_t &light : ApexLegends::Bsp::worldLights) {
+        // Skip sky lighting - applied dynamically by engine
+        if (light.type == emit_skyambient || light.type == emit_skylight) {
+            continue;
+        }
+
+        // Skip realtime lights - they're computed per-frame
+        if (light.flags & WORLDLIGHT_FLAG_REALTIME) {
+            continue;
+        }
+
+        Vector3 lightPos(light.origin[0], light.origin[1], light.origin[2]);
+        Vector3 lightColor = light.intensity;
+
+        if (light.type == emit_point) {
+            // Static point light
+            Vector3 toLight = lightPos - worldPos;
+            float dist = vector3_length(toLight);
+            if (dist < 0.001f) continue;
+
+            Vector3 lightDir = toLight / dist;
+            // Use phong normal for smoother lighting across edges
+            float NdotL = vector3_dot(normal, lightDir);
+
+            if (NdotL > 0) {
+                float atten = 1.0f;
+                if (light.quadratic_attn > 0 || light.linear_attn > 0) {
+                    atten = 1.0f / (light.constant_attn + 
+                                   light.linear_attn * dist + 
+                                   light.quadratic_attn * dist * dist);
+                } else {
+                    atten = 1.0f / (1.0f + dist * dist * 0.0001f);
+                }
+                color = color + lightColor * NdotL * atten * 100.0f;
+            }
+        } else if (light.type == emit_spotlight) {
+            // Static spotlight
+            Vector3 toLight = lightPos - worldPos;
+            float dist = vector3_length(toLight);
+            if (dist < 0.001f) continue;
+
+            Vector3 lightDir = toLight / dist;
+            // Use phong normal for smoother lighting across edges
+            float NdotL = vector3_dot(normal, lightDir);
+
+            if (NdotL > 0) {
+                float spotDot = vector3_dot(-lightDir, light.normal);
+                if (spotDot > light.stopdot2) {
+                    float spotAtten = 1.0f;
+                    if (spotDot < light.stopdot) {
+                        spotAtten = (spotDot - light.stopdot2) / (light.stopdot - light.stopdot2);
+                    }
+                    float distAtten = 1.0f / (1.0f + dist * dist * 0.0001f);
+                    color = color + lightColor * NdotL * spotAtten * distAtten * 100.0f;
+                }
+            }
+        }
+    }
+}
+
+
 /*
     ComputeLightmapLighting
     Compute lighting for each texel.
@@ -956,6 +1110,8 @@ void ApexLegends::ComputeLightmapLighting() {
     Sys_Printf("...\n");
     
     for (SurfaceLightmap_t &surf : LightmapBuild::surfaces) {
+        const uint32_t surfIndex = static_cast<uint32_t>(&surf - LightmapBuild::surfaces.data());
+        
         // For each texel
         for (int y = 0; y < surf.rect.height; y++) {
             for (int x = 0; x < surf.rect.width; x++) {
@@ -963,12 +1119,18 @@ void ApexLegends::ComputeLightmapLighting() {
                 // SUPERSAMPLING: Take multiple samples and average
                 // =====================================================
                 Vector3 accumColor(0, 0, 0);
-                int numSamples = (SUPERSAMPLE_LEVEL > 1) ? 4 : 1;
+                int numSamples = SUPERSAMPLE_LEVEL * SUPERSAMPLE_LEVEL;
+                const uint32_t texelIndex = static_cast<uint32_t>(y * surf.rect.width + x);
                 
                 for (int sampleIdx = 0; sampleIdx < numSamples; sampleIdx++) {
-                    // Get sample offset (jittered for anti-aliasing)
-                    float offsetU = (numSamples > 1) ? supersampleOffsets[sampleIdx][0] : 0.0f;
-                    float offsetV = (numSamples > 1) ? supersampleOffsets[sampleIdx][1] : 0.0f;
+                    // Get sample offset, stratified over the texel and scrambled per texel
+                    float offsetU = 0.0f;
+                    float offsetV = 0.0f;
+                    if (numSamples > 1) {
+                        BakeSampling::Sobol2D(sampleIdx, BakeSampling::STAGE_SUPERSAMPLE, surfIndex, texelIndex, offsetU, offsetV);
+                        offsetU -= 0.5f;
+                        offsetV -= 0.5f;
+                    }
                     
                     // Compute world position for this sample
                     // Normalize texel to [0,1] within the rect, then map to tangent-space bounds
@@ -995,66 +1157,7 @@ void ApexLegends::ComputeLightmapLighting() {
                     // A small base value prevents completely black areas
                     Vector3 sampleColor(0.1f, 0.1f, 0.1f);
                     
-                    // Only bake NON-realtime static lights (point lights, spotlights)
-                    // Skip emit_skyambient and emit_skylight - they're dynamic!
-                    for (const WorldLight_t &light : ApexLegends::Bsp::worldLights) {
-                        // Skip sky lighting - applied dynamically by engine
-                        if (light.type == emit_skyambient || light.type == emit_skylight) {
-                            continue;
-                        }
-                        
-                        // Skip realtime lights - they're computed per-frame
-                        if (light.flags & WORLDLIGHT_FLAG_REALTIME) {
-                            continue;
-                        }
-                        
-                        Vector3 lightPos(light.origin[0], light.origin[1], light.origin[2]);
-                        Vector3 lightColor = light.intensity;
-                        
-                        if (light.type == emit_point) {
-                            // Static point light
-                            Vector3 toLight = lightPos - worldPos;
-                            float dist = vector3_length(toLight);
-                            if (dist < 0.001f) continue;
-                            
-                            Vector3 lightDir = toLight / dist;
-                            // Use phong normal for smoother lighting across edges
-                            float NdotL = vector3_dot(sampleNormal, lightDir);
-                            
-                            if (NdotL > 0) {
-                                float atten = 1.0f;
-                                if (light.quadratic_attn > 0 || light.linear_attn > 0) {
-                                    atten = 1.0f / (light.constant_attn + 
-                                                   light.linear_attn * dist + 
-                                                   light.quadratic_attn * dist * dist);
-                                } else {
-                                    atten = 1.0f / (1.0f + dist * dist * 0.0001f);
-                                }
-                                sampleColor = sampleColor + lightColor * NdotL * atten * 100.0f;
-                            }
-                        } else if (light.type == emit_spotlight) {
-                            // Static spotlight
-                            Vector3 toLight = lightPos - worldPos;
-                            float dist = vector3_length(toLight);
-                            if (dist < 0.001f) continue;
-                            
-                            Vector3 lightDir = toLight / dist;
-                            // Use phong normal for smoother lighting across edges
-                            float NdotL = vector3_dot(sampleNormal, lightDir);
-                            
-                            if (NdotL > 0) {
-                                float spotDot = vector3_dot(-lightDir, light.normal);
-                                if (spotDot > light.stopdot2) {
-                                    float spotAtten = 1.0f;
-                                    if (spotDot < light.stopdot) {
-                                        spotAtten = (spotDot - light.stopdot2) / (light.stopdot - light.stopdot2);
-                                    }
-                                    float distAtten = 1.0f / (1.0f + dist * dist * 0.0001f);
-                                    sampleColor = sampleColor + lightColor * NdotL * spotAtten * distAtten * 100.0f;
-                                }
-                            }
-                        }
-                    }
+                    AccumulateStaticLights(worldPos, sampleNormal, sampleColor);
                     
                     accumColor = accumColor + sampleColor;
                 }
@@ -1177,6 +1280,331 @@ static void EncodeHDRTexel(const Vector3 &color, uint8_t *out) {
 }
 
 
+/*
+    HDREncode
+    Lookup tables that reproduce EncodeHDRTexel without pow/log2 calls
+
+    Both the exponent and the gamma corrected mantissa are monotonic step
+    functions of their input, so each is fully described by the smallest
+    input that reaches every step. The tables are found by bisecting over
+    float bit patterns with EncodeHDRTexel itself, which keeps the fast
+    paths bit exact with the scalar encoder.
+
+    Lookups index a bucket table by the top 16 bits of the input float and
+    then step over the few thresholds that fall inside the bucket.
+*/
+namespace HDREncode {
+    constexpr int BUCKET_SHIFT = 16;
+    constexpr int EXPONENT_BUCKETS = (0x7F800000 >> BUCKET_SHIFT) + 1;  // up to +inf
+    constexpr int MANTISSA_BUCKETS = (0x3F800000 >> BUCKET_SHIFT) + 1;  // up to 1.0
+
+    // thresholds[i] is the smallest input encoding to i, thresholds[0] is -inf, thresholds[256] is NaN
+    // so that lookups stop at 255 even for +inf
+    float   exponentThresholds[257];
+    float   mantissaThresholds[257];
+    float   exponentScales[256];
+    int32_t exponentBuckets[EXPONENT_BUCKETS];
+    int32_t mantissaBuckets[MANTISSA_BUCKETS];
+    int     exponentSteps = 0;  // most thresholds inside a single bucket
+    int     mantissaSteps = 0;
+    bool    initialized = false;
+
+    /*
+        FindThreshold
+        Smallest float in [lo, hi] for which step(value) >= target, +inf if none
+    */
+    template<typename Step>
+    float FindThreshold(float lo, float hi, int target, const Step &step) {
+        uint32_t loBits, hiBits;
+        std::memcpy(&loBits, &lo, sizeof(loBits));
+        std::memcpy(&hiBits, &hi, sizeof(hiBits));
+
+        if (step(hi) < target) {
+            return std::numeric_limits<float>::infinity();
+        }
+        while (loBits < hiBits) {
+            const uint32_t midBits = loBits + (hiBits - loBits) / 2;
+            float mid;
+            std::memcpy(&mid, &midBits, sizeof(mid));
+            if (step(mid) >= target) {
+                hiBits = midBits;
+            } else {
+                loBits = midBits + 1;
+            }
+        }
+        float result;
+        std::memcpy(&result, &loBits, sizeof(result));
+        return result;
+    }
+
+    /*
+        BinaryLookup
+        Largest index whose threshold is <= value, used to build the buckets
+    */
+    inline int BinaryLookup(const float *thresholds, float value) {
+        int index = 0;
+        for (int step = 128; step != 0; step >>= 1) {
+            index += (thresholds[index + step] <= value) ? step : 0;
+        }
+        return index;
+    }
+
+    void FillBuckets(const float *thresholds, int32_t *buckets, int bucketCount, int &steps) {
+        for (int bucket = 0; bucket < bucketCount; bucket++) {
+            const uint32_t firstBits = static_cast<uint32_t>(bucket) << BUCKET_SHIFT;
+            const uint32_t lastBits = firstBits | ((1u << BUCKET_SHIFT) - 1);
+            float first, last;
+            std::memcpy(&first, &firstBits, sizeof(first));
+            std::memcpy(&last, &lastBits, sizeof(last));
+
+            buckets[bucket] = BinaryLookup(thresholds, first);
+            steps = std::max(steps, BinaryLookup(thresholds, last) - buckets[bucket]);
+        }
+    }
+
+    void Init() {
+        if (initialized) {
+            return;
+        }
+
+        const auto exponentOf = [](float value) {
+            uint8_t out[8];
+            EncodeHDRTexel(Vector3(value, 0.0f, 0.0f), out);
+            return static_cast<int>(out[3]);
+        };
+        const auto mantissaOf = [](float value) {
+            uint8_t out[8];
+            EncodeHDRTexel(Vector3(value, 0.0f, 0.0f), out);
+            return static_cast<int>(out[0]);
+        };
+
+        exponentThresholds[0] = -std::numeric_limits<float>::infinity();
+        mantissaThresholds[0] = -std::numeric_limits<float>::infinity();
+        for (int i = 1; i < 256; i++) {
+            exponentThresholds[i] = FindThreshold(0.0f, std::numeric_limits<float>::max(), i, exponentOf);
+            mantissaThresholds[i] = FindThreshold(0.0f, 1.0f, i, mantissaOf);
+        }
+        exponentThresholds[256] = std::numeric_limits<float>::quiet_NaN();
+        mantissaThresholds[256] = std::numeric_limits<float>::quiet_NaN();
+        for (int i = 0; i < 256; i++) {
+            const uint8_t exponent = static_cast<uint8_t>(i);
+            exponentScales[i] = i == 0 ? 1.0f : 1.0f / std::pow(2.0f, exponent / 8.0f);
+        }
+
+        FillBuckets(exponentThresholds, exponentBuckets, EXPONENT_BUCKETS, exponentSteps);
+        FillBuckets(mantissaThresholds, mantissaBuckets, MANTISSA_BUCKETS, mantissaSteps);
+        initialized = true;
+    }
+
+    /*
+        Bucket
+        Bucket of a float, negative and NaN inputs map to bucket 0
+    */
+    inline int Bucket(float value, int buckets) {
+        if (!(value > 0.0f)) {
+            return 0;
+        }
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return std::min(static_cast<int>(bits >> BUCKET_SHIFT), buckets - 1);
+    }
+
+    /*
+        Lookup
+        Largest index whose threshold is <= value
+    */
+    inline int Lookup(const float *thresholds, const int32_t *buckets, int bucketCount, float value) {
+        int index = buckets[Bucket(value, bucketCount)];
+        while (thresholds[index + 1] <= value) {
+            index++;
+        }
+        return index;
+    }
+
+    /*
+        EncodeTexel
+        Table driven EncodeHDRTexel
+    */
+    inline void EncodeTexel(const Vector3 &color, uint8_t *out) {
+        const float maxComponent = std::max({color.x(), color.y(), color.z()});
+        const int exponent = Lookup(exponentThresholds, exponentBuckets, EXPONENT_BUCKETS, maxComponent);
+        const float scale = exponentScales[exponent];
+
+        out[0] = static_cast<uint8_t>(Lookup(mantissaThresholds, mantissaBuckets, MANTISSA_BUCKETS, std::min(1.0f, std::max(0.0f, color.x() * scale))));
+        out[1] = static_cast<uint8_t>(Lookup(mantissaThresholds, mantissaBuckets, MANTISSA_BUCKETS, std::min(1.0f, std::max(0.0f, color.y() * scale))));
+        out[2] = static_cast<uint8_t>(Lookup(mantissaThresholds, mantissaBuckets, MANTISSA_BUCKETS, std::min(1.0f, std::max(0.0f, color.z() * scale))));
+        out[3] = static_cast<uint8_t>(exponent);
+        out[4] = out[0];
+        out[5] = out[1];
+        out[6] = out[2];
+        out[7] = out[3];
+    }
+
+#if defined(__AVX2__)
+    /*
+        Lookup8
+        Lookup for 8 values at once
+    */
+    inline __m256i Lookup8(const float *thresholds, const int32_t *buckets, int bucketCount, int steps, __m256 value) {
+        // max(x, 0) returns 0 for NaN, matching Bucket()
+        const __m256i bits = _mm256_castps_si256(_mm256_max_ps(value, _mm256_setzero_ps()));
+        const __m256i bucket = _mm256_min_epi32(_mm256_srli_epi32(bits, BUCKET_SHIFT), _mm256_set1_epi32(bucketCount - 1));
+        __m256i index = _mm256_i32gather_epi32(buckets, bucket, 4);
+        for (int step = 0; step < steps; step++) {
+            const __m256 threshold = _mm256_i32gather_ps(thresholds + 1, index, 4);
+            const __m256 mask = _mm256_cmp_ps(threshold, value, _CMP_LE_OQ);
+            index = _mm256_sub_epi32(index, _mm256_castps_si256(mask));
+        }
+        return index;
+    }
+#endif
+
+    /*
+        EncodeRow
+        Encodes count consecutive texels, 8 at a time when built with AVX2
+    */
+    void EncodeRow(const Vector3 *colors, int count, uint8_t *out) {
+        static_assert(sizeof(Vector3) == 3 * sizeof(float), "Vector3 must be tightly packed");
+        int i = 0;
+
+#if defined(__AVX2__)
+        const float *floats = reinterpret_cast<const float *>(colors);
+        const __m256i stride = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+
+        for (; i + 8 <= count; i += 8) {
+            const float *base = floats + i * 3;
+            const __m256 r = _mm256_i32gather_ps(base + 0, stride, 4);
+            const __m256 g = _mm256_i32gather_ps(base + 1, stride, 4);
+            const __m256 b = _mm256_i32gather_ps(base + 2, stride, 4);
+
+            const __m256i exponent = Lookup8(exponentThresholds, exponentBuckets, EXPONENT_BUCKETS, exponentSteps, _mm256_max_ps(_mm256_max_ps(r, g), b));
+            const __m256 scale = _mm256_i32gather_ps(exponentScales, exponent, 4);
+
+            // max(x, 0) returns 0 for NaN like std::max(0.0f, x)
+            const __m256 mr = _mm256_min_ps(one, _mm256_max_ps(_mm256_mul_ps(r, scale), zero));
+            const __m256 mg = _mm256_min_ps(one, _mm256_max_ps(_mm256_mul_ps(g, scale), zero));
+            const __m256 mb = _mm256_min_ps(one, _mm256_max_ps(_mm256_mul_ps(b, scale), zero));
+
+            alignas(32) int32_t lanes[4][8];
+            _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[0]), Lookup8(mantissaThresholds, mantissaBuckets, MANTISSA_BUCKETS, mantissaSteps, mr));
+            _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[1]), Lookup8(mantissaThresholds, mantissaBuckets, MANTISSA_BUCKETS, mantissaSteps, mg));
+            _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[2]), Lookup8(mantissaThresholds, mantissaBuckets, MANTISSA_BUCKETS, mantissaSteps, mb));
+            _mm256_store_si256(reinterpret_cast<__m256i *>(lanes[3]), exponent);
+
+            for (int lane = 0; lane < 8; lane++) {
+                uint8_t *texel = out + (i + lane) * 8;
+                texel[0] = texel[4] = static_cast<uint8_t>(lanes[0][lane]);
+                texel[1] = texel[5] = static_cast<uint8_t>(lanes[1][lane]);
+                texel[2] = texel[6] = static_cast<uint8_t>(lanes[2][lane]);
+                texel[3] = texel[7] = static_cast<uint8_t>(lanes[3][lane]);
+            }
+        }
+#endif
+
+        for (; i < count; i++) {
+            EncodeTexel(colors[i], out + i * 8);
+        }
+    }
+
+    /*
+        EncodeSurface
+        Worker for RunThreadsOnIndividual, surfaces own disjoint page rectangles
+    */
+    void EncodeSurface(int surfaceIndex);
+}
+
+
+void HDREncode::EncodeSurface(int surfaceIndex) {
+    const SurfaceLightmap_t &surf = LightmapBuild::surfaces[surfaceIndex];
+    ApexLegends::LightmapPage_t &page = ApexLegends::Bsp::lightmapPages[surf.rect.pageIndex];
+
+    for (int y = 0; y < surf.rect.height; y++) {
+        const int offset = ((surf.rect.y + y) * page.width + surf.rect.x) * 8;
+        EncodeRow(&surf.luxels[y * surf.rect.width], surf.rect.width, &page.pixels[offset]);
+    }
+}
+
+
+/*
+    HDREncodeTestMain
+    Checks EncodeTexel and EncodeRow bit for bit against EncodeHDRTexel
+    Components are random magnitudes across the whole exponent range, the
+    table thresholds and their neighbours, and special values
+*/
+int HDREncodeTestMain(Args &args) {
+    constexpr uint32_t COLOR_COUNT = 1 << 20;
+
+    HDREncode::Init();
+
+    // no +inf or NaN, EncodeHDRTexel converts their log2 to int
+    const float specials[] = {
+        0.0f, -0.0f, -1.0f, 0.001f, 1.0f, std::nextafter(1.0f, 2.0f), std::numeric_limits<float>::denorm_min(),
+        std::numeric_limits<float>::max(), -std::numeric_limits<float>::infinity()
+    };
+    const auto component = [&specials](uint32_t index) {
+        const uint32_t kind = BakeSampling::Hash(index * 2);
+        const uint32_t value = BakeSampling::Hash(index * 2 + 1);
+        switch (kind % 8) {
+        case 0:
+            return specials[value % std::size(specials)];
+        case 1: {
+            // a threshold or one of its neighbours
+            const float *thresholds = (value & 1) ? HDREncode::exponentThresholds : HDREncode::mantissaThresholds;
+            const float threshold = thresholds[1 + (value >> 2) % 255];
+            return (value & 2) ? std::nextafter(threshold, 0.0f) : threshold;
+        }
+        default:
+            // 2^-12 to 2^34, past the largest exponent of 2^(255/8)
+            return std::exp2(static_cast<float>(value >> 8) * (46.0f / 16777216.0f) - 12.0f);
+        }
+    };
+
+    std::vector<Vector3> colors(COLOR_COUNT);
+    for (uint32_t i = 0; i < COLOR_COUNT; i++) {
+        colors[i] = Vector3(component(i * 3), component(i * 3 + 1), component(i * 3 + 2));
+    }
+
+    std::vector<uint8_t> expected(COLOR_COUNT * 8), texels(COLOR_COUNT * 8), rows(COLOR_COUNT * 8);
+    for (uint32_t i = 0; i < COLOR_COUNT; i++) {
+        EncodeHDRTexel(colors[i], &expected[i * 8]);
+        HDREncode::EncodeTexel(colors[i], &texels[i * 8]);
+    }
+    // odd row length so the scalar tail runs after the 8 wide loop
+    constexpr int ROW_LENGTH = 1021;
+    for (uint32_t i = 0; i < COLOR_COUNT; i += ROW_LENGTH) {
+        HDREncode::EncodeRow(&colors[i], static_cast<int>(std::min<uint32_t>(ROW_LENGTH, COLOR_COUNT - i)), &rows[i * 8]);
+    }
+
+    const auto compare = [&colors, &expected](const char *name, const std::vector<uint8_t> &encoded) {
+        uint32_t mismatches = 0;
+        for (uint32_t i = 0; i < COLOR_COUNT; i++) {
+            if (std::memcmp(&expected[i * 8], &encoded[i * 8], 8) == 0) {
+                continue;
+            }
+            if (mismatches++ < 8) {
+                Sys_Printf("  %s mismatch at ( %.9g %.9g %.9g ): %02x %02x %02x %02x, expected %02x %02x %02x %02x\n", name,
+                           colors[i].x(), colors[i].y(), colors[i].z(),
+                           encoded[i * 8], encoded[i * 8 + 1], encoded[i * 8 + 2], encoded[i * 8 + 3],
+                           expected[i * 8], expected[i * 8 + 1], expected[i * 8 + 2], expected[i * 8 + 3]);
+            }
+        }
+        Sys_Printf("%9u of %u %s texels differ\n", mismatches, COLOR_COUNT, name);
+        return mismatches;
+    };
+
+#if defined(__AVX2__)
+    const char *rowPath = "avx2 row";
+#else
+    const char *rowPath = "scalar row";
+#endif
+    const uint32_t mismatches = compare("table", texels) + compare(rowPath, rows);
+    Sys_Printf("HDR encoder self-test %s\n", mismatches == 0 ? "passed" : "FAILED");
+    return mismatches == 0 ? 0 : 1;
+}
+
+
 /*
     EmitLightmaps
     Convert computed lighting to BSP format and write lumps
@@ -1230,22 +1658,16 @@ void ApexLegends::EmitLightmaps()
     }
     
     // Encode luxels to lightmap pages
-    for (SurfaceLightmap_t &surf : LightmapBuild::surfaces) {
-        ApexLegends::LightmapPage_t &page = ApexLegends::Bsp::lightmapPages[surf.rect.pageIndex];
-        
-        for (int y = 0; y < surf.rect.height; y++) {
-            for (int x = 0; x < surf.rect.width; x++) {
-                const Vector3 &color = surf.luxels[y * surf.rect.width + x];
-                
-                int px = surf.rect.x + x;
-                int py = surf.rect.y + y;
-                int offset = (py * page.width + px) * 8;
-                
-                EncodeHDRTexel(color, &page.pixels[offset]);
-            }
-        }
-    }
+    HDREncode::Init();
+    RunThreadsOnIndividual(static_cast<int>(LightmapBuild::surfaces.size()), false, HDREncode::EncodeSurface);
     
+    if (g_bCompressLightmaps) {
+        ApexLegends::CompressLightmapPages();
+        Sys_Printf("     %9zu lightmap pages\n", ApexLegends::Bsp::lightmapHeaders.size());
+        Sys_Printf("     %9zu bytes data\n", ApexLegends::Bsp::lightmapDataSky.size());
+        return;
+    }
+
     // Create headers and concatenate pixel data
     for (size_t i = 0; i < ApexLegends::Bsp::lightmapPages.size(); i++) {
         const ApexLegends::LightmapPage_t &page = ApexLegends::Bsp::lightmapPages[i];
@@ -1591,17 +2013,21 @@ static bool TraceRayAgainstMeshes(const Vector3 &origin, const Vector3 &dir, flo
 */
 static void ComputeAmbientFromSphericalSamples(const Vector3 &position, 
                                                 const SkyEnvironment &sky,
+                                                uint32_t probeIndex,
                                                 Vector3 lightBoxColor[6]) {
     // Initialize cube to zero
     for (int i = 0; i < 6; i++) {
         lightBoxColor[i] = Vector3(0, 0, 0);
     }
     
-    // Sample lighting from 162 uniformly distributed directions
+    // Sample lighting from 162 uniformly distributed directions, rotated per
+    // probe so neighbouring probes don't share the same blind spots
+    const BakeSampling::Rotation_t rotation(BakeSampling::STAGE_PROBE_DIRECTIONS, probeIndex, 0);
+    Vector3 directions[NUM_SPHERE_NORMALS];
     Vector3 radcolor[NUM_SPHERE_NORMALS];
     
     for (int i = 0; i < NUM_SPHERE_NORMALS; i++) {
-        const Vector3 &dir = g_SphereNormals[i];
+        const Vector3 &dir = directions[i] = rotation.Apply(g_SphereNormals[i]);
         radcolor[i] = Vector3(0, 0, 0);
         
         // Trace ray in this direction with offset to avoid self-intersection
@@ -1639,7 +2065,7 @@ static void ComputeAmbientFromSphericalSamples(const Vector3 &position,
         float totalWeight = 0.0f;
         
         for (int i = 0; i < NUM_SPHERE_NORMALS; i++) {
-            float weight = vector3_dot(g_SphereNormals[i], g_BoxDirections[j]);
+            float weight = vector3_dot(directions[i], g_BoxDirections[j]);
             if (weight > 0) {
                 totalWeight += weight;
                 lightBoxColor[j] = lightBoxColor[j] + radcolor[i] * weight;
@@ -1740,11 +2166,375 @@ static void ConvertCubeToSphericalHarmonics(const Vector3 lightBoxColor[6],
     }
 }
 
+/*
+    BrushSolid
+    Point classification against the solid worldspawn brushes. The brushes
+    are kept as half-space lists with their face windings and sorted into a
+    median split BVH, so inside tests and nearest surface queries only touch
+    the few brushes around the query point. Drawn geometry that isn't a solid
+    brush (patches, translucent or non solid brushes) goes into a second BVH
+    of single faces, which counts towards surface distances but has no inside.
+*/
+namespace BrushSolid {
+    constexpr float  INSIDE_EPSILON = 0.1f;   // Points closer than this to a face count as outside
+    constexpr size_t LEAF_SIZE = 4;
+
+    struct Face_t {
+        Plane3f              plane;
+        std::vector<Vector3> points;
+    };
+
+    struct Brush_t {
+        MinMax              bounds;
+        std::vector<Plane3f> planes;  // All sides, bevels included, empty for surfaces
+        std::vector<Face_t> faces;    // Sides with a valid winding
+    };
+
+    struct Node_t {
+        MinMax   bounds;
+        uint32_t first;   // Leaf: first brush, interior: second child
+        uint32_t count;   // Leaf: brush count, interior: 0
+    };
+
+    struct Tree_t {
+        std::vector<Brush_t> brushes;
+        std::vector<Node_t>  nodes;
+        bool                 twoSided;  // Faces have no back side to push along the normal from
+    };
+
+    Tree_t solids   = { {}, {}, false };
+    Tree_t surfaces = { {}, {}, true };
+
+    bool IsReady() {
+        return !solids.nodes.empty();
+    }
+
+    void Clear() {
+        for (Tree_t *tree : { &solids, &surfaces }) {
+            tree->brushes.clear();
+            tree->nodes.clear();
+        }
+    }
+
+    void BuildNode(Tree_t &tree, size_t first, size_t count) {
+        std::vector<Brush_t> &brushes = tree.brushes;
+        std::vector<Node_t> &nodes = tree.nodes;
+        const size_t index = nodes.size();
+        nodes.emplace_back();
+
+        MinMax bounds;
+        for (size_t i = first; i < first + count; i++) {
+            bounds.extend(brushes[i].bounds.mins);
+            bounds.extend(brushes[i].bounds.maxs);
+        }
+        nodes[index].bounds = bounds;
+
+        if (count <= LEAF_SIZE) {
+            nodes[index].first = static_cast<uint32_t>(first);
+            nodes[index].count = static_cast<uint32_t>(count);
+            return;
+        }
+
+        const Vector3 size = bounds.maxs - bounds.mins;
+        int axis = 0;
+        if (size[1] > size[axis]) axis = 1;
+        if (size[2] > size[axis]) axis = 2;
+
+        const size_t half = count / 2;
+        std::nth_element(brushes.begin() + first, brushes.begin() + first + half, brushes.begin() + first + count,
+            [axis](const Brush_t &a, const Brush_t &b) {
+                return a.bounds.mins[axis] + a.bounds.maxs[axis] < b.bounds.mins[axis] + b.bounds.maxs[axis];
+            });
+
+        nodes[index].count = 0;
+        BuildNode(tree, first, half);
+        nodes[index].first = static_cast<uint32_t>(nodes.size());
+        BuildNode(tree, first + half, count - half);
+    }
+
+    void BuildTree(Tree_t &tree) {
+        if (!tree.brushes.empty()) {
+            tree.nodes.reserve(2 * (tree.brushes.size() / LEAF_SIZE + 1));
+            BuildNode(tree, 0, tree.brushes.size());
+        }
+    }
+
+    /*
+        AddSurface
+        Adds a single face to the surface tree, degenerate faces are skipped
+    */
+    void AddSurface(const Vector3 *points, size_t numPoints) {
+        Plane3f plane;
+        if (numPoints < 3 || !PlaneFromPoints(plane, points[0], points[1], points[2])) {
+            return;
+        }
+
+        Brush_t &surface = surfaces.brushes.emplace_back();
+        Face_t &face = surface.faces.emplace_back();
+        face.plane = plane;
+        face.points.assign(points, points + numPoints);
+        for (const Vector3 &point : face.points) {
+            surface.bounds.extend(point);
+        }
+    }
+
+    /*
+        Build
+        Collects the opaque solid brushes of the worldspawn and builds the BVH,
+        the rest of the worldspawn geometry MakeMeshes draws goes into the surface tree
+    */
+    void Build() {
+        Clear();
+        if (entities.empty()) {
+            return;
+        }
+
+        for (const brush_t &brush : entities[0].brushes) {
+            if (!(brush.compileFlags & C_SOLID) || !brush.opaque || !brush.minmax.valid()) {
+                for (const side_t &side : brush.sides) {
+                    if (!side.bevel && !(side.shaderInfo->compileFlags & C_NODRAW)) {
+                        AddSurface(side.winding.data(), side.winding.size());
+                    }
+                }
+                continue;
+            }
+
+            Brush_t &solid = solids.brushes.emplace_back();
+            solid.bounds = brush.minmax;
+            for (const side_t &side : brush.sides) {
+                const Plane3f &plane = mapplanes[side.planenum].plane;
+                solid.planes.push_back(plane);
+                if (!side.bevel && side.winding.size() >= 3) {
+                    Face_t &face = solid.faces.emplace_back();
+                    face.plane = plane;
+                    face.points.assign(side.winding.begin(), side.winding.end());
+                }
+            }
+        }
+
+        // Patches, triangulated the same way as in MakeMeshes
+        for (const parseMesh_t *patch = entities[0].patches; patch != NULL; patch = patch->next) {
+            const mesh_t &mesh = patch->mesh;
+            for (int x = 0; x < mesh.width - 1; x++) {
+                for (int y = 0; y < mesh.height - 1; y++) {
+                    const int index = x + y * mesh.width;
+                    const Vector3 first[3] = { mesh.verts[index].xyz, mesh.verts[index + mesh.width].xyz, mesh.verts[index + mesh.width + 1].xyz };
+                    const Vector3 second[3] = { mesh.verts[index].xyz, mesh.verts[index + mesh.width + 1].xyz, mesh.verts[index + 1].xyz };
+                    AddSurface(first, 3);
+                    AddSurface(second, 3);
+                }
+            }
+        }
+
+        BuildTree(solids);
+        BuildTree(surfaces);
+
+        Sys_FPrintf(SYS_VRB, "     Built solid brush BVH: %zu brushes, %zu nodes\n", solids.brushes.size(), solids.nodes.size());
+        Sys_FPrintf(SYS_VRB, "     Built surface BVH: %zu faces, %zu nodes\n", surfaces.brushes.size(), surfaces.nodes.size());
+    }
+
+    bool PointInBounds(const MinMax &bounds, const Vector3 &point) {
+        return point[0] >= bounds.mins[0] && point[0] <= bounds.maxs[0]
+            && point[1] >= bounds.mins[1] && point[1] <= bounds.maxs[1]
+            && point[2] >= bounds.mins[2] && point[2] <= bounds.maxs[2];
+    }
+
+    float DistanceToBoundsSquared(const MinMax &bounds, const Vector3 &point) {
+        float distSq = 0.0f;
+        for (int i = 0; i < 3; i++) {
+            float d = std::max(std::max(bounds.mins[i] - point[i], point[i] - bounds.maxs[i]), 0.0f);
+            distSq += d * d;
+        }
+        return distSq;
+    }
+
+    bool PointInBrush(const Brush_t &brush, const Vector3 &point) {
+        for (const Plane3f &plane : brush.planes) {
+            if (static_cast<float>(plane3_distance_to_point(plane, point)) > -INSIDE_EPSILON) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+        ClosestPointOnFace
+        Closest point to a point on a convex face winding
+    */
+    Vector3 ClosestPointOnFace(const Face_t &face, const Vector3 &point) {
+        const Vector3 &normal = face.plane.normal();
+        const Vector3 projected = point - normal * static_cast<float>(plane3_distance_to_point(face.plane, point));
+
+        // Projected point is inside when it lies on the same side of every edge
+        bool positive = false, negative = false;
+        const size_t numPoints = face.points.size();
+        for (size_t i = 0; i < numPoints; i++) {
+            const Vector3 &a = face.points[i];
+            const Vector3 &b = face.points[(i + 1) % numPoints];
+            float side = static_cast<float>(vector3_dot(vector3_cross(b - a, projected - a), normal));
+            positive |= side > 0.0f;
+            negative |= side < 0.0f;
+        }
+        if (!(positive && negative)) {
+            return projected;
+        }
+
+        // Otherwise it's on one of the edges
+        Vector3 closest = face.points[0];
+        float closestDistSq = FLT_MAX;
+        for (size_t i = 0; i < numPoints; i++) {
+            const Vector3 &a = face.points[i];
+            const Vector3 edge = face.points[(i + 1) % numPoints] - a;
+            float lengthSq = static_cast<float>(vector3_length_squared(edge));
+            float t = lengthSq > 0.0f ? static_cast<float>(vector3_dot(point - a, edge)) / lengthSq : 0.0f;
+            Vector3 candidate = a + edge * std::clamp(t, 0.0f, 1.0f);
+            float distSq = static_cast<float>(vector3_length_squared(point - candidate));
+            if (distSq < closestDistSq) {
+                closestDistSq = distSq;
+                closest = candidate;
+            }
+        }
+        return closest;
+    }
+
+    /*
+        PointInSolid
+        Returns true if the point is strictly inside any solid brush
+    */
+    bool PointInSolid(const Vector3 &point) {
+        const std::vector<Brush_t> &brushes = solids.brushes;
+        const std::vector<Node_t> &nodes = solids.nodes;
+        if (nodes.empty()) {
+            return false;
+        }
+
+        uint32_t stack[64];
+        int depth = 0;
+        stack[depth++] = 0;
+        while (depth > 0) {
+            const uint32_t index = stack[--depth];
+            const Node_t &node = nodes[index];
+            if (!PointInBounds(node.bounds, point)) {
+                continue;
+            }
+            if (node.count != 0) {
+                for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                    if (PointInBounds(brushes[i].bounds, point) && PointInBrush(brushes[i], point)) {
+                        return true;
+                    }
+                }
+            } else {
+                stack[depth++] = node.first;
+                stack[depth++] = index + 1;
+            }
+        }
+        return false;
+    }
+
+    /*
+        NearestFace
+        Tightens bestDistSq to the nearest face of the tree, returns true if one was closer
+    */
+    bool NearestFace(const Tree_t &tree, const Vector3 &point, float &bestDistSq, Vector3 &outPushDir) {
+        const std::vector<Brush_t> &brushes = tree.brushes;
+        const std::vector<Node_t> &nodes = tree.nodes;
+        if (nodes.empty()) {
+            return false;
+        }
+
+        bool found = false;
+
+        uint32_t stack[64];
+        int depth = 0;
+        stack[depth++] = 0;
+        while (depth > 0) {
+            const uint32_t index = stack[--depth];
+            const Node_t &node = nodes[index];
+            if (DistanceToBoundsSquared(node.bounds, point) >= bestDistSq) {
+                continue;
+            }
+            if (node.count == 0) {
+                // Visit the nearer child first so it tightens the bound early
+                const uint32_t a = index + 1, b = node.first;
+                if (DistanceToBoundsSquared(nodes[a].bounds, point) < DistanceToBoundsSquared(nodes[b].bounds, point)) {
+                    stack[depth++] = b;
+                    stack[depth++] = a;
+                } else {
+                    stack[depth++] = a;
+                    stack[depth++] = b;
+                }
+                continue;
+            }
+
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                const Brush_t &brush = brushes[i];
+                if (DistanceToBoundsSquared(brush.bounds, point) >= bestDistSq) {
+                    continue;
+                }
+                for (const Face_t &face : brush.faces) {
+                    float planeDist = static_cast<float>(plane3_distance_to_point(face.plane, point));
+                    if (planeDist * planeDist >= bestDistSq) {
+                        continue;
+                    }
+                    Vector3 closest = ClosestPointOnFace(face, point);
+                    Vector3 delta = point - closest;
+                    float distSq = static_cast<float>(vector3_length_squared(delta));
+                    if (distSq < bestDistSq) {
+                        bestDistSq = distSq;
+                        found = true;
+                        // Push along the face normal when on the face or behind a brush face
+                        const bool away = distSq > 1e-6f && (tree.twoSided || planeDist > INSIDE_EPSILON);
+                        outPushDir = away ? delta / std::sqrt(distSq) : face.plane.normal();
+                    }
+                }
+            }
+        }
+
+        return found;
+    }
+
+    /*
+        DistanceToSurface
+        Unsigned distance to the nearest brush face or surface within maxDist,
+        FLT_MAX if there is none. outPushDir points away from that face.
+    */
+    float DistanceToSurface(const Vector3 &point, float maxDist, Vector3 &outPushDir) {
+        outPushDir = Vector3(0, 0, 0);
+
+        float bestDistSq = maxDist * maxDist;
+        bool found = NearestFace(solids, point, bestDistSq, outPushDir);
+        found |= NearestFace(surfaces, point, bestDistSq, outPushDir);
+
+        return found ? std::sqrt(bestDistSq) : FLT_MAX;
+    }
+
+    /*
+        NearSurface
+        Returns true if a surface that isn't a solid brush lies within maxDist
+    */
+    bool NearSurface(const Vector3 &point, float maxDist) {
+        float bestDistSq = maxDist * maxDist;
+        Vector3 pushDir;
+        return NearestFace(surfaces, point, bestDistSq, pushDir);
+    }
+}
+
 /*
     IsPositionInsideSolid
-    Check if a position is inside solid geometry using 6-directional ray tests.
+    Check if a position is inside solid geometry. Uses the brush BVH when it
+    has been built, otherwise falls back to 6-directional ray tests. The ray
+    tests still run near surfaces the brush BVH doesn't cover, like patches.
 */
 static bool IsPositionInsideSolid(const Vector3 &pos, float testDist = 32.0f) {
+    if (BrushSolid::IsReady()) {
+        if (BrushSolid::PointInSolid(pos)) {
+            return true;
+        }
+        if (!BrushSolid::NearSurface(pos, testDist + 2.0f)) {
+            return false;
+        }
+    }
+
     // Trace in all 6 cardinal directions - if all hit nearby, we're inside solid
     // Use small offset to avoid false positives from nearby surfaces
     float offset = 2.0f;
@@ -1760,10 +2550,14 @@ static bool IsPositionInsideSolid(const Vector3 &pos, float testDist = 32.0f) {
 
 /*
     GetDistanceToNearestSurface
-    Returns approximate distance to nearest geometry in any direction.
-    Also returns push direction to move away from surfaces.
+    Returns distance to nearest geometry in any direction, exact when the
+    brush BVH has been built. Also returns push direction to move away from surfaces.
 */
 static float GetDistanceToNearestSurface(const Vector3 &pos, Vector3 &outPushDir) {
+    if (BrushSolid::IsReady()) {
+        return BrushSolid::DistanceToSurface(pos, 512.0f, outPushDir);
+    }
+
     float minDist = FLT_MAX;
     outPushDir = Vector3(0, 0, 0);
     
@@ -1830,6 +2624,104 @@ static Vector3 PushProbeAwayFromSurfaces(const Vector3 &pos, float minDistance)
     return result;
 }
 
+/*
+    ProbeKMeans
+    Lloyd iteration assignment step for GenerateProbePositionsVoronoi
+
+    Uses Hamerly's bounds to skip most nearest centroid searches: every point
+    keeps an upper bound on the distance to its centroid and a lower bound on
+    the distance to any other. Bounds are loosened by how far centroids moved,
+    a full search is only needed when they overlap. Points are assigned in
+    chunks on worker threads, each point is only written by its own chunk so
+    the result doesn't depend on the thread count.
+*/
+namespace ProbeKMeans {
+    constexpr size_t CHUNK_SIZE = 4096;
+
+    const std::vector<Vector3> *points = nullptr;
+    const std::vector<Vector3> *centroids = nullptr;
+    std::vector<int>   assignments;
+    std::vector<float> upper;        // Distance to the assigned centroid, or more
+    std::vector<float> lower;        // Distance to the second nearest centroid, or less
+    std::vector<float> moves;        // How far each centroid moved in the last update
+    std::vector<float> halfNearest;  // Half distance from each centroid to its nearest neighbour
+    bool firstIteration = true;
+    std::atomic<size_t> fullSearches{0};
+
+    void Clear() {
+        points = nullptr;
+        centroids = nullptr;
+        assignments.clear();
+        upper.clear();
+        lower.clear();
+        moves.clear();
+        halfNearest.clear();
+        fullSearches = 0;
+    }
+
+    void AssignChunk(int chunk) {
+        const std::vector<Vector3> &centers = *centroids;
+
+        // Largest and second largest move, the point assigned to the largest
+        // mover only needs the second for its lower bound
+        size_t maxIndex = 0;
+        float maxMove = 0.0f, secondMove = 0.0f;
+        for (size_t c = 0; c < moves.size(); c++) {
+            if (moves[c] > maxMove) {
+                secondMove = maxMove;
+                maxMove = moves[c];
+                maxIndex = c;
+            } else if (moves[c] > secondMove) {
+                secondMove = moves[c];
+            }
+        }
+
+        const size_t first = static_cast<size_t>(chunk) * CHUNK_SIZE;
+        const size_t last = std::min(points->size(), first + CHUNK_SIZE);
+        size_t searches = 0;
+
+        for (size_t i = first; i < last; i++) {
+            const Vector3 &point = (*points)[i];
+
+            if (!firstIteration) {
+                const int a = assignments[i];
+                upper[i] += moves[a];
+                lower[i] -= (static_cast<size_t>(a) == maxIndex) ? secondMove : maxMove;
+
+                const float bound = std::max(halfNearest[a], lower[i]);
+                if (upper[i] <= bound) {
+                    continue;
+                }
+                upper[i] = vector3_length(point - centers[a]);
+                if (upper[i] <= bound) {
+                    continue;
+                }
+            }
+
+            // Full search, same tie breaking as a plain linear scan
+            float nearestSq = FLT_MAX, secondSq = FLT_MAX;
+            int nearest = 0;
+            for (size_t c = 0; c < centers.size(); c++) {
+                Vector3 delta = point - centers[c];
+                float dist = vector3_dot(delta, delta);
+                if (dist < nearestSq) {
+                    secondSq = nearestSq;
+                    nearestSq = dist;
+                    nearest = static_cast<int>(c);
+                } else if (dist < secondSq) {
+                    secondSq = dist;
+                }
+            }
+            assignments[i] = nearest;
+            upper[i] = std::sqrt(nearestSq);
+            lower[i] = std::sqrt(secondSq);
+            searches++;
+        }
+
+        fullSearches += searches;
+    }
+}
+
 /*
     GenerateProbePositionsVoronoi
     Generate light probe positions using Voronoi-based adaptive placement.
@@ -1938,7 +2830,9 @@ static void GenerateProbePositionsVoronoi(const MinMax &worldBounds,
     centroids.reserve(targetProbes);
     
     // First centroid: random sample
-    centroids.push_back(candidatePositions[0]);
+    const size_t first = std::min(candidatePositions.size() - 1,
+        static_cast<size_t>(BakeSampling::Random01(BakeSampling::STAGE_PROBE_SEEDING, 0, 0) * candidatePositions.size()));
+    centroids.push_back(candidatePositions[first]);
     
     // K-means++ seeding: each new centroid is chosen with probability proportional
     // to squared distance from nearest existing centroid
@@ -1959,7 +2853,7 @@ static void GenerateProbePositionsVoronoi(const MinMax &worldBounds,
         if (totalWeight < 0.001f) break;
         
         // Pick next centroid with probability proportional to D^2
-        float threshold = (float)(centroids.size() * 7919 % 10000) / 10000.0f * totalWeight;
+        float threshold = BakeSampling::Random01(BakeSampling::STAGE_PROBE_SEEDING, 0, static_cast<uint32_t>(centroids.size())) * totalWeight;
         float cumulative = 0;
         size_t chosen = 0;
         
@@ -1985,57 +2879,69 @@ static void GenerateProbePositionsVoronoi(const MinMax &worldBounds,
     // Step 4: Lloyd relaxation (K-means iterations)
     // =========================================================================
     constexpr int MAX_LLOYD_ITERATIONS = 10;
+    constexpr float LLOYD_CONVERGENCE = 1.0f;  // Stop once no centroid moves further than this
     
-    std::vector<int> assignments(candidatePositions.size(), -1);
+    ProbeKMeans::points = &candidatePositions;
+    ProbeKMeans::centroids = &centroids;
+    ProbeKMeans::assignments.assign(candidatePositions.size(), -1);
+    ProbeKMeans::upper.assign(candidatePositions.size(), 0.0f);
+    ProbeKMeans::lower.assign(candidatePositions.size(), 0.0f);
+    ProbeKMeans::moves.assign(centroids.size(), 0.0f);
+    ProbeKMeans::halfNearest.resize(centroids.size());
+
     std::vector<Vector3> newCentroids(centroids.size());
     std::vector<int> clusterCounts(centroids.size());
+    const int numChunks = static_cast<int>((candidatePositions.size() + ProbeKMeans::CHUNK_SIZE - 1) / ProbeKMeans::CHUNK_SIZE);
     
     for (int iter = 0; iter < MAX_LLOYD_ITERATIONS; iter++) {
-        // Assign each candidate to nearest centroid
-        for (size_t i = 0; i < candidatePositions.size(); i++) {
-            float minDist = FLT_MAX;
-            int nearest = 0;
-            
-            for (size_t c = 0; c < centroids.size(); c++) {
-                Vector3 delta = candidatePositions[i] - centroids[c];
-                float dist = vector3_dot(delta, delta);
-                if (dist < minDist) {
-                    minDist = dist;
-                    nearest = static_cast<int>(c);
+        // Half the distance from each centroid to its nearest neighbour, a point
+        // closer than that to its centroid can't be closer to any other
+        for (size_t c = 0; c < centroids.size(); c++) {
+            float nearest = FLT_MAX;
+            for (size_t o = 0; o < centroids.size(); o++) {
+                if (o != c) {
+                    Vector3 delta = centroids[c] - centroids[o];
+                    nearest = std::min(nearest, static_cast<float>(vector3_dot(delta, delta)));
                 }
             }
-            
-            assignments[i] = nearest;
+            ProbeKMeans::halfNearest[c] = 0.5f * std::sqrt(nearest);
         }
+
+        // Assign each candidate to nearest centroid
+        ProbeKMeans::firstIteration = iter == 0;
+        RunThreadsOnIndividual(numChunks, false, ProbeKMeans::AssignChunk);
         
         // Compute new centroids as cluster means
         std::fill(newCentroids.begin(), newCentroids.end(), Vector3(0, 0, 0));
         std::fill(clusterCounts.begin(), clusterCounts.end(), 0);
         
         for (size_t i = 0; i < candidatePositions.size(); i++) {
-            int c = assignments[i];
+            int c = ProbeKMeans::assignments[i];
             newCentroids[c] = newCentroids[c] + candidatePositions[i];
             clusterCounts[c]++;
         }
         
-        // Update centroids
+        // Update centroids, remembering how far each moved to loosen the bounds
         float maxMove = 0;
         for (size_t c = 0; c < centroids.size(); c++) {
+            ProbeKMeans::moves[c] = 0.0f;
             if (clusterCounts[c] > 0) {
                 Vector3 updated = newCentroids[c] * (1.0f / clusterCounts[c]);
-                Vector3 delta = updated - centroids[c];
-                float moveDist = static_cast<float>(vector3_dot(delta, delta));
-                maxMove = std::max(maxMove, moveDist);
+                ProbeKMeans::moves[c] = vector3_length(updated - centroids[c]);
+                maxMove = std::max(maxMove, ProbeKMeans::moves[c]);
                 centroids[c] = updated;
             }
         }
         
         // Convergence check
-        if (maxMove < 1.0f) {
+        if (maxMove < LLOYD_CONVERGENCE) {
             Sys_Printf("     Lloyd converged after %d iterations\n", iter + 1);
             break;
         }
     }
+
+    Sys_Printf("     %zu full nearest centroid searches\n", static_cast<size_t>(ProbeKMeans::fullSearches));
+    ProbeKMeans::Clear();
     
     // =========================================================================
     // Step 5: Filter final positions and enforce minimum spacing
@@ -2281,7 +3187,9 @@ void ApexLegends::EmitLightProbes() {
     } else {
         // No manual probes - generate Voronoi-based adaptive placement
         Sys_Printf("     No info_lightprobe entities, generating Voronoi-based placement...\n");
+        BrushSolid::Build();
         GenerateProbePositionsVoronoi(worldBounds, probePositions);
+        BrushSolid::Clear();
     }
     
     // Ensure we have at least one probe
@@ -2314,7 +3222,7 @@ void ApexLegends::EmitLightProbes() {
         
         // Compute ambient using Source SDK style spherical sampling
         // This samples 162 directions and accumulates into 6-sided cube
-        ComputeAmbientFromSphericalSamples(pos, sky, candidate.cube);
+        ComputeAmbientFromSphericalSamples(pos, sky, static_cast<uint32_t>(i), candidate.cube);
         
         candidates.push_back(candidate);
         
@@ -2374,15 +3282,50 @@ void ApexLegends::EmitLightProbes() {
     
     // Export probe positions for visualization in Radiant
     if (!ApexLegends::Bsp::lightprobeReferences.empty()) {
-        // Write .probes file (simple XYZ format, one probe per line)
-        const auto probesFilename = StringStream(source, ".probes");
+        // Write binary .probes file, see include/probefile.h
+        const auto binaryFilename = StringStream(source, ".probes");
+        FILE *binaryFile = fopen(binaryFilename, "wb");
+        if (binaryFile) {
+            Sys_Printf("     Writing probe positions to %s\n", binaryFilename.c_str());
+
+            ProbeFileHeader header;
+            memcpy(header.magic, PROBEFILE_MAGIC, sizeof(header.magic));
+            header.version = PROBEFILE_VERSION;
+            header.probeCount = static_cast<uint32_t>(ApexLegends::Bsp::lightprobeReferences.size());
+            header.probeSize = sizeof(ProbeFileProbe);
+
+            std::vector<ProbeFileProbe> records(header.probeCount);
+            for (size_t i = 0; i < records.size(); i++) {
+                const LightProbeRef_t &ref = ApexLegends::Bsp::lightprobeReferences[i];
+                ProbeFileProbe &record = records[i];
+                record.origin[0] = ref.origin[0];
+                record.origin[1] = ref.origin[1];
+                record.origin[2] = ref.origin[2];
+                if (ref.lightProbeIndex < ApexLegends::Bsp::lightprobes.size()) {
+                    memcpy(record.ambientSH, ApexLegends::Bsp::lightprobes[ref.lightProbeIndex].ambientSH, sizeof(record.ambientSH));
+                }
+                else {
+                    memset(record.ambientSH, 0, sizeof(record.ambientSH));
+                }
+            }
+
+            fwrite(&header, sizeof(header), 1, binaryFile);
+            fwrite(records.data(), sizeof(ProbeFileProbe), records.size(), binaryFile);
+            fclose(binaryFile);
+        } else {
+            Sys_Warning("Could not write probe file: %s\n", binaryFilename.c_str());
+        }
+    }
+    if (g_bTextProbes && !ApexLegends::Bsp::lightprobeReferences.empty()) {
+        // Write .probes.txt file (simple XYZ format, one probe per line)
+        const auto probesFilename = StringStream(source, ".probes.txt");
         FILE *probesFile = fopen(probesFilename, "w");
         if (probesFile) {
             Sys_Printf("     Writing probe positions to %s\n", probesFilename.c_str());
             
             // Header comment
             fprintf(probesFile, "# Light probe positions exported by remap\n");
-            fprintf(probesFile, "# Format: X Y Z [R G B] (RGB is average ambient color, optional)\n");
+            fprintf(probesFile, "# Format: X Y Z [R G B [SH]] (RGB is average ambient color, SH is ambientSH[3][4] / 32767, both optional)\n");
             fprintf(probesFile, "# Total probes: %zu\n", ApexLegends::Bsp::lightprobeReferences.size());
             
             for (size_t i = 0; i < ApexLegends::Bsp::lightprobeReferences.size(); i++) {
@@ -2390,8 +3333,14 @@ void ApexLegends::EmitLightProbes() {
                 
                 // Get the probe's ambient color from spherical harmonics (DC term)
                 float r = 0.5f, g = 0.5f, b = 0.5f;  // default gray
+                float sh[3][4] = {};
                 if (ref.lightProbeIndex < ApexLegends::Bsp::lightprobes.size()) {
                     const LightProbe_v50_t &probe = ApexLegends::Bsp::lightprobes[ref.lightProbeIndex];
+                    for (int channel = 0; channel < 3; channel++) {
+                        for (int coefficient = 0; coefficient < 4; coefficient++) {
+                            sh[channel][coefficient] = (float)probe.ambientSH[channel][coefficient] / 32767.0f;
+                        }
+                    }
                     // SH DC term is the average ambient - extract from coefficient 0
                     // ambientSH[channel][coefficient] where channel 0=R, 1=G, 2=B
                     // The DC coefficient (index 0) represents average irradiance
@@ -2400,13 +3349,18 @@ void ApexLegends::EmitLightProbes() {
                     b = std::min(1.0f, std::max(0.0f, (float)probe.ambientSH[2][0] / 32767.0f));
                 }
                 
-                fprintf(probesFile, "%.2f %.2f %.2f %.3f %.3f %.3f\n", 
+                fprintf(probesFile, "%.2f %.2f %.2f %.3f %.3f %.3f",
                         ref.origin[0], ref.origin[1], ref.origin[2],
                         r, g, b);
+                for (int channel = 0; channel < 3; channel++) {
+                    for (int coefficient = 0; coefficient < 4; coefficient++) {
+                        fprintf(probesFile, " %.4f", sh[channel][coefficient]);
+                    }
+                }
+                fprintf(probesFile, "\n");
             }
             
             fclose(probesFile);
-            Sys_Printf("     Probe positions exported for Radiant visualization\n");
         } else {
             Sys_Warning("Could not write probe file: %s\n", probesFilename.c_str());
         }
@@ -2525,4 +3479,4 @@ void ApexLegends::EmitRealTimeLightmaps() {
     // 1. Proper BC7 compression for texture 1 (light influence gradients)
     // 2. Proper BC4 compression for texture 2 (additional mask data)
     // Without proper BC-compressed textures, the engine shows striping artifacts
-}
\ No newline at end of file
+}
@@ -817,6 +817,22 @@ int BSPMain( Args& args ){
 			Sys_Printf( "External models enabled\n" );
 			g_bExternalModels = true;
 		}
+		while ( args.takeArg( "-compresslightmaps" ) ) {
+			Sys_Printf( "BC6H lightmap compression enabled\n" );
+			g_bCompressLightmaps = true;
+		}
+		while ( args.takeArg( "-textprobes" ) ) {
+			Sys_Printf( "Text light probe export enabled\n" );
+			g_bTextProbes = true;
+		}
+		while ( args.takeArg( "-seed" ) ) {
+			g_bakeSeed = static_cast<std::uint32_t>( strtoul( args.takeNext(), nullptr, 0 ) );
+			Sys_Printf( "Bake sampling seed set to %u\n", g_bakeSeed );
+		}
+		while ( args.takeArg( "-compressquality" ) ) {
+			g_lightmapCompressQuality = std::clamp( atoi( args.takeNext() ), 0, 2 );
+			Sys_Printf( "Lightmap compression quality set to %d\n", g_lightmapCompressQuality );
+		}
 		// complain if there's args remaning
 		while( !args.empty() )
 		{
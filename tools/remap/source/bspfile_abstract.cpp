@@ -337,8 +337,17 @@ static bool ParseEntity() {
    parses the bsp entity data string into entities
 */
 void ParseEntities() {
+    ParseEntities(Titanfall::Bsp::entities);
+}
+
+
+/*
+   ParseEntities()
+   parses an entity data string into entities
+*/
+void ParseEntities(const std::vector<char> &data) {
     entities.clear();
-    ParseFromMemory(Titanfall::Bsp::entities.data(), Titanfall::Bsp::entities.size());
+    ParseFromMemory(const_cast<char*>(data.data()), data.size());  // copied by the parser
     while (ParseEntity()) {};
 
     /* ydnar: set number of bsp entities in case a map is loaded on top */
@@ -23,6 +23,9 @@
 
 #include "remap.h"
 #include "bspfile_abstract.h"
+#include "model.h"
+#include <map>
+#include <optional>
 
 
 /*
@@ -187,6 +190,7 @@ void Shared::MakeMeshes(const entity_t &e) {
             Shared::Mesh_t &mesh2 = Shared::meshes.at(i);
 
             if (mesh1.triangles.size() + mesh2.triangles.size() > 63000
+             || mesh1.vertices.size() + mesh2.vertices.size() > Shared::MESH_MAX_VERTICES
              || mesh1.lightmapPage != mesh2.lightmapPage
              || !striEqual(mesh1.shaderInfo->shader.c_str(), mesh2.shaderInfo->shader.c_str())
              || !mesh1.minmax.test(mesh2.minmax)) {
@@ -194,7 +198,7 @@ void Shared::MakeMeshes(const entity_t &e) {
             }
 
             // All tests passed! We can combine these meshes
-            for (uint16_t &triIndex : mesh2.triangles) {
+            for (uint32_t triIndex : mesh2.triangles) {
                 mesh1.triangles.emplace_back(triIndex + mesh1.vertices.size());
             }
             mesh1.vertices.insert(mesh1.vertices.end(), mesh2.vertices.begin(), mesh2.vertices.end());
@@ -210,6 +214,10 @@ void Shared::MakeMeshes(const entity_t &e) {
         index++;
     }
 
+    // Keep every mesh addressable with 16 bit indices and reorder for the vertex cache
+    Shared::SplitMeshes();
+    Shared::OptimizeMeshes();
+
     // sort meshes
     std::vector<Shared::Mesh_t>  opaque_meshes;
     std::vector<Shared::Mesh_t>  decal_meshes;
@@ -243,6 +251,261 @@ void Shared::MakeMeshes(const entity_t &e) {
 }
 
 
+/*
+    SplitMeshes()
+    Splits meshes which exceed the 16 bit vertex or triangle limits of the bsp mesh lumps
+*/
+void Shared::SplitMeshes() {
+    std::size_t split = 0;
+    for (std::size_t meshIndex = 0; meshIndex < Shared::meshes.size(); meshIndex++) {
+        if (Shared::meshes.at(meshIndex).vertices.size() <= Shared::MESH_MAX_VERTICES
+         && Shared::meshes.at(meshIndex).triangles.size() / 3 <= Shared::MESH_MAX_TRIANGLES) {
+            continue;
+        }
+
+        // Move the source out, the vector may reallocate while we append the pieces
+        Shared::Mesh_t source = std::move(Shared::meshes.at(meshIndex));
+        std::vector<Shared::Mesh_t> pieces;
+        std::vector<int> remap(source.vertices.size(), -1);
+
+        for (std::size_t i = 0; i + 2 < source.triangles.size(); i += 3) {
+            // Count the vertices this triangle would add to the current piece
+            std::size_t newVertices = 0;
+            for (std::size_t j = 0; j < 3; j++) {
+                if (remap[source.triangles[i + j]] == -1) {
+                    newVertices++;
+                }
+            }
+
+            if (pieces.empty()
+             || pieces.back().vertices.size() + newVertices > Shared::MESH_MAX_VERTICES
+             || pieces.back().triangles.size() / 3 + 1 > Shared::MESH_MAX_TRIANGLES) {
+                Shared::Mesh_t &piece = pieces.emplace_back();
+                piece.shaderInfo = source.shaderInfo;
+                piece.lightmapPage = source.lightmapPage;
+                std::fill(remap.begin(), remap.end(), -1);
+            }
+
+            Shared::Mesh_t &piece = pieces.back();
+            for (std::size_t j = 0; j < 3; j++) {
+                uint32_t vertIndex = source.triangles[i + j];
+                if (remap[vertIndex] == -1) {
+                    remap[vertIndex] = piece.vertices.size();
+                    piece.vertices.push_back(source.vertices[vertIndex]);
+                    piece.minmax.extend(source.vertices[vertIndex].xyz);
+                }
+                piece.triangles.push_back(remap[vertIndex]);
+            }
+        }
+
+        if (pieces.empty()) {
+            Shared::meshes.at(meshIndex) = std::move(source);
+            continue;
+        }
+
+        split++;
+        Shared::meshes.at(meshIndex) = std::move(pieces.front());
+        for (std::size_t i = 1; i < pieces.size(); i++) {
+            Shared::meshes.push_back(std::move(pieces.at(i)));
+        }
+    }
+
+    if (split) {
+        Sys_Printf("%9zu meshes split at the 16 bit index limit\n", split);
+    }
+}
+
+
+namespace {
+    constexpr std::size_t  VERTEX_CACHE_SIZE = 32;
+
+    /*
+        MeshCacheMisses()
+        Simulates a FIFO post-transform vertex cache and returns the number of misses
+    */
+    std::size_t MeshCacheMisses(const Shared::Mesh_t &mesh) {
+        std::vector<std::size_t> stamp(mesh.vertices.size(), 0);
+        std::size_t misses = 0;
+        for (uint32_t vertIndex : mesh.triangles) {
+            // A vertex is cached if it was loaded within the last VERTEX_CACHE_SIZE misses
+            if (stamp[vertIndex] == 0 || misses - stamp[vertIndex] + 1 > VERTEX_CACHE_SIZE) {
+                misses++;
+                stamp[vertIndex] = misses;
+            }
+        }
+        return misses;
+    }
+
+    /*
+        ForsythVertexScore()
+        Scores a vertex by its position in the cache and the number of triangles still using it
+    */
+    float ForsythVertexScore(int cachePosition, int remainingTriangles) {
+        if (remainingTriangles == 0) {
+            return -1.0f;
+        }
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // Vertices of the last triangle are scored the same to avoid favouring strips
+                score = 0.75f;
+            } else {
+                score = std::pow(1.0f - (cachePosition - 3) / float(VERTEX_CACHE_SIZE - 3), 1.5f);
+            }
+        }
+
+        // Boost vertices with few triangles left so they get finished off
+        return score + 2.0f / std::sqrt(float(remainingTriangles));
+    }
+
+    /*
+        ForsythReorder()
+        Reorders a meshes triangles with Tom Forsyth's linear-speed vertex cache optimiser
+    */
+    void ForsythReorder(Shared::Mesh_t &mesh) {
+        const std::size_t triangleCount = mesh.triangles.size() / 3;
+        const std::size_t vertexCount = mesh.vertices.size();
+        if (triangleCount < 2) {
+            return;
+        }
+
+        // Build vertex -> triangle adjacency, live triangles are kept at the front of each range
+        std::vector<int>          remaining(vertexCount, 0);
+        std::vector<std::size_t>  adjacencyOffset(vertexCount + 1, 0);
+        for (std::size_t i = 0; i < triangleCount * 3; i++) {
+            remaining[mesh.triangles[i]]++;
+        }
+        for (std::size_t i = 0; i < vertexCount; i++) {
+            adjacencyOffset[i + 1] = adjacencyOffset[i] + remaining[i];
+        }
+        std::vector<std::size_t>  adjacency(triangleCount * 3);
+        {
+            std::vector<std::size_t> cursor(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (std::size_t i = 0; i < triangleCount * 3; i++) {
+                adjacency[cursor[mesh.triangles[i]]++] = i / 3;
+            }
+        }
+
+        std::vector<int>    cachePosition(vertexCount, -1);
+        std::vector<float>  vertexScore(vertexCount);
+        for (std::size_t i = 0; i < vertexCount; i++) {
+            vertexScore[i] = ForsythVertexScore(-1, remaining[i]);
+        }
+
+        std::vector<float>  triangleScore(triangleCount);
+        std::vector<bool>   emitted(triangleCount, false);
+        for (std::size_t i = 0; i < triangleCount; i++) {
+            triangleScore[i] = vertexScore[mesh.triangles[i * 3 + 0]]
+                             + vertexScore[mesh.triangles[i * 3 + 1]]
+                             + vertexScore[mesh.triangles[i * 3 + 2]];
+        }
+
+        std::vector<uint32_t>  output;
+        output.reserve(mesh.triangles.size());
+        std::vector<uint32_t>  cache, newCache;
+        std::size_t            searchStart = 0;
+        std::size_t            best = SIZE_MAX;
+
+        for (std::size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+            // Nothing in the cache touches a live triangle, fall back to a linear search
+            if (best == SIZE_MAX) {
+                float bestScore = -1.0f;
+                for (std::size_t i = searchStart; i < triangleCount; i++) {
+                    if (!emitted[i] && triangleScore[i] > bestScore) {
+                        bestScore = triangleScore[i];
+                        best = i;
+                    }
+                }
+                while (searchStart < triangleCount && emitted[searchStart]) {
+                    searchStart++;
+                }
+            }
+
+            // Emit the triangle and detach it from its vertices
+            emitted[best] = true;
+            newCache.clear();
+            for (std::size_t j = 0; j < 3; j++) {
+                uint32_t vertIndex = mesh.triangles[best * 3 + j];
+                output.push_back(vertIndex);
+                newCache.push_back(vertIndex);
+
+                std::size_t first = adjacencyOffset[vertIndex];
+                std::size_t last = first + remaining[vertIndex] - 1;
+                for (std::size_t k = first; k <= last; k++) {
+                    if (adjacency[k] == best) {
+                        std::swap(adjacency[k], adjacency[last]);
+                        break;
+                    }
+                }
+                remaining[vertIndex]--;
+            }
+
+            // Move the triangles vertices to the front of the cache
+            for (uint32_t vertIndex : cache) {
+                if (vertIndex != newCache[0] && vertIndex != newCache[1] && vertIndex != newCache[2]) {
+                    newCache.push_back(vertIndex);
+                }
+            }
+            cache.swap(newCache);
+
+            // Rescore cached vertices and the live triangles using them, pick the next best
+            for (std::size_t i = 0; i < cache.size(); i++) {
+                uint32_t vertIndex = cache[i];
+                cachePosition[vertIndex] = i < VERTEX_CACHE_SIZE ? int(i) : -1;
+                vertexScore[vertIndex] = ForsythVertexScore(cachePosition[vertIndex], remaining[vertIndex]);
+            }
+
+            best = SIZE_MAX;
+            float bestScore = -1.0f;
+            for (uint32_t vertIndex : cache) {
+                std::size_t first = adjacencyOffset[vertIndex];
+                for (std::size_t k = first; k < first + remaining[vertIndex]; k++) {
+                    std::size_t tri = adjacency[k];
+                    triangleScore[tri] = vertexScore[mesh.triangles[tri * 3 + 0]]
+                                       + vertexScore[mesh.triangles[tri * 3 + 1]]
+                                       + vertexScore[mesh.triangles[tri * 3 + 2]];
+                    if (triangleScore[tri] > bestScore) {
+                        bestScore = triangleScore[tri];
+                        best = tri;
+                    }
+                }
+            }
+
+            if (cache.size() > VERTEX_CACHE_SIZE) {
+                cache.resize(VERTEX_CACHE_SIZE);
+            }
+        }
+
+        mesh.triangles.swap(output);
+    }
+}
+
+
+/*
+    OptimizeMeshes()
+    Reorders the triangles of every mesh for the post-transform vertex cache
+    and reports the average cache miss ratio before and after
+*/
+void Shared::OptimizeMeshes() {
+    std::size_t triangles = 0;
+    std::size_t missesBefore = 0;
+    std::size_t missesAfter = 0;
+
+    for (Shared::Mesh_t &mesh : Shared::meshes) {
+        triangles += mesh.triangles.size() / 3;
+        missesBefore += MeshCacheMisses(mesh);
+        ForsythReorder(mesh);
+        missesAfter += MeshCacheMisses(mesh);
+    }
+
+    if (triangles) {
+        Sys_Printf("%9.3f ACMR before vertex cache optimisation\n", float(missesBefore) / triangles);
+        Sys_Printf("%9.3f ACMR after vertex cache optimisation\n", float(missesAfter) / triangles);
+    }
+}
+
+
 void Shared::MakeVisReferences() {
     /* Meshes */
     for (std::size_t i = 0; i < Shared::meshes.size(); i++) {
@@ -544,3 +807,66 @@ void Shared::MakeLightmapUVs() {
     Sys_Printf("%9zu lightmap pages used\n", current_page + 1);
     Sys_Printf("%9zu lightmap islands leftover\n", Shared::islands.size() - island_index);
 }
+
+
+/*
+    StaticPropScale()
+    Reads the scale of a static prop from modelscale_vec or modelscale
+*/
+Vector3 Shared::StaticPropScale(const entity_t &e) {
+    Vector3 scale(1);
+    if (!e.read_keyvalue(scale, "modelscale_vec"))
+        if (e.read_keyvalue(scale[0], "modelscale"))
+            scale[1] = scale[2] = scale[0];
+    return scale;
+}
+
+
+/*
+    StaticPropBounds()
+    Calculates the world bounds of a static prop instance
+    The local bounds of each model are only computed the first time it's seen,
+    instances then transform the 8 corners of the cached bounds
+    The lump only stores a uniform scale, so the bounds use the largest
+    component of scale to match what the engine draws
+    Returns false if the model failed to load
+*/
+bool Shared::StaticPropBounds(const char *model, const Vector3 &origin, const Vector3 &angles, const Vector3 &scale, MinMax &minmax) {
+    static std::map<std::string, std::optional<MinMax>> localBounds;
+
+    std::string key(model);
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    auto it = localBounds.find(key);
+    if (it == localBounds.end()) {
+        std::optional<MinMax> bounds;
+        std::vector<const AssMeshWalker*> meshes = LoadModelWalker(model, 0);
+        if (!meshes.empty()) {
+            MinMax &local = bounds.emplace();
+            for (const auto mesh : meshes) {
+                mesh->forEachFace([&local](const Vector3 (&xyz)[3], const Vector2 (&st)[3]) {
+                    local.extend(xyz[0]);
+                    local.extend(xyz[1]);
+                    local.extend(xyz[2]);
+                });
+            }
+        }
+        it = localBounds.emplace(key, bounds).first;
+    }
+
+    if (!it->second)
+        return false;
+
+    const MinMax &local = *it->second;
+    Matrix4 transform(g_matrix4_identity);
+    matrix4_transform_by_euler_xyz_degrees(transform, origin, angles_pyr2rpy(angles), Vector3(vector3_max_component(scale)));
+
+    minmax.clear();
+    for (int i = 0; i < 8; i++) {
+        const Vector3 corner((i & 1) ? local.maxs.x() : local.mins.x(),
+                             (i & 2) ? local.maxs.y() : local.mins.y(),
+                             (i & 4) ? local.maxs.z() : local.mins.z());
+        minmax.extend(matrix4_transformed_point(transform, corner));
+    }
+    return true;
+}
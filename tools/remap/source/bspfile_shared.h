@@ -51,7 +51,7 @@ namespace Shared {
         shaderInfo_t          *shaderInfo;
         int                    lightmapPage;
         std::vector<Vertex_t>  vertices;
-        std::vector<uint16_t>  triangles;
+        std::vector<uint32_t>  triangles;  // narrowed to uint16_t when emitted, after SplitMeshes
     };
 
     struct Island_t {
@@ -70,6 +70,11 @@ namespace Shared {
         std::vector<visRef_t>   refs;
     };
 
+    /* Limits */
+    // Mesh vertex counts and relative indices are stored as uint16_t in the bsp
+    inline constexpr std::size_t  MESH_MAX_VERTICES = 65535;
+    inline constexpr std::size_t  MESH_MAX_TRIANGLES = 65535;
+
     /* Vectors */
     inline std::vector<Mesh_t>    meshes;
     inline std::vector<visRef_t>  visRefs;
@@ -77,8 +82,12 @@ namespace Shared {
     inline std::vector<Island_t>  islands;
     /* Functions */
     void MakeMeshes(const entity_t &e);
+    void SplitMeshes();
+    void OptimizeMeshes();
     void MakeVisReferences();
     visNode_t MakeVisTree(std::vector<Shared::visRef_t> refs, float parentCost);
     void MergeVisTree(Shared::visNode_t &node);
     void MakeLightmapUVs();
+    Vector3 StaticPropScale(const entity_t &e);
+    bool StaticPropBounds(const char *model, const Vector3 &origin, const Vector3 &angles, const Vector3 &scale, MinMax &minmax);
 }
@@ -0,0 +1,465 @@
+/* -------------------------------------------------------------------------------
+
+   Copyright (C) 2022-2025 MRVN-Radiant and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+
+   This file is part of MRVN-Radiant.
+
+   MRVN-Radiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   MRVN-Radiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+   ------------------------------------------------------------------------------- */
+
+/*
+    Built-in BVH Ray Tracing Implementation
+*/
+
+#include "bvh_trace.h"
+#include "remap.h"
+#include "bspfile_shared.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace BVHTrace {
+
+// =============================================================================
+// Internal State
+// =============================================================================
+
+constexpr int   SAH_BINS = 16;
+constexpr int   MAX_LEAF_TRIANGLES = 4;
+constexpr int   MAX_DEPTH = 64;
+constexpr float RAY_TNEAR = 0.1f;  // Matches the Embree path
+
+struct Triangle_t {
+    Vector3 v0, v1, v2;
+    int     meshIndex;
+};
+
+// Leaf nodes reference a range of triangles, interior nodes store the index
+// of their second child, the first child directly follows the node
+struct Node_t {
+    MinMax   bounds;
+    uint32_t first;   // First triangle (leaf) or second child (interior)
+    uint32_t count;   // Triangle count, 0 for interior nodes
+};
+
+struct Ray_t {
+    Vector3 origin;
+    Vector3 dir;
+    Vector3 invDir;
+    float   tfar;
+
+    // Watertight test shear constants
+    int     kx, ky, kz;
+    float   sx, sy, sz;
+};
+
+static std::vector<Triangle_t> g_triangles;
+static std::vector<Node_t> g_nodes;
+static bool g_sceneReady = false;
+static EmbreeTrace::SceneStats g_stats = {};
+
+
+// =============================================================================
+// Build
+// =============================================================================
+
+static float SurfaceArea(const MinMax &bounds) {
+    // Flat bounds are fine, only empty ones have no area
+    if (bounds.mins.x() > bounds.maxs.x()) {
+        return 0.0f;
+    }
+    return bounds.area();
+}
+
+static MinMax TriangleBounds(const Triangle_t &tri) {
+    MinMax bounds;
+    bounds.extend(tri.v0);
+    bounds.extend(tri.v1);
+    bounds.extend(tri.v2);
+    return bounds;
+}
+
+/*
+    BuildNode
+    Recursively splits triangles [first, first + count) with a binned SAH
+*/
+static void BuildNode(std::vector<Vector3> &centroids, uint32_t first, uint32_t count, int depth) {
+    const std::size_t index = g_nodes.size();
+    g_nodes.emplace_back();
+
+    MinMax bounds;
+    MinMax centroidBounds;
+    for (uint32_t i = first; i < first + count; i++) {
+        bounds.extend(TriangleBounds(g_triangles[i]));
+        centroidBounds.extend(centroids[i]);
+    }
+    g_nodes[index].bounds = bounds;
+
+    const auto makeLeaf = [&]() {
+        g_nodes[index].first = first;
+        g_nodes[index].count = count;
+    };
+
+    if (count <= MAX_LEAF_TRIANGLES || depth >= MAX_DEPTH) {
+        makeLeaf();
+        return;
+    }
+
+    // Find the cheapest split over all axes
+    float bestCost = SurfaceArea(bounds) * count;
+    int bestAxis = -1;
+    int bestBin = 0;
+
+    for (int axis = 0; axis < 3; axis++) {
+        const float lo = centroidBounds.mins[axis];
+        const float extent = centroidBounds.maxs[axis] - lo;
+        if (extent <= 0.0f) {
+            continue;
+        }
+        const float scale = SAH_BINS / extent;
+
+        MinMax binBounds[SAH_BINS];
+        uint32_t binCounts[SAH_BINS] = {};
+        for (uint32_t i = first; i < first + count; i++) {
+            const int bin = std::min(SAH_BINS - 1, static_cast<int>((centroids[i][axis] - lo) * scale));
+            binCounts[bin]++;
+            binBounds[bin].extend(TriangleBounds(g_triangles[i]));
+        }
+
+        // Sweep from the right to get the cost of every right hand side
+        float rightArea[SAH_BINS];
+        uint32_t rightCount[SAH_BINS];
+        MinMax accumulated;
+        uint32_t accumulatedCount = 0;
+        for (int bin = SAH_BINS - 1; bin > 0; bin--) {
+            if (binCounts[bin]) {
+                accumulated.extend(binBounds[bin]);
+            }
+            accumulatedCount += binCounts[bin];
+            rightArea[bin] = SurfaceArea(accumulated);
+            rightCount[bin] = accumulatedCount;
+        }
+
+        accumulated = MinMax();
+        accumulatedCount = 0;
+        for (int bin = 0; bin < SAH_BINS - 1; bin++) {
+            if (binCounts[bin]) {
+                accumulated.extend(binBounds[bin]);
+            }
+            accumulatedCount += binCounts[bin];
+            if (accumulatedCount == 0 || rightCount[bin + 1] == 0) {
+                continue;
+            }
+            const float cost = SurfaceArea(accumulated) * accumulatedCount + rightArea[bin + 1] * rightCount[bin + 1];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = bin;
+            }
+        }
+    }
+
+    if (bestAxis == -1) {
+        makeLeaf();
+        return;
+    }
+
+    // Partition triangles and their centroids around the chosen bin
+    const float lo = centroidBounds.mins[bestAxis];
+    const float scale = SAH_BINS / (centroidBounds.maxs[bestAxis] - lo);
+    uint32_t middle = first;
+    for (uint32_t i = first; i < first + count; i++) {
+        const int bin = std::min(SAH_BINS - 1, static_cast<int>((centroids[i][bestAxis] - lo) * scale));
+        if (bin <= bestBin) {
+            std::swap(g_triangles[i], g_triangles[middle]);
+            std::swap(centroids[i], centroids[middle]);
+            middle++;
+        }
+    }
+
+    g_nodes[index].count = 0;
+    BuildNode(centroids, first, middle - first, depth + 1);
+    g_nodes[index].first = static_cast<uint32_t>(g_nodes.size());
+    BuildNode(centroids, middle, first + count - middle, depth + 1);
+}
+
+
+// =============================================================================
+// Traversal
+// =============================================================================
+
+static Ray_t MakeRay(const Vector3 &origin, const Vector3 &dir, float maxDist) {
+    Ray_t ray;
+    ray.origin = origin;
+    ray.dir = dir;
+    ray.tfar = maxDist;
+    for (int axis = 0; axis < 3; axis++) {
+        ray.invDir[axis] = 1.0f / dir[axis];
+    }
+
+    // Permute so the largest direction component becomes z
+    ray.kz = 0;
+    if (std::fabs(dir[1]) > std::fabs(dir[ray.kz])) ray.kz = 1;
+    if (std::fabs(dir[2]) > std::fabs(dir[ray.kz])) ray.kz = 2;
+    ray.kx = (ray.kz + 1) % 3;
+    ray.ky = (ray.kx + 1) % 3;
+    if (dir[ray.kz] < 0.0f) {
+        std::swap(ray.kx, ray.ky);  // Keep the winding
+    }
+
+    ray.sx = dir[ray.kx] / dir[ray.kz];
+    ray.sy = dir[ray.ky] / dir[ray.kz];
+    ray.sz = 1.0f / dir[ray.kz];
+    return ray;
+}
+
+/*
+    IntersectBounds
+    Slab test, returns the entry distance or a negative value on a miss
+*/
+static float IntersectBounds(const Ray_t &ray, const MinMax &bounds) {
+    float tmin = RAY_TNEAR;
+    float tmax = ray.tfar;
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (bounds.mins[axis] - ray.origin[axis]) * ray.invDir[axis];
+        float t1 = (bounds.maxs[axis] - ray.origin[axis]) * ray.invDir[axis];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        // NaN from 0 * inf on a slab boundary keeps the previous limits
+        tmin = t0 > tmin ? t0 : tmin;
+        tmax = t1 < tmax ? t1 : tmax;
+        if (tmin > tmax) {
+            return -1.0f;
+        }
+    }
+    return tmin;
+}
+
+/*
+    IntersectTriangle
+    Watertight ray/triangle test, double sided, returns true within (tnear, tfar)
+*/
+static bool IntersectTriangle(const Ray_t &ray, const Triangle_t &tri, float &t) {
+    const Vector3 a = tri.v0 - ray.origin;
+    const Vector3 b = tri.v1 - ray.origin;
+    const Vector3 c = tri.v2 - ray.origin;
+
+    const float ax = a[ray.kx] - ray.sx * a[ray.kz];
+    const float ay = a[ray.ky] - ray.sy * a[ray.kz];
+    const float bx = b[ray.kx] - ray.sx * b[ray.kz];
+    const float by = b[ray.ky] - ray.sy * b[ray.kz];
+    const float cx = c[ray.kx] - ray.sx * c[ray.kz];
+    const float cy = c[ray.ky] - ray.sy * c[ray.kz];
+
+    float u = cx * by - cy * bx;
+    float v = ax * cy - ay * cx;
+    float w = bx * ay - by * ax;
+
+    // Fall back to double precision on edges
+    if (u == 0.0f || v == 0.0f || w == 0.0f) {
+        u = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+        v = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+        w = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+    }
+
+    if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f)) {
+        return false;
+    }
+
+    const float det = u + v + w;
+    if (det == 0.0f) {
+        return false;
+    }
+
+    const float az = ray.sz * a[ray.kz];
+    const float bz = ray.sz * b[ray.kz];
+    const float cz = ray.sz * c[ray.kz];
+    t = (u * az + v * bz + w * cz) / det;
+    return t > RAY_TNEAR && t < ray.tfar;
+}
+
+/*
+    Traverse
+    Walks the BVH near child first, with anyHit the first hit ends the walk
+*/
+static bool Traverse(Ray_t &ray, bool anyHit, const Triangle_t **outHit) {
+    if (g_nodes.empty()) {
+        return false;
+    }
+
+    uint32_t stack[MAX_DEPTH * 2 + 2];
+    int depth = 0;
+    stack[depth++] = 0;
+    bool hit = false;
+
+    while (depth) {
+        const uint32_t index = stack[--depth];
+        const Node_t &node = g_nodes[index];
+        if (IntersectBounds(ray, node.bounds) < 0.0f) {
+            continue;
+        }
+
+        if (node.count) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                float t;
+                if (IntersectTriangle(ray, g_triangles[i], t)) {
+                    if (anyHit) {
+                        return true;
+                    }
+                    ray.tfar = t;
+                    *outHit = &g_triangles[i];
+                    hit = true;
+                }
+            }
+            continue;
+        }
+
+        const uint32_t left = index + 1;
+        const uint32_t right = node.first;
+        const float tLeft = IntersectBounds(ray, g_nodes[left].bounds);
+        const float tRight = IntersectBounds(ray, g_nodes[right].bounds);
+
+        // Push the far child first so the near one is popped next
+        if (tLeft >= 0.0f && tRight >= 0.0f) {
+            if (tLeft <= tRight) {
+                stack[depth++] = right;
+                stack[depth++] = left;
+            } else {
+                stack[depth++] = left;
+                stack[depth++] = right;
+            }
+        } else if (tLeft >= 0.0f) {
+            stack[depth++] = left;
+        } else if (tRight >= 0.0f) {
+            stack[depth++] = right;
+        }
+    }
+
+    return hit;
+}
+
+
+// =============================================================================
+// Public API Implementation
+// =============================================================================
+
+void BuildScene(bool skipSkyMeshes) {
+    ClearScene();
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    Sys_Printf("Building BVH scene...\n");
+
+    for (size_t meshIdx = 0; meshIdx < Shared::meshes.size(); meshIdx++) {
+        const Shared::Mesh_t &mesh = Shared::meshes[meshIdx];
+
+        // Skip sky meshes for shadow rays
+        if (skipSkyMeshes && mesh.shaderInfo &&
+            (mesh.shaderInfo->compileFlags & C_SKY)) {
+            continue;
+        }
+
+        // Skip meshes with no triangles
+        if (mesh.triangles.size() < 3 || mesh.vertices.empty()) {
+            continue;
+        }
+
+        for (size_t t = 0; t + 2 < mesh.triangles.size(); t += 3) {
+            Triangle_t &tri = g_triangles.emplace_back();
+            tri.v0 = mesh.vertices[mesh.triangles[t + 0]].xyz;
+            tri.v1 = mesh.vertices[mesh.triangles[t + 1]].xyz;
+            tri.v2 = mesh.vertices[mesh.triangles[t + 2]].xyz;
+            tri.meshIndex = static_cast<int>(meshIdx);
+        }
+
+        g_stats.numMeshes++;
+        g_stats.numTriangles += mesh.triangles.size() / 3;
+        g_stats.numVertices += mesh.vertices.size();
+    }
+
+    if (!g_triangles.empty()) {
+        std::vector<Vector3> centroids;
+        centroids.reserve(g_triangles.size());
+        for (const Triangle_t &tri : g_triangles) {
+            centroids.push_back((tri.v0 + tri.v1 + tri.v2) / 3.0f);
+        }
+
+        g_nodes.reserve(2 * g_triangles.size() / MAX_LEAF_TRIANGLES + 1);
+        BuildNode(centroids, 0, static_cast<uint32_t>(g_triangles.size()), 0);
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    g_stats.buildTimeMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+
+    g_sceneReady = true;
+
+    Sys_Printf("  %zu meshes, %zu triangles, %zu vertices\n",
+               g_stats.numMeshes, g_stats.numTriangles, g_stats.numVertices);
+    Sys_Printf("  %zu BVH nodes built in %.2f ms\n", g_nodes.size(), g_stats.buildTimeMs);
+}
+
+
+void ClearScene() {
+    g_triangles.clear();
+    g_triangles.shrink_to_fit();
+    g_nodes.clear();
+    g_nodes.shrink_to_fit();
+    g_sceneReady = false;
+    g_stats = {};
+}
+
+
+bool TestVisibility(const Vector3 &origin, const Vector3 &dir, float maxDist) {
+    if (!g_sceneReady) {
+        return false;  // No scene, assume not blocked
+    }
+
+    Ray_t ray = MakeRay(origin, dir, maxDist);
+    return Traverse(ray, true, nullptr);
+}
+
+
+bool TraceRay(const Vector3 &origin, const Vector3 &dir, float maxDist,
+              float &outHitDist, Vector3 &outHitNormal, int &outMeshIndex) {
+    if (!g_sceneReady) {
+        return false;
+    }
+
+    Ray_t ray = MakeRay(origin, dir, maxDist);
+    const Triangle_t *hit = nullptr;
+    if (!Traverse(ray, false, &hit)) {
+        return false;
+    }
+
+    outHitDist = ray.tfar;
+    outHitNormal = vector3_normalised(vector3_cross(hit->v1 - hit->v0, hit->v2 - hit->v0));
+    outMeshIndex = hit->meshIndex;
+    return true;
+}
+
+
+bool IsSceneReady() {
+    return g_sceneReady;
+}
+
+
+EmbreeTrace::SceneStats GetSceneStats() {
+    return g_stats;
+}
+
+} // namespace BVHTrace
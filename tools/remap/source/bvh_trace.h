@@ -0,0 +1,63 @@
+/* -------------------------------------------------------------------------------
+
+   Copyright (C) 2022-2025 MRVN-Radiant and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+
+   This file is part of MRVN-Radiant.
+
+   MRVN-Radiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   MRVN-Radiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+   ------------------------------------------------------------------------------- */
+
+#pragma once
+
+/*
+    Built-in BVH Ray Tracing
+
+    Dependency free replacement for Embree, used by EmbreeTrace when remap is
+    built without USE_EMBREE or the Embree device can't be created.
+
+    - Binned SAH build over the triangles of Shared::meshes
+    - Watertight ray/triangle test (Woop, Benthin, Wald 2013)
+    - Occlusion and closest hit queries with the same conventions as the
+      Embree path: rays start at tnear = 0.1, triangles are double sided
+*/
+
+#include "embree_trace.h"
+
+namespace BVHTrace {
+
+// Build the BVH from current Shared::meshes
+// skipSkyMeshes: if true, meshes with C_SKY flag are excluded (for shadow rays)
+void BuildScene(bool skipSkyMeshes = true);
+
+// Free the BVH
+void ClearScene();
+
+// Returns true if the ray hits something before maxDist
+bool TestVisibility(const Vector3 &origin, const Vector3 &dir, float maxDist);
+
+// Trace a ray and get the closest hit
+// outHitNormal is the normalised geometric normal, cross(v1 - v0, v2 - v0)
+bool TraceRay(const Vector3 &origin, const Vector3 &dir, float maxDist,
+              float &outHitDist, Vector3 &outHitNormal, int &outMeshIndex);
+
+// Check if the BVH is built
+bool IsSceneReady();
+
+// Get statistics about the current scene
+EmbreeTrace::SceneStats GetSceneStats();
+
+} // namespace BVHTrace
@@ -30,6 +30,7 @@
 
 /* dependencies */
 #include "remap.h"
+#include "bspfile_abstract.h"
 
 
 
@@ -238,12 +239,52 @@ int ShiftBSPMain( Args& args ){
 
 /*
    MergeBSPMain()
-   merges two bsps
+   merges compiled bsps into the first one
  */
 
 int MergeBSPMain( Args& args ){
-	Sys_Printf("I don't work :) - MergeBSPMain");
-	return -1;
+	/* arg checking */
+	if ( args.size() < 2 ) {
+		Sys_Printf( "Usage: remap -mergebsp [-v] [-o <output.bsp>] <mainBsp.bsp> <bspToInject.bsp> [<bspToInject.bsp> ...]\n" );
+		return 0;
+	}
+
+	/* only titanfall 2 bsps can be read back in yet */
+	if ( g_game->write != WriteR2BSPFile ) {
+		Error( "-mergebsp only supports Titanfall 2 bsps" );
+	}
+
+	/* process arguments */
+	CopiedString output;
+	while ( args.takeArg( "-o" ) ) {
+		output = ExpandArg( args.takeNext() );
+	}
+
+	std::vector<CopiedString> filenames;
+	while ( !args.empty() ) {
+		char name[1024];
+		strcpyQ( name, ExpandArg( args.takeFront() ), sizeof( name ) );
+		path_set_extension( name, ".bsp" );
+		filenames.emplace_back( name );
+	}
+
+	if ( filenames.size() < 2 ) {
+		Error( "-mergebsp needs a main bsp and at least one bsp to inject" );
+	}
+
+	/* write next to the main bsp by default */
+	if ( output.empty() ) {
+		output = StringStream( PathExtensionless( filenames.front().c_str() ), "_merged.bsp" );
+	}
+
+	std::vector<const char*> names;
+	for ( const CopiedString& name : filenames )
+		names.push_back( name.c_str() );
+
+	Titanfall2::MergeBSPFiles( names, output.c_str() );
+
+	/* return to sender */
+	return 0;
 }
 
 
@@ -28,115 +28,611 @@
 
 
 
+
+
 /* dependencies */
 #include "remap.h"
+#include "bspfile_abstract.h"
 #define RAPIDJSON_WRITE_DEFAULT_FLAGS kWriteNanAndInfFlag
 #define RAPIDJSON_PARSE_DEFAULT_FLAGS ( kParseCommentsFlag | kParseTrailingCommasFlag | kParseNanAndInfFlag )
-#include "rapidjson/document.h"
 #include "rapidjson/prettywriter.h"
+#include "rapidjson/filewritestream.h"
+#include "rapidjson/filereadstream.h"
+#include "rapidjson/reader.h"
 
-#include <map>
+#include <algorithm>
+#include <string>
 
-#define for_indexed(...) for_indexed_v(i, __VA_ARGS__)
-#define for_indexed_v(v, ...) if (std::size_t v = -1) for (__VA_ARGS__) if ((++v, true))
 
+/*
+   every lump of the rBSP is unpacked to its own json file, lumps with a known layout as
+   readable records and the rest as hex strings, so -pack rebuilds the whole bsp.
+   lumps are streamed straight to and from their files with rapidjson::Writer and a
+   SAX rapidjson::Reader instead of going through a rapidjson::Document, so memory use
+   stays at one record regardless of the bsp size
+ */
 
-template<typename T, typename Allocator>
-rapidjson::Value value_for( const BasicVector2<T>& vec, Allocator& allocator ){
-	rapidjson::Value value( rapidjson::kArrayType );
-	for( size_t i = 0; i != 2; ++i )
-		value.PushBack( vec[i], allocator );
-	return value;
+using JsonWriter = rapidjson::PrettyWriter<rapidjson::FileWriteStream>;
+
+template<typename T>
+std::enable_if_t<std::is_arithmetic_v<T>> write_value( JsonWriter& writer, T value ){
+	if constexpr ( std::is_floating_point_v<T> )
+		writer.Double( value );
+	else if constexpr ( std::is_signed_v<T> )
+		writer.Int64( value );
+	else
+		writer.Uint64( value );
 }
-template<typename T, typename Allocator>
-rapidjson::Value value_for( const BasicVector3<T>& vec, Allocator& allocator ){
-	rapidjson::Value value( rapidjson::kArrayType );
+template<typename T>
+void write_value( JsonWriter& writer, const BasicVector3<T>& vec ){
+	writer.StartArray();
 	for( size_t i = 0; i != 3; ++i )
-		value.PushBack( vec[i], allocator );
-	return value;
-}
-template<typename T, typename Allocator>
-rapidjson::Value value_for( const BasicVector4<T>& vec, Allocator& allocator ){
-	rapidjson::Value value( rapidjson::kArrayType );
-	for( size_t i = 0; i != 4; ++i )
-		value.PushBack( vec[i], allocator );
-	return value;
-}
-template<typename T, size_t N, typename Allocator>
-rapidjson::Value value_for( const T (&array)[N], Allocator& allocator ){
-	rapidjson::Value value( rapidjson::kArrayType );
-	for( auto&& val : array )
-		value.PushBack( value_for( val, allocator ), allocator );
-	return value;
-}
-template<typename T, size_t N, typename Allocator>
-rapidjson::Value value_for_array( const T (&array)[N], Allocator& allocator ){
-	rapidjson::Value value( rapidjson::kArrayType );
-	for( auto&& val : array )
-		value.PushBack( val, allocator );
-	return value;
+		write_value( writer, vec[i] );
+	writer.EndArray();
+}
+template<typename T>
+void write_member( JsonWriter& writer, const char *key, const T& value ){
+	writer.Key( key );
+	write_value( writer, value );
 }
 
+
+/* one top level array element of a lump; nested arrays are flattened into numbers and strings */
+struct JsonField
+{
+	std::string key;
+	std::vector<std::string> strings;
+	std::vector<double> numbers;
+};
+using JsonRecord = std::vector<JsonField>;
+
+class JsonNumbers
+{
+	const JsonField& m_field;
+	size_t m_index = 0;
+public:
+	explicit JsonNumbers( const JsonField& field ) : m_field( field ){
+	}
+	double next(){
+		if( m_index == m_field.numbers.size() )
+			Error( "JSON field \"%s\" has too few values", m_field.key.c_str() );
+		return m_field.numbers[m_index++];
+	}
+};
+
 template<typename T>
-void value_to( const rapidjson::Value& value, BasicVector2<T>& vec ){
-	for( size_t i = 0; i != 2; ++i )
-		vec[i] = value.GetArray().operator[]( i ).Get<T>();
+std::enable_if_t<std::is_arithmetic_v<T>> value_to( JsonNumbers& numbers, T& value ){
+	value = static_cast<T>( numbers.next() );
 }
 template<typename T>
-void value_to( const rapidjson::Value& value, BasicVector3<T>& vec ){
+void value_to( JsonNumbers& numbers, BasicVector3<T>& vec ){
 	for( size_t i = 0; i != 3; ++i )
-		if constexpr ( std::is_same_v<T, byte> )
-			vec[i] = value.GetArray().operator[]( i ).Get<int>();
-		else
-			vec[i] = value.GetArray().operator[]( i ).Get<T>();
+		value_to( numbers, vec[i] );
+}
+
+inline const JsonField& record_field( const JsonRecord& record, const char *key ){
+	for( const JsonField& field : record )
+		if( field.key == key )
+			return field;
+	Error( "JSON record is missing field \"%s\"", key );
+}
+inline const char *record_string( const JsonRecord& record, const char *key ){
+	const JsonField& field = record_field( record, key );
+	return field.strings.empty()? "" : field.strings.front().c_str();
 }
 template<typename T>
-void value_to( const rapidjson::Value& value, BasicVector4<T>& vec ){
-	for( size_t i = 0; i != 4; ++i )
-		if constexpr ( std::is_same_v<T, byte> )
-			vec[i] = value.GetArray().operator[]( i ).Get<int>();
-		else
-			vec[i] = value.GetArray().operator[]( i ).Get<T>();
-}
-template<typename T, size_t N>
-void value_to( const rapidjson::Value& value, T (&array)[N] ){
-	for_indexed( auto&& val : array )
-		value_to( value.GetArray().operator[]( i ), val );
-}
-template<typename T, size_t N>
-void value_to_array( const rapidjson::Value& value, T (&array)[N] ){
-	for_indexed( auto&& val : array ){
-		if constexpr ( std::is_same_v<T, byte> )
-			val = value.GetArray().operator[]( i ).Get<int>();
+void member_to( const JsonRecord& record, const char *key, T& value ){
+	JsonNumbers numbers( record_field( record, key ) );
+	value_to( numbers, value );
+}
+
+
+/* SAX handler calling back with each element of the top level array */
+template<typename Callback>
+class JsonRecordHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, JsonRecordHandler<Callback>>
+{
+	const Callback& m_callback;
+	JsonRecord m_record;
+	int m_depth = 0;
+
+	JsonField& field(){
+		if( m_record.empty() )
+			m_record.emplace_back();
+		return m_record.back();
+	}
+	bool number( double value ){
+		if( m_depth == 1 ){ // bare number element
+			m_record.assign( 1, JsonField{ {}, {}, { value } } );
+			m_callback( m_record );
+		}
+		else if( m_depth > 1 ){
+			field().numbers.push_back( value );
+		}
+		return true;
+	}
+public:
+	explicit JsonRecordHandler( const Callback& callback ) : m_callback( callback ){
+	}
+	bool Default(){
+		return false;
+	}
+	bool Null(){
+		return true;
+	}
+	bool Bool( bool value ){
+		return number( value );
+	}
+	bool Int( int value ){
+		return number( value );
+	}
+	bool Uint( unsigned value ){
+		return number( value );
+	}
+	bool Int64( int64_t value ){
+		return number( value );
+	}
+	bool Uint64( uint64_t value ){
+		return number( value );
+	}
+	bool Double( double value ){
+		return number( value );
+	}
+	bool String( const char *str, rapidjson::SizeType length, bool ){
+		if( m_depth == 1 ){ // bare string element
+			m_record.assign( 1, JsonField{ {}, { std::string( str, length ) }, {} } );
+			m_callback( m_record );
+		}
+		else if( m_depth > 1 ){
+			field().strings.emplace_back( str, length );
+		}
+		return true;
+	}
+	bool Key( const char *str, rapidjson::SizeType length, bool ){
+		if( m_depth == 2 )
+			m_record.emplace_back().key.assign( str, length );
+		return true;
+	}
+	bool StartObject(){
+		if( ++m_depth == 2 )
+			m_record.clear();
+		return true;
+	}
+	bool EndObject( rapidjson::SizeType ){
+		if( m_depth-- == 2 )
+			m_callback( m_record );
+		return true;
+	}
+	bool StartArray(){
+		return StartObject();
+	}
+	bool EndArray( rapidjson::SizeType count ){
+		return EndObject( count );
+	}
+};
+
+
+template<typename Functor>
+static void write_lump( const char *filename, Functor&& functor ){
+	FILE *file = SafeOpenWrite( filename, "wb" );
+	char buffer[65536];
+	rapidjson::FileWriteStream stream( file, buffer, sizeof( buffer ) );
+	JsonWriter writer( stream );
+	writer.SetFormatOptions( rapidjson::kFormatSingleLineArray );
+	writer.StartArray();
+	functor( writer );
+	writer.EndArray();
+	stream.Flush();
+	fclose( file );
+}
+
+template<typename Callback>
+static void read_lump( const char *filename, Callback&& callback ){
+	FILE *file = SafeOpenRead( filename, "rb" );
+	char buffer[65536];
+	rapidjson::FileReadStream stream( file, buffer, sizeof( buffer ) );
+	JsonRecordHandler handler( callback );
+	rapidjson::Reader reader;
+	const rapidjson::ParseResult result = reader.Parse( stream, handler );
+	fclose( file );
+	if( result.IsError() )
+		Error( "%s: JSON parse error %d at offset %zu", filename, result.Code(), result.Offset() );
+}
+
+
+/* lump elements are copied out of the byte buffer, lumps have no alignment guarantee */
+using LumpData = std::vector<byte>;
+
+template<typename T, typename Functor>
+static void for_each_element( const LumpData& data, Functor&& functor ){
+	for( size_t offset = 0; offset + sizeof( T ) <= data.size(); offset += sizeof( T ) ){
+		T element;
+		memcpy( &element, data.data() + offset, sizeof( T ) );
+		functor( element );
+	}
+}
+template<typename T>
+static void append_element( LumpData& data, const T& element ){
+	const byte *bytes = reinterpret_cast<const byte*>( &element );
+	data.insert( data.end(), bytes, bytes + sizeof( T ) );
+}
+
+
+/* surface flags are written with their names too, -useflagnames packs them from the names alone */
+static bool g_jsonUseFlagNames;
+static bool g_jsonSkipUnknownFlags;
+
+static void write_flag_names( JsonWriter& writer, uint32_t flags ){
+	writer.Key( "flagNames" );
+	writer.StartArray();
+	for( const ShaderFlag_t& flag : g_game->surfaceFlags )
+		if( flag.flags != 0 && ( flags & flag.flags ) == uint32_t( flag.flags ) )
+			writer.String( flag.name );
+	writer.EndArray();
+}
+
+static void read_flags( const JsonRecord& record, uint32_t& flags ){
+	if( !g_jsonUseFlagNames ){
+		member_to( record, "flags", flags );
+		return;
+	}
+	flags = 0;
+	for( const std::string& name : record_field( record, "flagNames" ).strings ){
+		const auto flag = std::find_if( g_game->surfaceFlags.cbegin(), g_game->surfaceFlags.cend(), [&name]( const ShaderFlag_t& flag ){
+			return striEqual( flag.name, name.c_str() );
+		} );
+		if( flag != g_game->surfaceFlags.cend() )
+			flags |= flag->flags;
+		else if( g_jsonSkipUnknownFlags )
+			Sys_Warning( "Skipping unknown surface flag name \"%s\"\n", name.c_str() );
 		else
-			val = value.GetArray().operator[]( i ).Get<T>();
+			Error( "Unknown surface flag name \"%s\", use -skipflags to skip unknown names", name.c_str() );
 	}
 }
 
 
-static void write_doc( const char *filename, rapidjson::Document& doc ){
-	rapidjson::StringBuffer buffer;
-   	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer( buffer );
-	writer.SetFormatOptions( rapidjson::kFormatSingleLineArray );
-   	doc.Accept( writer );
-	Sys_Printf( "Writing %s\n", filename );
-	SaveFile( filename, buffer.GetString(), buffer.GetSize() );
+/* how one lump is laid out in json */
+struct JsonLumpFormat
+{
+	const char *name;
+	size_t elementSize;  // lumps which aren't a multiple of this are written raw
+	void ( *write )( JsonWriter& writer, const LumpData& data );
+	void ( *read )( const JsonRecord& record, LumpData& data );
+	void ( *finish )( LumpData& data );
+};
+
+static const JsonLumpFormat g_jsonLumpFormats[] = {
+	{ "raw", 1,
+		[]( JsonWriter& writer, const LumpData& data ){
+			for( size_t offset = 0; offset < data.size(); offset += 32 ){
+				char hex[65];
+				const size_t count = std::min<size_t>( 32, data.size() - offset );
+				for( size_t i = 0; i != count; ++i )
+					sprintf( hex + i * 2, "%02x", data[offset + i] );
+				writer.String( hex, count * 2 );
+			}
+		},
+		[]( const JsonRecord& record, LumpData& data ){
+			const char *hex = record_string( record, "" );
+			for( ; hex[0] != '\0' && hex[1] != '\0'; hex += 2 ){
+				unsigned int value;
+				if( sscanf( hex, "%2x", &value ) != 1 )
+					Error( "Invalid hex string in raw lump" );
+				data.push_back( value );
+			}
+		},
+		nullptr },
+	{ "entities", 1,
+		[]( JsonWriter& writer, const LumpData& data ){
+			ParseEntities( std::vector<char>( data.cbegin(), data.cend() ) );
+			for( const entity_t& entity : entities ){
+				writer.StartObject();
+				for( const epair_t& ep : entity.epairs ){
+					writer.Key( ep.key.c_str() );
+					writer.String( ep.value.c_str() );
+				}
+				writer.EndObject();
+			}
+		},
+		[]( const JsonRecord& record, LumpData& data ){
+			auto text = StringStream( "{\n" );
+			for( const JsonField& field : record )
+				text << '\"' << field.key.c_str() << "\" \"" << ( field.strings.empty()? "" : field.strings.front().c_str() ) << "\"\n";
+			text << "}\n";
+			data.insert( data.end(), text.begin(), text.end() );
+		},
+		[]( LumpData& data ){
+			if( !data.empty() )
+				data.push_back( '\0' );  // the engine requires the terminator
+		} },
+	{ "strings", 1,
+		[]( JsonWriter& writer, const LumpData& data ){
+			// every piece between terminators, joined with '\0' again on import so string table offsets stay valid
+			auto start = data.cbegin();
+			for( auto it = data.cbegin(); ; ++it ){
+				if( it == data.cend() || *it == '\0' ){
+					writer.String( reinterpret_cast<const char*>( &*start ), it - start );
+					if( it == data.cend() )
+						break;
+					start = it + 1;
+				}
+			}
+		},
+		[]( const JsonRecord& record, LumpData& data ){
+			const char *string = record_string( record, "" );
+			data.insert( data.end(), string, string + strlen( string ) );
+			data.push_back( '\0' );
+		},
+		[]( LumpData& data ){
+			data.pop_back();  // the last piece had no terminator of its own
+		} },
+	{ "planes", sizeof( Plane3f ),
+		[]( JsonWriter& writer, const LumpData& data ){
+			for_each_element<Plane3f>( data, [&writer]( const Plane3f& plane ){
+				writer.StartObject();
+				write_member( writer, "normal", plane.normal() );
+				write_member( writer, "dist", plane.dist() );
+				writer.EndObject();
+			} );
+		},
+		[]( const JsonRecord& record, LumpData& data ){
+			Plane3f plane;
+			member_to( record, "normal", plane.normal() );
+			member_to( record, "dist", plane.dist() );
+			append_element( data, plane );
+		},
+		nullptr },
+	{ "vertices", sizeof( Vector3 ),
+		[]( JsonWriter& writer, const LumpData& data ){
+			for_each_element<Vector3>( data, [&writer]( const Vector3& vertex ){
+				write_value( writer, vertex );
+			} );
+		},
+		[]( const JsonRecord& record, LumpData& data ){
+			Vector3 vertex;
+			member_to( record, "", vertex );
+			append_element( data, vertex );
+		},
+		nullptr },
+	{ "indices", sizeof( uint16_t ),
+		[]( JsonWriter& writer, const LumpData& data ){
+			for_each_element<uint16_t>( data, [&writer]( uint16_t index ){
+				write_value( writer, index );
+			} );
+		},
+		[]( const JsonRecord& record, LumpData& data ){
+			uint16_t index;
+			member_to( record, "", index );
+			append_element( data, index );
+		},
+		nullptr },
+	{ "texturedata", sizeof( Titanfall::TextureData_t ),
+		[]( JsonWriter& writer, const LumpData& data ){
+			for_each_element<Titanfall::TextureData_t>( data, [&writer]( const Titanfall::TextureData_t& texture ){
+				writer.StartObject();
+				write_member( writer, "reflectivity", texture.reflectivity );
+				write_member( writer, "name_index", texture.name_index );
+				write_member( writer, "sizeX", texture.sizeX );
+				write_member( writer, "sizeY", texture.sizeY );
+				write_member( writer, "visibleX", texture.visibleX );
+				write_member( writer, "visibleY", texture.visibleY );
+				write_member( writer, "flags", texture.flags );
+				write_flag_names( writer, texture.flags );
+				writer.EndObject();
+			} );
+		},
+		[]( const JsonRecord& record, LumpData& data ){
+			Titanfall::TextureData_t texture;
+			member_to( record, "reflectivity", texture.reflectivity );
+			member_to( record, "name_index", texture.name_index );
+			member_to( record, "sizeX", texture.sizeX );
+			member_to( record, "sizeY", texture.sizeY );
+			member_to( record, "visibleX", texture.visibleX );
+			member_to( record, "visibleY", texture.visibleY );
+			read_flags( record, texture.flags );
+			append_element( data, texture );
+		},
+		nullptr },
+	{ "texturedata_r5", sizeof( ApexLegends::TextureData_t ),
+		[]( JsonWriter& writer, const LumpData& data ){
+			for_each_element<ApexLegends::TextureData_t>( data, [&writer]( const ApexLegends::TextureData_t& texture ){
+				writer.StartObject();
+				write_member( writer, "surfaceIndex", texture.surfaceIndex );
+				write_member( writer, "sizeX", texture.sizeX );
+				write_member( writer, "sizeY", texture.sizeY );
+				write_member( writer, "flags", texture.flags );
+				write_flag_names( writer, texture.flags );
+				writer.EndObject();
+			} );
+		},
+		[]( const JsonRecord& record, LumpData& data ){
+			ApexLegends::TextureData_t texture;
+			member_to( record, "surfaceIndex", texture.surfaceIndex );
+			member_to( record, "sizeX", texture.sizeX );
+			member_to( record, "sizeY", texture.sizeY );
+			read_flags( record, texture.flags );
+			append_element( data, texture );
+		},
+		nullptr },
+};
+
+static const JsonLumpFormat& json_lump_format( const char *name ){
+	for( const JsonLumpFormat& format : g_jsonLumpFormats )
+		if( striEqual( format.name, name ) )
+			return format;
+	Error( "Unknown json lump format \"%s\"", name );
 }
 
-static void write_json( const char *directory ){
-	
+/* the lumps with a known layout, the same index in every rBSP version */
+static const JsonLumpFormat& json_lump_format( int lump, const LumpData& data ){
+	const char *name = "raw";
+	switch ( lump )
+	{
+	case R2_LUMP_ENTITIES: name = "entities"; break;
+	case R2_LUMP_PLANES: name = "planes"; break;
+	case R2_LUMP_TEXTURE_DATA: name = g_game->bspVersion == 47? "texturedata_r5" : "texturedata"; break;
+	case R2_LUMP_VERTICES: name = "vertices"; break;
+	case R2_LUMP_VERTEX_NORMALS: name = "vertices"; break;
+	case R2_LUMP_TEXTURE_DATA_STRING_DATA: name = "strings"; break;
+	case R2_LUMP_MESH_INDICES: name = "indices"; break;
+	}
+	const JsonLumpFormat& format = json_lump_format( name );
+	return data.size() % format.elementSize == 0? format : json_lump_format( "raw" );
+}
+
+
+/* the bsp being converted; lumps are converted in parallel, each to its own file */
+struct JsonLump
+{
+	int index;
+	const JsonLumpFormat *format;
+	bspLump_t header;
+	LumpData data;
+};
+
+static rbspHeader_t g_jsonHeader;
+static std::vector<JsonLump> g_jsonLumps;
+static CopiedString g_jsonDirectory;
+
+static auto json_lump_filename( const JsonLump& lump ){
+	char name[16];
+	sprintf( name, "%02x_", lump.index );
+	return StringStream( g_jsonDirectory, name, lump.format->name, ".json" );
 }
 
-inline rapidjson::Document load_json( const char *fileName ){
-	Sys_Printf( "Loading %s\n", fileName );
-	rapidjson::Document doc;
-	doc.Parse( (const char*)LoadFile( fileName ).data() );
-	ENSURE( !doc.HasParseError() );
-	return doc;
+static void write_json_lump( int index ){
+	const JsonLump& lump = g_jsonLumps[index];
+	write_lump( json_lump_filename( lump ), [&lump]( JsonWriter& writer ){
+		lump.format->write( writer, lump.data );
+	} );
 }
 
-static void read_json( const char *directory, bool useFlagNames, bool skipUnknownFlags ){
-	
+static void read_json_lump( int index ){
+	JsonLump& lump = g_jsonLumps[index];
+	read_lump( json_lump_filename( lump ), [&lump]( const JsonRecord& record ){
+		lump.format->read( record, lump.data );
+	} );
+	if( lump.format->finish != nullptr )
+		lump.format->finish( lump.data );
+}
+
+static void load_bsp( const char *filename ){
+	MemBuffer buffer = LoadFile( filename );
+	if( buffer.size() < sizeof( rbspHeader_t ) )
+		Error( "%s: not a bsp file", filename );
+
+	memcpy( &g_jsonHeader, buffer.data(), sizeof( g_jsonHeader ) );
+	if( memcmp( g_jsonHeader.ident, g_game->bspIdent, 4 ) || g_jsonHeader.version != g_game->bspVersion )
+		Error( "%s: not a %s bsp (version %d), use -game to pick the matching game", filename, g_game->arg, g_jsonHeader.version );
+
+	g_jsonLumps.clear();
+	for( int i = 0; i != int( std::size( g_jsonHeader.lumps ) ); ++i ){
+		const bspLump_t& header = g_jsonHeader.lumps[i];
+		if( header.length < 0 || header.offset < 0 || std::size_t( header.offset ) + header.length > buffer.size() )
+			Error( "%s: lump %d is out of bounds", filename, i );
+		if( header.length == 0 )
+			continue;
+		const byte *data = (const byte*)buffer.data() + header.offset;
+		JsonLump& lump = g_jsonLumps.emplace_back( JsonLump{ i, nullptr, header, { data, data + header.length } } );
+		lump.format = &json_lump_format( i, lump.data );
+	}
+}
+
+static void write_bsp( const char *filename ){
+	rbspHeader_t header = g_jsonHeader;
+	for( bspLump_t& lump : header.lumps )
+		lump.offset = lump.length = 0;
+
+	FILE *file = SafeOpenWrite( filename );
+	SafeWrite( file, &header, sizeof( header ) );
+
+	// lumps keep their order in the file, the game lump holds an absolute offset to its own data
+	std::vector<JsonLump*> lumps;
+	for( JsonLump& lump : g_jsonLumps )
+		lumps.push_back( &lump );
+	std::stable_sort( lumps.begin(), lumps.end(), []( const JsonLump *a, const JsonLump *b ){
+		return a->header.offset < b->header.offset;
+	} );
+
+	for( JsonLump *lump : lumps ){
+		bspLump_t& entry = header.lumps[lump->index];
+		entry.lumpVer = lump->header.lumpVer;
+		entry.padding = lump->header.padding;
+		if( lump->index == R2_LUMP_GAME_LUMP && lump->data.size() >= sizeof( Titanfall2::GameLumpHeader_t ) ){
+			Titanfall2::GameLumpHeader_t gameLumpHeader;
+			memcpy( &gameLumpHeader, lump->data.data(), sizeof( gameLumpHeader ) );
+			gameLumpHeader.offset += ftell( file ) - lump->header.offset;
+			memcpy( lump->data.data(), &gameLumpHeader, sizeof( gameLumpHeader ) );
+		}
+		AddLump( file, entry, lump->data );
+	}
+
+	const int size = ftell( file );
+	Sys_Printf( "Wrote %.1f MB (%d bytes)\n", (float)size / ( 1024 * 1024 ), size );
+
+	fseek( file, 0, SEEK_SET );
+	SafeWrite( file, &header, sizeof( header ) );
+	fclose( file );
+}
+
+static void write_json( const char *directory ){
+	g_jsonDirectory = directory;
+	Q_mkdir( directory );
+
+	write_lump( StringStream( directory, "header.json" ), []( JsonWriter& writer ){
+		writer.StartObject();
+		writer.Key( "ident" );
+		writer.String( g_jsonHeader.ident, 4 );
+		write_member( writer, "version", g_jsonHeader.version );
+		write_member( writer, "mapVersion", g_jsonHeader.mapVersion );
+		write_member( writer, "maxLump", g_jsonHeader.maxLump );
+		writer.EndObject();
+		for( const JsonLump& lump : g_jsonLumps ){
+			writer.StartObject();
+			write_member( writer, "lump", lump.index );
+			writer.Key( "format" );
+			writer.String( lump.format->name );
+			write_member( writer, "offset", lump.header.offset );
+			write_member( writer, "lumpVer", lump.header.lumpVer );
+			write_member( writer, "padding", lump.header.padding );
+			writer.EndObject();
+		}
+	} );
+
+	for( const JsonLump& lump : g_jsonLumps )
+		Sys_Printf( "Writing %s\n", json_lump_filename( lump ).c_str() );
+	RunThreadsOnIndividual( g_jsonLumps.size(), false, write_json_lump );
+}
+
+static void read_json( const char *directory ){
+	g_jsonDirectory = directory;
+
+	g_jsonLumps.clear();
+	bool first = true;
+	read_lump( StringStream( directory, "header.json" ), [&first]( const JsonRecord& record ){
+		if( std::exchange( first, false ) ){
+			strncpy( g_jsonHeader.ident, record_string( record, "ident" ), sizeof( g_jsonHeader.ident ) );
+			member_to( record, "version", g_jsonHeader.version );
+			member_to( record, "mapVersion", g_jsonHeader.mapVersion );
+			member_to( record, "maxLump", g_jsonHeader.maxLump );
+			return;
+		}
+		JsonLump& lump = g_jsonLumps.emplace_back();
+		member_to( record, "lump", lump.index );
+		if( lump.index < 0 || lump.index >= int( std::size( g_jsonHeader.lumps ) ) )
+			Error( "header.json: lump %d is out of range", lump.index );
+		lump.format = &json_lump_format( record_string( record, "format" ) );
+		member_to( record, "offset", lump.header.offset );
+		member_to( record, "lumpVer", lump.header.lumpVer );
+		member_to( record, "padding", lump.header.padding );
+	} );
+	if( first )
+		Error( "header.json: missing bsp header" );
+	if( memcmp( g_jsonHeader.ident, g_game->bspIdent, 4 ) || g_jsonHeader.version != g_game->bspVersion )
+		Error( "header.json: not a %s bsp (version %d), use -game to pick the matching game", g_game->arg, g_jsonHeader.version );
+
+	for( const JsonLump& lump : g_jsonLumps )
+		Sys_Printf( "Loading %s\n", json_lump_filename( lump ).c_str() );
+	RunThreadsOnIndividual( g_jsonLumps.size(), false, read_json_lump );
 }
 
 int ConvertJsonMain( Args& args ){
@@ -147,8 +643,6 @@ int ConvertJsonMain( Args& args ){
 	}
 
 	bool doPack = false; // unpack by default
-	bool useFlagNames = false;
-	bool skipUnknownFlags = false;
 
 	/* process arguments */
 	const char *fileName = args.takeBack();
@@ -157,34 +651,30 @@ int ConvertJsonMain( Args& args ){
 			doPack = true;
 		}
 		while ( args.takeArg( "-useflagnames" ) ) {
-			useFlagNames = true;
-			Sys_Printf( "Deducing surface/content flag values from their names in shaders.json\n" );
+			g_jsonUseFlagNames = true;
+			Sys_Printf( "Deducing surface flag values from their names in the texture data lump\n" );
 		}
 		while ( args.takeArg( "-skipflags" ) ) {
-			skipUnknownFlags = true;
-			Sys_Printf( "Skipping unknown surface/content flag names\n" );
+			g_jsonSkipUnknownFlags = true;
+			Sys_Printf( "Skipping unknown surface flag names\n" );
 		}
 	}
 
-	// LoadShaderInfo();
-
 	/* clean up map name */
 	strcpy( source, ExpandArg( fileName ) );
 
 	if( !doPack ){ // unpack
 		path_set_extension( source, ".bsp" );
 		Sys_Printf( "Loading %s\n", source );
-		LoadBSPFile( source );
-		ParseEntities();
+		load_bsp( source );
 		write_json( StringStream( PathExtensionless( source ), '/' ) );
 	}
 	else{
 		/* write bsp */
-		read_json( StringStream( PathExtensionless( source ), '/' ), useFlagNames, skipUnknownFlags );
-		UnparseEntities();
+		read_json( StringStream( PathExtensionless( source ), '/' ) );
 		path_set_extension( source, "_json.bsp" );
 		Sys_Printf( "Writing %s\n", source );
-		WriteBSPFile( source );
+		write_bsp( source );
 	}
 
 	/* return to sender */
@@ -25,10 +25,12 @@
     Embree Ray Tracing Implementation
     
     Uses Intel Embree 4 for hardware-accelerated BVH ray tracing.
-    Falls back to disabled state if Embree is not available at compile time.
+    Falls back to the built-in BVH (bvh_trace.cpp) if Embree is not available
+    at compile time or the Embree device can't be created.
 */
 
 #include "embree_trace.h"
+#include "bvh_trace.h"
 #include "remap.h"
 #include "bspfile_shared.h"
 
@@ -71,6 +73,15 @@ static void EmbreeErrorCallback(void* userPtr, RTCError code, const char* str) {
 
 #endif // USE_EMBREE
 
+// True when queries go to the built-in BVH instead of Embree
+static bool UseBuiltin() {
+#ifdef USE_EMBREE
+    return g_device == nullptr;
+#else
+    return true;
+#endif
+}
+
 
 // =============================================================================
 // Public API Implementation
@@ -90,8 +101,8 @@ bool Init() {
     
     if (g_device == nullptr) {
         RTCError error = rtcGetDeviceError(nullptr);
-        Sys_Warning("Failed to create Embree device (error %d)\n", error);
-        return false;
+        Sys_Warning("Failed to create Embree device (error %d), using built-in BVH\n", error);
+        return true;
     }
     
     // Set error callback
@@ -102,7 +113,8 @@ bool Init() {
     
 #else
     // Embree not available at compile time
-    return false;
+    Sys_Printf("Embree not available, using built-in BVH ray tracing\n");
+    return true;
 #endif
 }
 
@@ -121,6 +133,7 @@ void Shutdown() {
 
 
 void ClearScene() {
+    BVHTrace::ClearScene();
 #ifdef USE_EMBREE
     if (g_scene != nullptr) {
         rtcReleaseScene(g_scene);
@@ -134,11 +147,11 @@ void ClearScene() {
 
 
 void BuildScene(bool skipSkyMeshes) {
-#ifdef USE_EMBREE
-    if (g_device == nullptr) {
-        Sys_Warning("Embree device not initialized, cannot build scene\n");
+    if (UseBuiltin()) {
+        BVHTrace::BuildScene(skipSkyMeshes);
         return;
     }
+#ifdef USE_EMBREE
     
     // Clear any existing scene
     ClearScene();
@@ -228,14 +241,14 @@ void BuildScene(bool skipSkyMeshes) {
     Sys_Printf("  %zu meshes, %zu triangles, %zu vertices\n", 
                g_stats.numMeshes, g_stats.numTriangles, g_stats.numVertices);
     Sys_Printf("  BVH built in %.2f ms\n", g_stats.buildTimeMs);
-    
-#else
-    Sys_Warning("Embree not available, using fallback ray tracing\n");
 #endif
 }
 
 
 bool TestVisibility(const Vector3 &origin, const Vector3 &dir, float maxDist) {
+    if (UseBuiltin()) {
+        return BVHTrace::TestVisibility(origin, dir, maxDist);
+    }
 #ifdef USE_EMBREE
     if (!g_sceneReady || g_scene == nullptr) {
         return false;  // No scene, assume not blocked
@@ -268,6 +281,9 @@ bool TestVisibility(const Vector3 &origin, const Vector3 &dir, float maxDist) {
 
 bool TraceRay(const Vector3 &origin, const Vector3 &dir, float maxDist,
               float &outHitDist, Vector3 &outHitNormal, int &outMeshIndex) {
+    if (UseBuiltin()) {
+        return BVHTrace::TraceRay(origin, dir, maxDist, outHitDist, outHitNormal, outMeshIndex);
+    }
 #ifdef USE_EMBREE
     if (!g_sceneReady || g_scene == nullptr) {
         return false;
@@ -317,6 +333,9 @@ bool TraceRay(const Vector3 &origin, const Vector3 &dir, float maxDist,
 
 
 bool IsSceneReady() {
+    if (UseBuiltin()) {
+        return BVHTrace::IsSceneReady();
+    }
 #ifdef USE_EMBREE
     return g_sceneReady;
 #else
@@ -326,6 +345,9 @@ bool IsSceneReady() {
 
 
 SceneStats GetSceneStats() {
+    if (UseBuiltin()) {
+        return BVHTrace::GetSceneStats();
+    }
 #ifdef USE_EMBREE
     return g_stats;
 #else
@@ -90,6 +90,8 @@ static void HelpBsp()
 		{"-autocaulk", "Only output special .caulk file for use by radiant"},
 		{"-celshader <shadername>", "Sets a global cel shader name"},
 		{"-clipdepth <F>", "Model autoclip brushes thickness, default = 2"},
+		{"-compresslightmaps", "Compress Apex Legends lightmap pages to BC6H and report PSNR per page"},
+		{"-compressquality <N>", "BC6H lightmap compression quality, 0 = fastest, 2 = best (default 1)"},
 		{"-custinfoparms", "Read scripts/custinfoparms.txt"},
 		{"-debugclip", "Make model autoclip brushes visible, using shaders debugclip, debugclip2"},
 		{"-debuginset", "Push all triangle vertexes towards the triangle center"},
@@ -128,11 +130,13 @@ static void HelpBsp()
 		{"-patchmeta", "Turn patches into triangle meshes for display"},
 		{"-rename", "Append suffix to miscmodel shaders (needed for SoF2)"},
 		{"-samplesize <N>", "Sets default lightmap resolution in luxels/qu"},
+		{"-seed <N>", "Seed for Apex Legends lightmap and probe sampling, output is identical for the same seed"},
 		{"-skyfix", "Turn sky box into six surfaces to work around ATI problems"},
 		{"-snap <N>", "Snap brush bevel planes to the given number of units"},
 		{"-sRGBcolor", "Treat shader and light entity colors as sRGB colorspace"},
 		{"-sRGBtex", "Treat textures as sRGB colorspace"},
 		{"-tempname <filename.map>", "Read the MAP file from the given file name"},
+		{"-textprobes", "Also write Apex Legends light probes as text to <map>.probes.txt"},
 		{"-verboseentities", "Enable `-v` only for map entities, not for the world"},
 	};
 	HelpOptions("BSP Stage", 0, 80, options);
@@ -421,9 +425,9 @@ static void HelpJson()
 {
 	const std::vector<HelpOption> options = {
 		{"-json [options] <filename.bsp>", "Export/import BSP to/from json text files for debugging and editing purposes"},
-		{"-unpack", "Unpack BSP to json"},
+		{"-unpack", "Unpack BSP to json (default)"},
 		{"-pack", "Pack json to BSP"},
-		{"-useflagnames", "While packing, deduce surface/content flag values from their names in shaders.json (useful for conversion to a game with different flag values)"},
+		{"-useflagnames", "While packing, deduce surface flag values from their names in the texture data lump (useful for conversion to a game with different flag values)"},
 		{"-skipflags", "While -useflagnames, skip unknown flag names"},
 	};
 
@@ -433,14 +437,22 @@ static void HelpJson()
 static void HelpMergeBsp()
 {
 	const std::vector<HelpOption> options = {
-		{"-mergebsp [options] <mainBsp.bsp> <bspToinject.bsp>", "Inject latter BSP to former. Tree and vis data of the main one are preserved."},
-		{"-fixnames", "Make incoming BSP target/targetname names unique to not collide with existing names"},
-		{"-world", "Also merge worldspawn model (brushes as if they were detail, no BSP tree is affected) (only merges entities by default)"},
+		{"-mergebsp [options] <mainBsp.bsp> <bspToinject.bsp> [<bspToinject.bsp> ...]", "Merge compiled Titanfall 2 BSPs into the first one. Meshes, props, collision and entities are merged, the vis tree is rebuilt."},
+		{"-o <output.bsp>", "Output file, defaults to <mainBsp>_merged.bsp"},
 	};
 
 	HelpOptions("BSP merge", 0, 80, options);
 }
 
+static void HelpHDRTest()
+{
+	const std::vector<HelpOption> options = {
+		{"-hdrtest", "Check the table and AVX2 Apex Legends lightmap encoders against the reference encoder on 1M colours, exits with 1 on any difference"},
+	};
+
+	HelpOptions("HDR encoder self-test", 0, 80, options);
+}
+
 static void HelpCommon()
 {
 	const std::vector<HelpOption> options = {
@@ -495,6 +507,7 @@ void HelpMain(const char* arg)
 		{"-repack", "Maps repack creation"},
 		{"-json", "BSP json export/import"},
 		{"-mergebsp", "BSP merge"},
+		{"-hdrtest", "HDR encoder self-test"},
 	};
 	void(*help_funcs[])() = {
 		HelpBsp,
@@ -514,6 +527,7 @@ void HelpMain(const char* arg)
 		HelpRepack,
 		HelpJson,
 		HelpMergeBsp,
+		HelpHDRTest,
 	};
 
 	if ( !strEmptyOrNull( arg ) )
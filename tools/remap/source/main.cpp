@@ -212,6 +212,11 @@ int main( int argc, char **argv ){
 		r = MergeBSPMain( args );
 	}
 
+	/* apex legends lightmap encoder self-test */
+	else if ( args.takeFront( "-hdrtest" ) ) {
+		r = HDREncodeTestMain( args );
+	}
+
 
 	/* ydnar: otherwise create a bsp */
 	else{
@@ -1308,6 +1308,9 @@ int ConvertBSPToOBJ(char *bspName);
 /* convert_json.c */
 int ConvertJsonMain(Args &args);
 
+/* apex_legends_lightmaps.c */
+int HDREncodeTestMain(Args &args);
+
 /* brush.c */
 sideRef_t *AllocSideRef(const side_t *side, sideRef_t *next);
 Vector3 SnapWeldVector(const Vector3 &a, const Vector3 &b);
@@ -1562,6 +1565,7 @@ void WriteEntFiles(const char *path );
 
 void ParseEPair(std::list<epair_t> &epairs);
 void ParseEntities();
+void ParseEntities(const std::vector<char> &data);
 void UnparseEntities();
 void PrintEntity(const entity_t *ent);
 
@@ -1634,6 +1638,10 @@ inline String512  globalCelShader;
 inline bool       keepLights;
 
 inline bool  g_bExternalModels;
+inline bool  g_bCompressLightmaps;
+inline int   g_lightmapCompressQuality = 1;
+inline bool  g_bTextProbes;
+inline std::uint32_t g_bakeSeed;
 
 
 #if Q3MAP2_EXPERIMENTAL_SNAP_NORMAL_FIX
@@ -450,9 +450,9 @@ void Titanfall::EmitMeshes(const entity_t &e) {
             }
         }
 
-        // Save triangles
-        for (uint16_t triangle : mesh.triangles) {
-            Titanfall::Bsp::meshIndices.emplace_back(triangle + m.vertexOffset - materialSortOffset);
+        // Save triangles, SplitMeshes keeps every index within 16 bits
+        for (uint32_t triangle : mesh.triangles) {
+            Titanfall::Bsp::meshIndices.emplace_back(static_cast<uint16_t>(triangle + m.vertexOffset - materialSortOffset));
         }
 
         // Save MeshBounds
@@ -529,9 +529,21 @@ void Titanfall::EmitStaticProp(entity_t &e) {
     const char *model = e.valueForKey("model");
     int16_t pathIdx = -1;
     MinMax minmax;
+    Vector3 origin;
+    Vector3 angles;
+    if(!e.read_keyvalue(origin, "origin")) {
+        origin.x() = 0.0f;
+        origin.y() = 0.0f;
+        origin.z() = 0.0f;
+    }
+    if(!e.read_keyvalue(angles, "angles")) {
+        angles.x() = 0.0f;
+        angles.y() = 0.0f;
+        angles.z() = 0.0f;
+    }
+    const Vector3 scale = Shared::StaticPropScale(e);
 
-    std::vector<const AssMeshWalker*> meshes = LoadModelWalker( model, 0 );
-    if(meshes.empty()) {
+    if(!Shared::StaticPropBounds(model, origin, angles, scale, minmax)) {
         Sys_Warning("Failed to load model: %s\n", model);
         return;
     }
@@ -557,22 +569,11 @@ void Titanfall::EmitStaticProp(entity_t &e) {
     Titanfall::Bsp::gameLumpPropHeader.numProps++;
     Titanfall::Bsp::gameLumpPropHeader.unk1++;
     Titanfall::GameLumpProp_t &prop = Titanfall::Bsp::gameLumpProps.emplace_back();
-    Vector3 origin;
-    Vector3 angles;
-    if(!e.read_keyvalue(origin, "origin")) {
-        origin.x() = 0.0f;
-        origin.y() = 0.0f;
-        origin.z() = 0.0f;
-    }
-    if(!e.read_keyvalue(angles, "angles")) {
-        angles.x() = 0.0f;
-        angles.y() = 0.0f;
-        angles.z() = 0.0f;
-    }
 
     prop.origin = origin;
     prop.angles = angles;
-    prop.scale = 1.0f;
+    // The engine only supports uniform scale
+    prop.scale = vector3_max_component(scale);
     prop.modelName = pathIdx;
     prop.solid = 6;
     prop.flags = 4;
@@ -587,15 +588,6 @@ void Titanfall::EmitStaticProp(entity_t &e) {
     prop.lightingOrigin.z() = 1.0f;
     prop.disableX360 = -1;
 
-    for ( const auto mesh : meshes )
-    {
-        mesh->forEachFace( [&minmax, &origin]( const Vector3 ( &xyz )[3], const Vector2 ( &st )[3] ){
-                        minmax.extend(xyz[0] + origin);
-            minmax.extend(xyz[1] + origin);
-            minmax.extend(xyz[2] + origin);
-                } );
-    }
-
     Shared::visRef_t &ref = Shared::visRefs.emplace_back();
 
     ref.minmax = minmax;
@@ -52,6 +52,8 @@ namespace Titanfall2 {
     void EmitEntity(const entity_t &e);
     void EmitStubs();
 
+    void MergeBSPFiles(const std::vector<const char*> &filenames, const char *output);
+
     // 0x23
     // GameLump is the only lump which isn't just a vector
     // The order in which these structs were defined is the order in which both our and the respawn compiler saves them
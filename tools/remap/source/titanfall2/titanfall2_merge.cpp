@@ -0,0 +1,749 @@
+/* -------------------------------------------------------------------------------
+
+   Copyright (C) 2022-2023 MRVN-Radiant and contributors.
+   For a list of contributors, see the accompanying CONTRIBUTORS file.
+
+   This file is part of MRVN-Radiant.
+
+   MRVN-Radiant is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   MRVN-Radiant is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with GtkRadiant; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+   ------------------------------------------------------------------------------- */
+
+#include "../remap.h"
+#include "../bspfile_abstract.h"
+#include <unordered_map>
+#include <algorithm>
+
+
+namespace {
+    /* Mesh groups of worldspawn, in the order they are stored */
+    enum {
+        MESH_GROUP_OPAQUE,
+        MESH_GROUP_DECAL,
+        MESH_GROUP_TRANSLUCENT,
+        MESH_GROUP_SKY,
+        MESH_GROUP_COUNT
+    };
+
+    /* Vertex lumps, indexed by Titanfall::Mesh_t::vertexType */
+    enum {
+        VERTEX_LIT_FLAT,
+        VERTEX_UNLIT,
+        VERTEX_LIT_BUMP,
+        VERTEX_UNLIT_TS,
+        VERTEX_BLINN_PHONG,
+        VERTEX_TYPE_COUNT
+    };
+
+    /* Ent file partitions and the buffers they are merged into */
+    struct EntPartition_t {
+        const char         *suffix;
+        std::vector<char>  &data;
+    };
+
+    std::array<EntPartition_t, 5> EntPartitions() {
+        return {{
+            { "_env.ent",    Titanfall::Ent::env    },
+            { "_fx.ent",     Titanfall::Ent::fx     },
+            { "_script.ent", Titanfall::Ent::script },
+            { "_snd.ent",    Titanfall::Ent::snd    },
+            { "_spawn.ent",  Titanfall::Ent::spawn  },
+        }};
+    }
+
+    /* Everything -mergebsp takes from one Titanfall 2 bsp */
+    struct MergeSource_t {
+        CopiedString                                  filename;
+        std::vector<char>                             entities;
+        std::array<std::vector<char>, 5>              entFiles;
+        std::vector<Plane3f>                          planes;
+        std::vector<Titanfall::TextureData_t>         textureData;
+        std::vector<char>                             textureDataData;
+        std::vector<uint32_t>                         textureDataTable;
+        std::vector<Vector3>                          vertices;
+        std::vector<Vector3>                          vertexNormals;
+        std::vector<Titanfall::Model_t>               models;
+        std::vector<Titanfall::GameLumpPath_t>        gameLumpPaths;
+        std::vector<Titanfall2::GameLumpProp_t>       gameLumpProps;
+        std::vector<Titanfall::VertexUnlit_t>         vertexUnlitVertices;
+        std::vector<Titanfall::VertexLitFlat_t>       vertexLitFlatVertices;
+        std::vector<Titanfall::VertexLitBump_t>       vertexLitBumpVertices;
+        std::vector<Titanfall::VertexUnlitTS_t>       vertexUnlitTSVertices;
+        std::vector<Titanfall::VertexBlinnPhong_t>    vertexBlinnPhongVertices;
+        std::vector<uint16_t>                         meshIndices;
+        std::vector<Titanfall::Mesh_t>                meshes;
+        std::vector<Titanfall::MeshBounds_t>          meshBounds;
+        std::vector<Titanfall::MaterialSort_t>        materialSorts;
+        std::vector<Titanfall::CMGrid_t>              cmGrid;
+        std::vector<Titanfall::CMGridCell_t>          cmGridCells;
+        std::vector<Titanfall::CMGeoSet_t>            cmGeoSets;
+        std::vector<int32_t>                          cmUniqueContents;
+        std::vector<Titanfall::CMBrush_t>             cmBrushes;
+        std::vector<uint16_t>                         cmBrushSideProperties;
+        std::vector<uint16_t>                         cmBrushSidePlaneOffsets;
+        std::vector<Titanfall::CMBrushSideTexVec_t>   cmBrushSideTexVecs;
+        std::vector<Vector3>                          occlusionMeshVertices;
+        std::vector<uint16_t>                         occlusionMeshIndices;
+        std::vector<uint16_t>                         objReferences;
+        std::vector<Titanfall::ObjReferenceBounds_t>  objReferenceBounds;
+        std::vector<Titanfall::LevelInfo_t>           levelInfo;
+    };
+
+    /* A collision brush after it has been re-based into the merged lumps */
+    struct MergeBrush_t {
+        MinMax    minmax;
+        uint32_t  index;
+        int       contents;
+    };
+
+
+    /*
+        LoadMergeGameLump()
+        Reads the static prop paths and props of a Titanfall 2 game lump
+    */
+    void LoadMergeGameLump(const MemBuffer &buffer, MergeSource_t &source) {
+        const rbspHeader_t *header = (const rbspHeader_t*)buffer.data();
+        const bspLump_t &lump = header->lumps[R2_LUMP_GAME_LUMP];
+        if (lump.length <= 0) {
+            return;
+        }
+
+        const byte *data = (const byte*)buffer.data();
+        auto read = [&](std::size_t offset, std::size_t size) {
+            if (offset + size > buffer.size()) {
+                Error("%s: game lump is out of bounds", source.filename.c_str());
+            }
+            return data + offset;
+        };
+
+        Titanfall2::GameLumpHeader_t gameLumpHeader;
+        memcpy(&gameLumpHeader, read(lump.offset, sizeof(gameLumpHeader)), sizeof(gameLumpHeader));
+
+        std::size_t offset = gameLumpHeader.offset;
+        Titanfall2::GameLumpPathHeader_t pathHeader;
+        memcpy(&pathHeader, read(offset, sizeof(pathHeader)), sizeof(pathHeader));
+        offset += sizeof(pathHeader);
+
+        const byte *paths = read(offset, pathHeader.numPaths * sizeof(Titanfall::GameLumpPath_t));
+        source.gameLumpPaths = { (const Titanfall::GameLumpPath_t*)paths, (const Titanfall::GameLumpPath_t*)paths + pathHeader.numPaths };
+        offset += pathHeader.numPaths * sizeof(Titanfall::GameLumpPath_t);
+
+        Titanfall2::GameLumpPropHeader_t propHeader;
+        memcpy(&propHeader, read(offset, sizeof(propHeader)), sizeof(propHeader));
+        offset += sizeof(propHeader);
+
+        const byte *props = read(offset, propHeader.numProps * sizeof(Titanfall2::GameLumpProp_t));
+        source.gameLumpProps = { (const Titanfall2::GameLumpProp_t*)props, (const Titanfall2::GameLumpProp_t*)props + propHeader.numProps };
+    }
+
+
+    /*
+        LoadMergeSource()
+        Loads the lumps of a Titanfall 2 bsp and its .ent files
+    */
+    void LoadMergeSource(const char *filename, MergeSource_t &source, bool isMain) {
+        Sys_Printf("Loading %s\n", filename);
+        source.filename = filename;
+
+        MemBuffer buffer = LoadFile(filename);
+        if (buffer.size() < sizeof(rbspHeader_t)) {
+            Error("%s: not a bsp file", filename);
+        }
+
+        rbspHeader_t *header = (rbspHeader_t*)buffer.data();
+        if (memcmp(header->ident, "rBSP", 4) || header->version != 37) {
+            Error("%s: not a Titanfall 2 bsp (version %d)", filename, header->version);
+        }
+        for (const bspLump_t &lump : header->lumps) {
+            if (lump.length < 0 || lump.offset < 0 || std::size_t(lump.offset) + lump.length > buffer.size()) {
+                Error("%s: lump is out of bounds", filename);
+            }
+        }
+
+        CopyLump(header, R2_LUMP_ENTITIES,                  source.entities);
+        CopyLump(header, R2_LUMP_PLANES,                    source.planes);
+        CopyLump(header, R2_LUMP_TEXTURE_DATA,              source.textureData);
+        CopyLump(header, R2_LUMP_VERTICES,                  source.vertices);
+        CopyLump(header, R2_LUMP_MODELS,                    source.models);
+        CopyLump(header, R2_LUMP_VERTEX_NORMALS,            source.vertexNormals);
+        CopyLump(header, R2_LUMP_TEXTURE_DATA_STRING_DATA,  source.textureDataData);
+        CopyLump(header, R2_LUMP_TEXTURE_DATA_STRING_TABLE, source.textureDataTable);
+        CopyLump(header, R2_LUMP_VERTEX_UNLIT,              source.vertexUnlitVertices);
+        CopyLump(header, R2_LUMP_VERTEX_LIT_FLAT,           source.vertexLitFlatVertices);
+        CopyLump(header, R2_LUMP_VERTEX_LIT_BUMP,           source.vertexLitBumpVertices);
+        CopyLump(header, R2_LUMP_VERTEX_UNLIT_TS,           source.vertexUnlitTSVertices);
+        CopyLump(header, R2_LUMP_VERTEX_BLINN_PHONG,        source.vertexBlinnPhongVertices);
+        CopyLump(header, R2_LUMP_MESH_INDICES,              source.meshIndices);
+        CopyLump(header, R2_LUMP_MESHES,                    source.meshes);
+        CopyLump(header, R2_LUMP_MESH_BOUNDS,               source.meshBounds);
+        CopyLump(header, R2_LUMP_MATERIAL_SORT,             source.materialSorts);
+        CopyLump(header, R2_LUMP_CM_GRID,                   source.cmGrid);
+        CopyLump(header, R2_LUMP_CM_GRID_CELLS,             source.cmGridCells);
+        CopyLump(header, R2_LUMP_CM_GEO_SETS,               source.cmGeoSets);
+        CopyLump(header, R2_LUMP_CM_UNIQUE_CONTENTS,        source.cmUniqueContents);
+        CopyLump(header, R2_LUMP_CM_BRUSHES,                source.cmBrushes);
+        CopyLump(header, R2_LUMP_CM_BRUSH_SIDE_PROPS,       source.cmBrushSideProperties);
+        CopyLump(header, R2_LUMP_CM_BRUSH_SIDE_PLANES,      source.cmBrushSidePlaneOffsets);
+        CopyLump(header, R2_LUMP_CM_BRUSH_SIDE_TEX_VECS,    source.cmBrushSideTexVecs);
+        CopyLump(header, R2_LUMP_OCCLUSION_MESH_VERTICES,   source.occlusionMeshVertices);
+        CopyLump(header, R2_LUMP_OCCLUSION_MESH_INDICES,    source.occlusionMeshIndices);
+        CopyLump(header, R2_LUMP_OBJ_REFERENCES,            source.objReferences);
+        CopyLump(header, R2_LUMP_OBJ_REFERENCE_BOUNDS,      source.objReferenceBounds);
+        CopyLump(header, R2_LUMP_LEVEL_INFO,                source.levelInfo);
+        LoadMergeGameLump(buffer, source);
+
+        if (source.models.empty()) {
+            Error("%s: bsp has no models", filename);
+        }
+
+        // Lumps we don't generate yet are taken from the main bsp as they are
+        if (isMain) {
+            CopyLump(header, R2_LUMP_WORLD_LIGHTS,      Titanfall2::Bsp::worldLights_stub);
+            CopyLump(header, R2_LUMP_LIGHTMAP_HEADERS,  Titanfall2::Bsp::lightMapHeaders_stub);
+            CopyLump(header, R2_LUMP_LIGHTMAP_DATA_SKY, Titanfall2::Bsp::lightMapDataSky_stub);
+            CopyLump(header, R2_LUMP_CSM_AABB_NODES,    Titanfall::Bsp::csmAABBNodes_stub);
+            CopyLump(header, R2_LUMP_CELL_BSP_NODES,    Titanfall::Bsp::cellBSPNodes_stub);
+            CopyLump(header, R2_LUMP_CELLS,             Titanfall::Bsp::cells_stub);
+        }
+
+        // Strip the null terminators, EmitEntityPartitions adds them back
+        auto stripNulls = [](std::vector<char> &text) {
+            while (!text.empty() && text.back() == '\0') {
+                text.pop_back();
+            }
+        };
+        stripNulls(source.entities);
+
+        const auto partitions = EntPartitions();
+        for (std::size_t i = 0; i < partitions.size(); i++) {
+            auto name = StringOutputStream(256)(PathExtensionless(filename), partitions[i].suffix);
+            LoadEntFile(name.c_str(), source.entFiles[i]);
+            stripNulls(source.entFiles[i]);
+        }
+    }
+
+
+    /*
+        MergeEntityText()
+        Appends entity text to a merged buffer, re-basing brush model references
+    */
+    void MergeEntityText(const std::vector<char> &text, std::vector<char> &merged, const std::vector<uint32_t> &modelRemap, bool skipWorldspawn) {
+        if (text.empty()) {
+            return;
+        }
+
+        ParseEntities(text);
+
+        StringOutputStream data(8192);
+        for (entity_t &e : entities) {
+            if (skipWorldspawn && striEqual(e.classname(), "worldspawn")) {
+                continue;
+            }
+
+            const char *model = e.valueForKey("model");
+            if (model[0] == '*') {
+                std::size_t index = atoi(model + 1);
+                if (index < modelRemap.size()) {
+                    e.setKeyValue("model", StringStream('*', modelRemap[index]));
+                }
+            }
+
+            data << "{\n";
+            for (const epair_t &ep : e.epairs) {
+                data << '\"' << ep.key.c_str() << "\" \"" << ep.value.c_str() << "\"\n";
+            }
+            data << "}\n";
+        }
+
+        merged.insert(merged.end(), data.begin(), data.end());
+    }
+
+
+    /*
+        VertexLumpSize()
+        Returns the number of vertices in the merged vertex lump of a vertex type
+    */
+    std::size_t VertexLumpSize(int type) {
+        switch (type) {
+            case VERTEX_UNLIT:       return Titanfall::Bsp::vertexUnlitVertices.size();
+            case VERTEX_LIT_BUMP:    return Titanfall::Bsp::vertexLitBumpVertices.size();
+            case VERTEX_UNLIT_TS:    return Titanfall::Bsp::vertexUnlitTSVertices.size();
+            case VERTEX_BLINN_PHONG: return Titanfall::Bsp::vertexBlinnPhongVertices.size();
+            default:                 return Titanfall::Bsp::vertexLitFlatVertices.size();
+        }
+    }
+
+
+    /*
+        AppendVertices()
+        Appends a vertex lump, re-basing its position and normal indices
+    */
+    template<typename T>
+    void AppendVertices(std::vector<T> &merged, const std::vector<T> &vertices, uint32_t vertexBase, uint32_t normalBase) {
+        for (T vertex : vertices) {
+            vertex.vertexIndex += vertexBase;
+            vertex.normalIndex += normalBase;
+            merged.push_back(vertex);
+        }
+    }
+
+
+    /*
+        CollectBrushes()
+        Sorts the geo sets of a bsp into worldspawn grid, worldspawn model and per model brushes
+    */
+    void CollectBrushes(const MergeSource_t &source, uint32_t brushBase, std::vector<MergeBrush_t> &gridBrushes,
+                        std::vector<MergeBrush_t> &worldBrushes, std::vector<std::vector<MergeBrush_t>> &modelBrushes) {
+        if (source.cmGrid.empty()) {
+            return;
+        }
+
+        const std::size_t gridCells = source.cmGrid.at(0).xCount * source.cmGrid.at(0).yCount;
+        std::vector<bool> inGrid(source.cmBrushes.size(), false);
+        std::size_t skipped = 0;
+
+        for (std::size_t cellIndex = 0; cellIndex < source.cmGridCells.size(); cellIndex++) {
+            const Titanfall::CMGridCell_t &cell = source.cmGridCells.at(cellIndex);
+
+            std::vector<MergeBrush_t> *brushes = &gridBrushes;
+            if (cellIndex == gridCells) {
+                brushes = &worldBrushes;
+            } else if (cellIndex > gridCells) {
+                if (cellIndex - gridCells >= modelBrushes.size()) {
+                    break;
+                }
+                brushes = &modelBrushes.at(cellIndex - gridCells);
+            }
+
+            for (std::size_t i = cell.start; i < std::size_t(cell.start + cell.count) && i < source.cmGeoSets.size(); i++) {
+                const Titanfall::CMGeoSet_t &set = source.cmGeoSets.at(i);
+
+                // Primitive lists and tricoll aren't emitted by the compiler yet
+                if (set.primitiveCount > 1 || set.collisionShapeType != 0 || set.collisionShapeIndex >= source.cmBrushes.size()) {
+                    skipped++;
+                    continue;
+                }
+
+                // Grid brushes are referenced by every cell they touch
+                if (brushes == &gridBrushes) {
+                    if (inGrid[set.collisionShapeIndex]) {
+                        continue;
+                    }
+                    inGrid[set.collisionShapeIndex] = true;
+                }
+
+                const Titanfall::CMBrush_t &brush = source.cmBrushes.at(set.collisionShapeIndex);
+                MergeBrush_t &mb = brushes->emplace_back();
+                mb.minmax.mins = brush.origin - brush.extents;
+                mb.minmax.maxs = brush.origin + brush.extents;
+                mb.index = brushBase + set.collisionShapeIndex;
+                mb.contents = set.uniqueContentsIndex < source.cmUniqueContents.size()
+                            ? source.cmUniqueContents.at(set.uniqueContentsIndex) : CONTENTS_SOLID;
+            }
+        }
+
+        if (skipped) {
+            Sys_Warning("%s: skipped %zu collision primitives which can't be merged\n", source.filename.c_str(), skipped);
+        }
+    }
+
+
+    /*
+        EmitMergedCollisionGrid()
+        Rebuilds the worldspawn collision grid around the brushes of every merged bsp
+    */
+    void EmitMergedCollisionGrid(const std::vector<MergeBrush_t> &gridBrushes, const MinMax &worldBounds) {
+        MinMax gridSize;
+        for (const MergeBrush_t &brush : gridBrushes) {
+            gridSize.extend(brush.minmax);
+        }
+        if (!gridSize.valid()) {
+            gridSize = worldBounds;
+        }
+
+        // Same cell sizing as Titanfall::EmitCollisionGrid
+        Vector3 size = gridSize.maxs - gridSize.mins;
+        float scale = 256;
+        while (ceil(size.x() / scale) + 2 > 128 || ceil(size.y() / scale) + 2 > 128) {
+            scale += 16;
+        }
+
+        Titanfall::CMGrid_t &grid = Titanfall::Bsp::cmGrid.emplace_back();
+        grid.scale = scale;
+        grid.xOffset = floor(gridSize.mins.x() / grid.scale) - 1;
+        grid.yOffset = floor(gridSize.mins.y() / grid.scale) - 1;
+        grid.xCount = ceil(size.x() / grid.scale) + 2;
+        grid.yCount = ceil(size.y() / grid.scale) + 2;
+        grid.straddleGroupCount = 0;
+        grid.brushSidePlaneOffset = 0;
+
+        for (int32_t y = 0; y < grid.yCount; y++) {
+            for (int32_t x = 0; x < grid.xCount; x++) {
+                MinMax cellMinmax;
+                cellMinmax.mins = Vector3((x + grid.xOffset) * grid.scale,
+                                          (y + grid.yOffset) * grid.scale,
+                                           gridSize.mins.z());
+                cellMinmax.maxs = Vector3((x + grid.xOffset + 1) * grid.scale,
+                                          (y + grid.yOffset + 1) * grid.scale,
+                                           gridSize.maxs.z());
+
+                Titanfall::CMGridCell_t &cell = Titanfall::Bsp::cmGridCells.emplace_back();
+                cell.start = Titanfall::Bsp::cmGeoSets.size();
+
+                for (const MergeBrush_t &brush : gridBrushes) {
+                    if (cellMinmax.test(brush.minmax)) {
+                        Titanfall::EmitGeoSet(brush.minmax, brush.index, brush.contents);
+                    }
+                }
+
+                cell.count = Titanfall::Bsp::cmGeoSets.size() - cell.start;
+            }
+        }
+
+        Sys_FPrintf(SYS_VRB, "       Grid ( %i : %i ) has %zu GeoSets\n", grid.xCount, grid.yCount, Titanfall::Bsp::cmGeoSets.size());
+    }
+
+
+    /*
+        EmitMergedGridCell()
+        Emits a model grid cell holding the given brushes
+    */
+    void EmitMergedGridCell(const std::vector<MergeBrush_t> &brushes) {
+        Titanfall::CMGridCell_t &cell = Titanfall::Bsp::cmGridCells.emplace_back();
+        cell.start = Titanfall::Bsp::cmGeoSets.size();
+
+        for (const MergeBrush_t &brush : brushes) {
+            Titanfall::EmitGeoSet(brush.minmax, brush.index, brush.contents);
+        }
+
+        cell.count = Titanfall::Bsp::cmGeoSets.size() - cell.start;
+    }
+}
+
+
+/*
+    MergeBSPFiles()
+    Merges compiled Titanfall 2 bsps into the first one and writes the result
+*/
+void Titanfall2::MergeBSPFiles(const std::vector<const char*> &filenames, const char *output) {
+    Sys_Printf("--- MergeBSP ---\n");
+
+    std::vector<MergeSource_t> sources(filenames.size());
+    for (std::size_t i = 0; i < filenames.size(); i++) {
+        LoadMergeSource(filenames.at(i), sources.at(i), i == 0);
+    }
+
+    /* Texture data, deduplicated by name */
+    std::unordered_map<std::string, uint32_t>  textureIndices;
+    std::vector<std::vector<uint32_t>>          textureRemap(sources.size());
+    for (std::size_t s = 0; s < sources.size(); s++) {
+        const MergeSource_t &source = sources.at(s);
+
+        for (const Titanfall::TextureData_t &td : source.textureData) {
+            if (td.name_index >= source.textureDataTable.size()
+             || source.textureDataTable.at(td.name_index) >= source.textureDataData.size()) {
+                Error("%s: texture data name is out of bounds", source.filename.c_str());
+            }
+
+            const char *name = source.textureDataData.data() + source.textureDataTable.at(td.name_index);
+            std::string key(name, strnlen(name, source.textureDataData.size() - source.textureDataTable.at(td.name_index)));
+            std::string text = key;
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+            auto it = textureIndices.find(key);
+            if (it == textureIndices.end()) {
+                Titanfall::TextureData_t &merged = Titanfall::Bsp::textureData.emplace_back(td);
+                merged.name_index = Titanfall::Bsp::textureDataTable.size();
+                Titanfall::Bsp::textureDataTable.emplace_back(Titanfall::Bsp::textureDataData.size());
+                Titanfall::Bsp::textureDataData.insert(Titanfall::Bsp::textureDataData.end(), text.c_str(), text.c_str() + text.size() + 1);
+                it = textureIndices.emplace(key, Titanfall::Bsp::textureData.size() - 1).first;
+            }
+            textureRemap.at(s).push_back(it->second);
+        }
+    }
+    if (Titanfall::Bsp::textureData.size() > MASK_TEXTURE_DATA + 1) {
+        Error("Merged bsp has %zu texture data, the limit is %d", Titanfall::Bsp::textureData.size(), MASK_TEXTURE_DATA + 1);
+    }
+
+    /* Vertices, vertex lumps and material sorts */
+    std::vector<std::array<std::size_t, VERTEX_TYPE_COUNT>>  vertexBase(sources.size());
+    std::vector<std::size_t>                                  materialSortBase(sources.size());
+    for (std::size_t s = 0; s < sources.size(); s++) {
+        const MergeSource_t &source = sources.at(s);
+
+        for (int type = 0; type < VERTEX_TYPE_COUNT; type++) {
+            vertexBase.at(s)[type] = VertexLumpSize(type);
+        }
+
+        const uint32_t positionBase = Titanfall::Bsp::vertices.size();
+        const uint32_t normalBase = Titanfall::Bsp::vertexNormals.size();
+        Titanfall::Bsp::vertices.insert(Titanfall::Bsp::vertices.end(), source.vertices.begin(), source.vertices.end());
+        Titanfall::Bsp::vertexNormals.insert(Titanfall::Bsp::vertexNormals.end(), source.vertexNormals.begin(), source.vertexNormals.end());
+        AppendVertices(Titanfall::Bsp::vertexUnlitVertices,      source.vertexUnlitVertices,      positionBase, normalBase);
+        AppendVertices(Titanfall::Bsp::vertexLitFlatVertices,    source.vertexLitFlatVertices,    positionBase, normalBase);
+        AppendVertices(Titanfall::Bsp::vertexLitBumpVertices,    source.vertexLitBumpVertices,    positionBase, normalBase);
+        AppendVertices(Titanfall::Bsp::vertexUnlitTSVertices,    source.vertexUnlitTSVertices,    positionBase, normalBase);
+        AppendVertices(Titanfall::Bsp::vertexBlinnPhongVertices, source.vertexBlinnPhongVertices, positionBase, normalBase);
+
+        // Material sort vertex offsets point into the vertex lump of the meshes using them
+        std::vector<int> sortVertexType(source.materialSorts.size(), VERTEX_LIT_FLAT);
+        for (const Titanfall::Mesh_t &mesh : source.meshes) {
+            if (mesh.materialOffset < sortVertexType.size() && mesh.vertexType < VERTEX_TYPE_COUNT) {
+                sortVertexType.at(mesh.materialOffset) = mesh.vertexType;
+            }
+        }
+
+        materialSortBase.at(s) = Titanfall::Bsp::materialSorts.size();
+        for (std::size_t i = 0; i < source.materialSorts.size(); i++) {
+            Titanfall::MaterialSort_t ms = source.materialSorts.at(i);
+            if (ms.textureData >= 0 && std::size_t(ms.textureData) < textureRemap.at(s).size()) {
+                ms.textureData = textureRemap.at(s).at(ms.textureData);
+            }
+            ms.vertexOffset += vertexBase.at(s)[sortVertexType.at(i)];
+            Titanfall::Bsp::materialSorts.push_back(ms);
+        }
+    }
+
+    /* Meshes; worldspawn meshes of every bsp come first, grouped the way the compiler sorts them */
+    auto appendMesh = [&](std::size_t s, std::size_t index) {
+        const MergeSource_t &source = sources.at(s);
+        Titanfall::Mesh_t mesh = source.meshes.at(index);
+
+        const std::size_t first = mesh.triOffset;
+        const std::size_t count = std::size_t(mesh.triCount) * 3;
+        if (first + count > source.meshIndices.size()) {
+            Error("%s: mesh %zu indices are out of bounds", source.filename.c_str(), index);
+        }
+
+        mesh.triOffset = Titanfall::Bsp::meshIndices.size();
+        Titanfall::Bsp::meshIndices.insert(Titanfall::Bsp::meshIndices.end(), source.meshIndices.begin() + first, source.meshIndices.begin() + first + count);
+        mesh.vertexOffset += vertexBase.at(s)[mesh.vertexType < VERTEX_TYPE_COUNT ? int(mesh.vertexType) : int(VERTEX_LIT_FLAT)];
+        mesh.materialOffset += materialSortBase.at(s);
+        Titanfall::Bsp::meshes.push_back(mesh);
+        Titanfall::Bsp::meshBounds.push_back(source.meshBounds.at(index));
+
+        if (Titanfall::Bsp::meshes.size() > 65535) {
+            Error("Merged bsp has more than 65535 meshes");
+        }
+    };
+
+    Titanfall::Model_t world{};
+    Titanfall::LevelInfo_t &levelInfo = Titanfall::Bsp::levelInfo.emplace_back();
+    if (!sources.at(0).levelInfo.empty()) {
+        levelInfo = sources.at(0).levelInfo.at(0);
+    }
+
+    for (int group = 0; group < MESH_GROUP_COUNT; group++) {
+        if (group == MESH_GROUP_DECAL) {
+            levelInfo.firstDecalMeshIndex = Titanfall::Bsp::meshes.size();
+        } else if (group == MESH_GROUP_TRANSLUCENT) {
+            levelInfo.firstTransMeshIndex = Titanfall::Bsp::meshes.size();
+        } else if (group == MESH_GROUP_SKY) {
+            levelInfo.firstSkyMeshIndex = Titanfall::Bsp::meshes.size();
+        }
+
+        for (std::size_t s = 0; s < sources.size(); s++) {
+            const MergeSource_t &source = sources.at(s);
+            const Titanfall::Model_t &model = source.models.at(0);
+
+            // Without level info every worldspawn mesh is treated as opaque
+            std::array<uint32_t, MESH_GROUP_COUNT + 1> bounds = { 0, model.meshCount, model.meshCount, model.meshCount, model.meshCount };
+            if (!source.levelInfo.empty()) {
+                bounds[1] = std::min(source.levelInfo.at(0).firstDecalMeshIndex, model.meshCount);
+                bounds[2] = std::min(source.levelInfo.at(0).firstTransMeshIndex, model.meshCount);
+                bounds[3] = std::min(source.levelInfo.at(0).firstSkyMeshIndex, model.meshCount);
+            }
+
+            for (uint32_t i = bounds[group]; i < bounds[group + 1]; i++) {
+                appendMesh(s, model.firstMesh + i);
+            }
+
+            if (group == 0) {
+                world.minmax.extend(model.minmax);
+            }
+        }
+    }
+    world.firstMesh = 0;
+    world.meshCount = Titanfall::Bsp::meshes.size();
+    Titanfall::Bsp::models.push_back(world);
+
+    // Vis references to worldspawn meshes, the vis tree is rebuilt from these
+    Shared::visRefs.clear();
+    for (uint32_t i = 0; i < world.meshCount; i++) {
+        const Titanfall::MeshBounds_t &mb = Titanfall::Bsp::meshBounds.at(i);
+        Shared::visRef_t &ref = Shared::visRefs.emplace_back();
+        ref.minmax.mins = mb.origin - mb.extents;
+        ref.minmax.maxs = mb.origin + mb.extents;
+        ref.index = i;
+    }
+
+    /* Brush models, and the model index each bsp's "*n" now refers to */
+    std::vector<std::vector<uint32_t>> modelRemap(sources.size());
+    for (std::size_t s = 0; s < sources.size(); s++) {
+        const MergeSource_t &source = sources.at(s);
+        modelRemap.at(s).push_back(0);
+
+        for (std::size_t k = 1; k < source.models.size(); k++) {
+            Titanfall::Model_t model = source.models.at(k);
+            modelRemap.at(s).push_back(Titanfall::Bsp::models.size());
+
+            model.firstMesh = Titanfall::Bsp::meshes.size();
+            for (uint32_t i = 0; i < model.meshCount; i++) {
+                appendMesh(s, source.models.at(k).firstMesh + i);
+            }
+            Titanfall::Bsp::models.push_back(model);
+        }
+    }
+
+    /* Static props, with model paths deduplicated */
+    Titanfall2::SetUpGameLump();
+    std::unordered_map<std::string, int16_t> pathIndices;
+    for (std::size_t s = 0; s < sources.size(); s++) {
+        const MergeSource_t &source = sources.at(s);
+
+        // Recover prop bounds from the old vis references
+        std::vector<const Titanfall::ObjReferenceBounds_t*> propBounds(source.gameLumpProps.size(), nullptr);
+        for (std::size_t i = 0; i < source.objReferences.size() && i < source.objReferenceBounds.size(); i++) {
+            std::size_t prop = std::size_t(source.objReferences.at(i)) - source.models.at(0).meshCount;
+            if (source.objReferences.at(i) >= source.models.at(0).meshCount && prop < propBounds.size()) {
+                propBounds.at(prop) = &source.objReferenceBounds.at(i);
+            }
+        }
+
+        for (std::size_t i = 0; i < source.gameLumpProps.size(); i++) {
+            Titanfall2::GameLumpProp_t prop = source.gameLumpProps.at(i);
+            if (prop.modelName < 0 || std::size_t(prop.modelName) >= source.gameLumpPaths.size()) {
+                Sys_Warning("%s: skipping static prop %zu with an invalid model\n", source.filename.c_str(), i);
+                continue;
+            }
+
+            const Titanfall::GameLumpPath_t &path = source.gameLumpPaths.at(prop.modelName);
+            std::string key(path.path, strnlen(path.path, sizeof(path.path)));
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+            auto it = pathIndices.find(key);
+            if (it == pathIndices.end()) {
+                Titanfall::Bsp::gameLumpPaths.push_back(path);
+                it = pathIndices.emplace(key, Titanfall::Bsp::gameLumpPaths.size() - 1).first;
+            }
+            prop.modelName = it->second;
+            Titanfall2::Bsp::gameLumpProps.push_back(prop);
+
+            if (propBounds.at(i) != nullptr) {
+                Shared::visRef_t &ref = Shared::visRefs.emplace_back();
+                ref.minmax.mins = propBounds.at(i)->mins;
+                ref.minmax.maxs = propBounds.at(i)->maxs;
+                ref.index = world.meshCount + Titanfall2::Bsp::gameLumpProps.size() - 1;
+            }
+        }
+    }
+    Titanfall2::Bsp::gameLumpPathHeader.numPaths = Titanfall::Bsp::gameLumpPaths.size();
+    Titanfall2::Bsp::gameLumpPropHeader.numProps = Titanfall2::Bsp::gameLumpProps.size();
+    Titanfall2::Bsp::gameLumpPropHeader.unk0 = Titanfall2::Bsp::gameLumpProps.size();
+    Titanfall2::Bsp::gameLumpPropHeader.unk1 = Titanfall2::Bsp::gameLumpProps.size();
+
+    /* Collision brushes, appended in order so their side lumps stay sequential */
+    std::vector<MergeBrush_t>                gridBrushes;
+    std::vector<MergeBrush_t>                worldBrushes;
+    std::vector<std::vector<MergeBrush_t>>   modelBrushes(Titanfall::Bsp::models.size());
+    for (std::size_t s = 0; s < sources.size(); s++) {
+        const MergeSource_t &source = sources.at(s);
+        const uint32_t brushBase = Titanfall::Bsp::cmBrushes.size();
+        const uint32_t sidePlaneBase = Titanfall::Bsp::cmBrushSidePlaneOffsets.size();
+
+        if (source.planes.size() != source.cmBrushSidePlaneOffsets.size()) {
+            Sys_Warning("%s: planes don't match brush side planes, collision may be wrong\n", source.filename.c_str());
+        }
+
+        for (Titanfall::CMBrush_t brush : source.cmBrushes) {
+            brush.index += brushBase;
+            if (brush.planeCount) {
+                brush.sidePlaneIndex += sidePlaneBase;
+            }
+            Titanfall::Bsp::cmBrushes.push_back(brush);
+        }
+        for (uint16_t property : source.cmBrushSideProperties) {
+            const std::size_t texture = property & MASK_TEXTURE_DATA;
+            if (texture < textureRemap.at(s).size()) {
+                property = (property & ~MASK_TEXTURE_DATA) | textureRemap.at(s).at(texture);
+            }
+            Titanfall::Bsp::cmBrushSideProperties.push_back(property);
+        }
+        Titanfall::Bsp::planes.insert(Titanfall::Bsp::planes.end(), source.planes.begin(), source.planes.end());
+        Titanfall::Bsp::cmBrushSidePlaneOffsets.insert(Titanfall::Bsp::cmBrushSidePlaneOffsets.end(),
+                                                       source.cmBrushSidePlaneOffsets.begin(), source.cmBrushSidePlaneOffsets.end());
+        Titanfall::Bsp::cmBrushSideTexVecs.insert(Titanfall::Bsp::cmBrushSideTexVecs.end(),
+                                                  source.cmBrushSideTexVecs.begin(), source.cmBrushSideTexVecs.end());
+
+        // Per model brushes are collected in the merged model order
+        std::vector<std::vector<MergeBrush_t>> sourceModelBrushes(source.models.size());
+        CollectBrushes(source, brushBase, gridBrushes, worldBrushes, sourceModelBrushes);
+        for (std::size_t k = 1; k < sourceModelBrushes.size(); k++) {
+            modelBrushes.at(modelRemap.at(s).at(k)) = std::move(sourceModelBrushes.at(k));
+        }
+    }
+    if (Titanfall::Bsp::cmBrushes.size() > 65536) {
+        Error("Merged bsp has %zu collision brushes, the limit is 65536", Titanfall::Bsp::cmBrushes.size());
+    }
+
+    EmitMergedCollisionGrid(gridBrushes, world.minmax);
+    EmitMergedGridCell(worldBrushes);
+    for (std::size_t k = 1; k < modelBrushes.size(); k++) {
+        EmitMergedGridCell(modelBrushes.at(k));
+    }
+
+    /* Occlusion meshes */
+    for (const MergeSource_t &source : sources) {
+        const std::size_t vertexOffset = Titanfall::Bsp::occlusionMeshVertices.size();
+        if (vertexOffset + source.occlusionMeshVertices.size() > 65536) {
+            Sys_Warning("%s: occluders don't fit into the merged bsp, skipping them\n", source.filename.c_str());
+            continue;
+        }
+
+        Titanfall::Bsp::occlusionMeshVertices.insert(Titanfall::Bsp::occlusionMeshVertices.end(),
+                                                     source.occlusionMeshVertices.begin(), source.occlusionMeshVertices.end());
+        for (uint16_t index : source.occlusionMeshIndices) {
+            Titanfall::Bsp::occlusionMeshIndices.push_back(index + vertexOffset);
+        }
+    }
+
+    /* Entities; only the main bsp keeps its worldspawn */
+    const auto partitions = EntPartitions();
+    for (std::size_t s = 0; s < sources.size(); s++) {
+        const MergeSource_t &source = sources.at(s);
+
+        MergeEntityText(source.entities, Titanfall::Bsp::entities, modelRemap.at(s), s != 0);
+        for (std::size_t i = 0; i < partitions.size(); i++) {
+            MergeEntityText(source.entFiles.at(i), partitions[i].data, modelRemap.at(s), s != 0);
+        }
+    }
+    Titanfall::EmitEntityPartitions();
+
+    /* Vis tree, rebuilt from the merged mesh and prop bounds */
+    Shared::visRoot = Shared::MakeVisTree(Shared::visRefs, 1e30f);
+    Titanfall::EmitVisTree();
+
+    Titanfall2::EmitLevelInfo();
+
+    Sys_Printf("%9zu bsps merged\n", sources.size());
+    Sys_Printf("%9zu texture data\n", Titanfall::Bsp::textureData.size());
+    Sys_Printf("%9zu meshes\n", Titanfall::Bsp::meshes.size());
+    Sys_Printf("%9zu models\n", Titanfall::Bsp::models.size());
+    Sys_Printf("%9zu static props\n", Titanfall2::Bsp::gameLumpProps.size());
+    Sys_Printf("%9zu collision brushes\n", Titanfall::Bsp::cmBrushes.size());
+
+    WriteR2BSPFile(output);
+    WriteEntFiles(output);
+}
@@ -43,9 +43,21 @@ void Titanfall2::EmitStaticProp(entity_t &e) {
     const char *model = e.valueForKey("model");
     int16_t pathIdx = -1;
     MinMax minmax;
+    Vector3 origin;
+    Vector3 angles;
+    if(!e.read_keyvalue(origin, "origin")) {
+        origin.x() = 0.0f;
+        origin.y() = 0.0f;
+        origin.z() = 0.0f;
+    }
+    if(!e.read_keyvalue(angles, "angles")) {
+        angles.x() = 0.0f;
+        angles.y() = 0.0f;
+        angles.z() = 0.0f;
+    }
+    const Vector3 scale = Shared::StaticPropScale(e);
 
-    std::vector<const AssMeshWalker*> meshes = LoadModelWalker( model, 0 );
-    if(meshes.empty()) {
+    if(!Shared::StaticPropBounds(model, origin, angles, scale, minmax)) {
         Sys_Warning("Failed to load model: %s\n", model);
         return;
     }
@@ -72,22 +84,11 @@ void Titanfall2::EmitStaticProp(entity_t &e) {
     Titanfall2::Bsp::gameLumpPropHeader.unk0++;
     Titanfall2::Bsp::gameLumpPropHeader.unk1++;
     Titanfall2::GameLumpProp_t &prop = Titanfall2::Bsp::gameLumpProps.emplace_back();
-    Vector3 origin;
-    Vector3 angles;
-    if(!e.read_keyvalue(origin, "origin")) {
-        origin.x() = 0.0f;
-        origin.y() = 0.0f;
-        origin.z() = 0.0f;
-    }
-    if(!e.read_keyvalue(angles, "angles")) {
-        angles.x() = 0.0f;
-        angles.y() = 0.0f;
-        angles.z() = 0.0f;
-    }
 
     prop.origin = origin;
     prop.angles = angles;
-    prop.scale = 1.0f;
+    // The engine only supports uniform scale
+    prop.scale = vector3_max_component(scale);
     prop.modelName = pathIdx;
     prop.solid = 6;
     prop.flags = 84;
@@ -101,15 +102,6 @@ void Titanfall2::EmitStaticProp(entity_t &e) {
     prop.unk.y() = 0.0f;
     prop.unk.z() = 0.0f;
 
-    for ( const auto mesh : meshes )
-    {
-        mesh->forEachFace( [&minmax, &origin]( const Vector3 ( &xyz )[3], const Vector2 ( &st )[3] ){
-			minmax.extend(xyz[0] + origin);
-            minmax.extend(xyz[1] + origin);
-            minmax.extend(xyz[2] + origin);
-		} );
-    }
-
     Shared::visRef_t &ref = Shared::visRefs.emplace_back();
 
     ref.minmax = minmax;